@@ -0,0 +1,44 @@
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Vose别名表的构建
+ * 按权重抽样时先等概率选一列，再以该列的保留概率取本列，否则取它的别名列，抽样是O(1)。
+ * 构建时把每列的概率缩放为平均1，小于1的列用大于1的列补足。
+ * 保留概率的存储格式由调用者决定（语料库为浮点，打字模型为32位定点）：
+ * 对每个保留概率小于1的列调用 assign(列, 保留概率, 别名列)，未调用的列总是取本列
+ */
+template <typename Assign>
+void buildAliasTable(const std::vector<double>& weights, Assign assign) {
+    size_t count = weights.size();
+    double total = 0;
+    for (double weight : weights) {
+        total += weight;
+    }
+    
+    std::vector<double> scaled(count);
+    std::vector<uint32_t> small, large;
+    small.reserve(count);
+    large.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        scaled[i] = weights[i] * static_cast<double>(count) / total;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+    }
+    while (!small.empty() && !large.empty()) {
+        uint32_t less = small.back();
+        small.pop_back();
+        uint32_t more = large.back();
+        large.pop_back();
+        
+        assign(less, scaled[less], more);
+        scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+        (scaled[more] < 1.0 ? small : large).push_back(more);
+    }
+    // 剩下的列因舍入误差未配对，保留概率视为1
+}
+
+#endif // ALIAS_TABLE_H
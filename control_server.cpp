@@ -0,0 +1,141 @@
+#include "control_server.h"
+
+#ifdef __linux__
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace {
+    // 同时保持的客户端连接数上限
+    const size_t MaxClients = 16;
+    
+    // 单行命令的最大长度，超过时断开连接
+    const size_t MaxLineLength = 64 * 1024;
+}
+
+ControlServer::ControlServer()
+    : m_loop(nullptr)
+    , m_listenFd(-1)
+{
+}
+
+ControlServer::~ControlServer() {
+    stop();
+}
+
+bool ControlServer::start(EventLoop& loop, const std::string& path, Handler handler) {
+    if (m_loop) {
+        return false;
+    }
+    
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "错误: 控制套接字路径无效: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_listenFd < 0) {
+        std::cerr << "错误: 无法创建控制套接字: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(m_listenFd, 4) < 0 ||
+        !loop.watch(m_listenFd, EPOLLIN, [this](uint32_t) { acceptClient(); })) {
+        std::cerr << "错误: 无法监听控制套接字 " << path << ": " << std::strerror(errno) << std::endl;
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+    
+    m_loop = &loop;
+    m_path = path;
+    m_handler = handler;
+    return true;
+}
+
+void ControlServer::stop() {
+    if (!m_loop) {
+        return;
+    }
+    
+    while (!m_clients.empty()) {
+        closeClient(m_clients.begin()->first);
+    }
+    m_loop->unwatch(m_listenFd);
+    close(m_listenFd);
+    m_listenFd = -1;
+    unlink(m_path.c_str());
+    m_loop = nullptr;
+}
+
+bool ControlServer::isRunning() const {
+    return m_loop != nullptr;
+}
+
+void ControlServer::acceptClient() {
+    int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd < 0) {
+        return;
+    }
+    if (m_clients.size() >= MaxClients) {
+        const char reply[] = "error 连接数已达上限\n";
+        ssize_t bytes = send(fd, reply, sizeof(reply) - 1, MSG_NOSIGNAL);
+        (void)bytes;
+        close(fd);
+        return;
+    }
+    
+    m_clients[fd] = std::string();
+    m_loop->watch(fd, EPOLLIN | EPOLLRDHUP, [this, fd](uint32_t) {
+        auto it = m_clients.find(fd);
+        if (it != m_clients.end() && !serviceClient(fd, it->second)) {
+            closeClient(fd);
+        }
+    });
+}
+
+void ControlServer::closeClient(int fd) {
+    m_loop->unwatch(fd);
+    close(fd);
+    m_clients.erase(fd);
+}
+
+bool ControlServer::serviceClient(int fd, std::string& buffer) {
+    char data[4096];
+    ssize_t bytes = recv(fd, data, sizeof(data), 0);
+    if (bytes == 0) {
+        return false;
+    }
+    if (bytes < 0) {
+        return errno == EAGAIN || errno == EINTR;
+    }
+    buffer.append(data, static_cast<size_t>(bytes));
+    
+    size_t newline;
+    while ((newline = buffer.find('\n')) != std::string::npos) {
+        std::string command = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        if (!command.empty() && command.back() == '\r') {
+            command.pop_back();
+        }
+        if (command.empty()) {
+            continue;
+        }
+        
+        // 回复很短，本地套接字的发送缓冲区足以一次写完
+        std::string reply = m_handler(command) + "\n";
+        if (send(fd, reply.data(), reply.size(), MSG_NOSIGNAL) < 0) {
+            return false;
+        }
+    }
+    return buffer.size() <= MaxLineLength;
+}
+#endif
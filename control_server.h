@@ -0,0 +1,54 @@
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+#include <map>
+#include <string>
+#include <functional>
+#include "event_loop.h"
+
+#ifdef __linux__
+/**
+ * 运行时控制套接字
+ * 在UNIX域套接字上逐行接收命令，每条命令回复一行（"ok ..."或"error ..."）。
+ * 监听套接字和所有连接都注册到模拟器的事件循环中，命令在事件循环线程中执行，输入线程不参与；
+ * 处理函数只构造新的配置快照并原子替换，不会让输入线程等待
+ */
+class ControlServer {
+public:
+    // 处理一条命令（不含换行），返回回复（不含换行）
+    using Handler = std::function<std::string(const std::string& command)>;
+    
+    ControlServer();
+    ~ControlServer();
+    
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+    
+    // 在path上监听并注册到事件循环（已存在的套接字文件会被替换），失败时返回false并输出错误
+    bool start(EventLoop& loop, const std::string& path, Handler handler);
+    
+    // 从事件循环中取消注册，关闭所有连接并删除套接字文件（在事件循环线程中调用）
+    void stop();
+    
+    bool isRunning() const;
+
+private:
+    // 接受新连接
+    void acceptClient();
+    
+    // 读取客户端数据并处理完整的行，连接关闭或出错时返回false
+    bool serviceClient(int fd, std::string& buffer);
+    
+    // 关闭一个连接
+    void closeClient(int fd);
+
+private:
+    EventLoop* m_loop;                      // 所在的事件循环（未启动时为空）
+    std::string m_path;                     // 套接字路径
+    Handler m_handler;                      // 命令处理函数
+    int m_listenFd;                         // 监听套接字
+    std::map<int, std::string> m_clients;   // 连接 -> 尚未处理的输入（不完整的行）
+};
+#endif
+
+#endif // CONTROL_SERVER_H
@@ -0,0 +1,168 @@
+#include "deadline_scheduler.h"
+#include <thread>
+#include <cstring>
+#ifdef __linux__
+#include <cerrno>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif
+
+DeadlineScheduler::DeadlineScheduler()
+    : m_period(std::chrono::milliseconds(100))
+    , m_spinThreshold(0)
+    , m_missPolicy(MissPolicy::CatchUp)
+    , m_timerFd(-1)
+    , m_cycleStart(Clock::now())
+    , m_cyclesCompleted(0)
+    , m_deadlinesMissed(0)
+    , m_cyclesDropped(0)
+{
+}
+
+DeadlineScheduler::~DeadlineScheduler() {
+#ifdef __linux__
+    if (m_timerFd >= 0) {
+        close(m_timerFd);
+    }
+#endif
+}
+
+void DeadlineScheduler::setPeriod(Duration period) {
+    if (period.count() >= 0) {
+        m_period = period;
+    }
+}
+
+DeadlineScheduler::Duration DeadlineScheduler::period() const {
+    return m_period;
+}
+
+void DeadlineScheduler::setSpinThreshold(Duration spin) {
+    m_spinThreshold = spin.count() > 0 ? spin : Duration(0);
+}
+
+void DeadlineScheduler::setMissPolicy(MissPolicy policy) {
+    m_missPolicy = policy;
+}
+
+bool DeadlineScheduler::useTimerFd() {
+#ifdef __linux__
+    // steady_clock在Linux上就是CLOCK_MONOTONIC，截止时间可以直接作为定时器的绝对时间
+    if (m_timerFd < 0) {
+        m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    }
+    return m_timerFd >= 0;
+#else
+    return false;
+#endif
+}
+
+void DeadlineScheduler::reset(TimePoint start) {
+    m_cycleStart = start;
+}
+
+DeadlineScheduler::TimePoint DeadlineScheduler::cycleStart() const {
+    return m_cycleStart;
+}
+
+DeadlineScheduler::TimePoint DeadlineScheduler::slotDeadline(size_t index, size_t count) const {
+    if (count == 0) {
+        return m_cycleStart;
+    }
+    // 先乘后除，避免每个时间槽的截断误差累积
+    return m_cycleStart + Duration(m_period.count() * static_cast<int64_t>(index) / static_cast<int64_t>(count));
+}
+
+DeadlineScheduler::Duration DeadlineScheduler::waitUntil(TimePoint deadline) {
+    TimePoint now = Clock::now();
+    if (now > deadline) {
+        m_deadlinesMissed.fetch_add(1, std::memory_order_relaxed);
+        return now - deadline;
+    }
+    
+    // 距离截止时间较远时交给内核睡眠，剩余部分忙等待；
+    // 最后一次读到的时间即醒来时间，不额外读时钟
+    TimePoint sleepTarget = deadline - m_spinThreshold;
+    if (sleepTarget > now) {
+#ifdef __linux__
+        if (m_timerFd >= 0) {
+            // 定时器按绝对时间到期，不受睡眠前被抢占的影响；read在到期前阻塞
+            int64_t targetNs = std::chrono::duration_cast<Duration>(sleepTarget.time_since_epoch()).count();
+            itimerspec timer = {};
+            timer.it_value.tv_sec = static_cast<time_t>(targetNs / 1000000000);
+            timer.it_value.tv_nsec = static_cast<long>(targetNs % 1000000000);
+            if (timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &timer, nullptr) == 0) {
+                uint64_t expirations;
+                while (read(m_timerFd, &expirations, sizeof(expirations)) < 0 && errno == EINTR) {
+                }
+            } else {
+                std::this_thread::sleep_until(sleepTarget);
+            }
+        } else {
+            std::this_thread::sleep_until(sleepTarget);
+        }
+#else
+        std::this_thread::sleep_until(sleepTarget);
+#endif
+    }
+    while ((now = Clock::now()) < deadline) {
+        // 忙等待
+    }
+    return now - deadline;
+}
+
+uint64_t DeadlineScheduler::advance() {
+    m_cyclesCompleted.fetch_add(1, std::memory_order_relaxed);
+    m_cycleStart += m_period;
+    
+    if (m_missPolicy != MissPolicy::Drop || m_period.count() <= 0) {
+        // 追赶策略：保持绝对截止时间，落后的周期会被连续补发
+        return 0;
+    }
+    
+    TimePoint now = Clock::now();
+    if (now - m_cycleStart < m_period) {
+        return 0;
+    }
+    
+    // 丢弃策略：跳过已经完整错过的周期
+    uint64_t skipped = static_cast<uint64_t>((now - m_cycleStart) / m_period);
+    m_cycleStart += m_period * static_cast<int64_t>(skipped);
+    m_cyclesDropped.fetch_add(skipped, std::memory_order_relaxed);
+    return skipped;
+}
+
+void DeadlineScheduler::skipTo(TimePoint now) {
+    if (m_period.count() <= 0) {
+        m_cycleStart = now;
+        return;
+    }
+    if (now > m_cycleStart) {
+        int64_t cycles = (now - m_cycleStart + m_period - Duration(1)) / m_period;
+        m_cycleStart += m_period * cycles;
+    }
+}
+
+uint64_t DeadlineScheduler::cyclesCompleted() const {
+    return m_cyclesCompleted.load(std::memory_order_relaxed);
+}
+
+uint64_t DeadlineScheduler::deadlinesMissed() const {
+    return m_deadlinesMissed.load(std::memory_order_relaxed);
+}
+
+uint64_t DeadlineScheduler::cyclesDropped() const {
+    return m_cyclesDropped.load(std::memory_order_relaxed);
+}
+
+bool DeadlineScheduler::parseMissPolicy(const char* name, MissPolicy& policy) {
+    if (std::strcmp(name, "catchup") == 0) {
+        policy = MissPolicy::CatchUp;
+        return true;
+    }
+    if (std::strcmp(name, "drop") == 0) {
+        policy = MissPolicy::Drop;
+        return true;
+    }
+    return false;
+}
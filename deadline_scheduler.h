@@ -0,0 +1,84 @@
+#ifndef DEADLINE_SCHEDULER_H
+#define DEADLINE_SCHEDULER_H
+
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * 截止时间调度器
+ * 基于steady_clock的绝对截止时间（纳秒精度）调度输入周期，
+ * 每个周期的起点由上一个周期起点加上周期长度得到，不会累积漂移
+ */
+class DeadlineScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+    using Duration = std::chrono::nanoseconds;
+    
+    // 错过周期时的处理策略
+    enum class MissPolicy {
+        CatchUp,    // 追赶：连续补发错过的周期，保持总输入次数不变
+        Drop        // 丢弃：跳过已错过的周期，对齐到下一个未来的周期
+    };
+    
+    DeadlineScheduler();
+    ~DeadlineScheduler();
+    
+    DeadlineScheduler(const DeadlineScheduler&) = delete;
+    DeadlineScheduler& operator=(const DeadlineScheduler&) = delete;
+    
+    // 设置周期长度（纳秒）
+    void setPeriod(Duration period);
+    Duration period() const;
+    
+    // 设置自旋阈值：距离截止时间小于该值时改为忙等待，0表示不自旋
+    void setSpinThreshold(Duration spin);
+    
+    // 设置错过周期时的处理策略
+    void setMissPolicy(MissPolicy policy);
+    
+    // 改为由绝对时间的timerfd（TIMER_ABSTIME）唤醒，代替sleep_until（仅Linux），
+    // 失败或不支持时返回false，继续使用sleep_until
+    bool useTimerFd();
+    
+    // 以指定时间为第一个周期的起点重新开始调度
+    void reset(TimePoint start);
+    
+    // 当前周期的起点
+    TimePoint cycleStart() const;
+    
+    // 当前周期内第index个时间槽的截止时间（周期被均分为count个时间槽）
+    TimePoint slotDeadline(size_t index, size_t count) const;
+    
+    // 等待到指定截止时间：先睡眠（sleep_until或timerfd），最后一段忙等待
+    // 返回醒来时相对截止时间的迟到量（调度延迟，不为负）
+    Duration waitUntil(TimePoint deadline);
+    
+    // 进入下一个周期，按策略处理已错过的周期，返回被丢弃的周期数
+    uint64_t advance();
+    
+    // 跳到now之后的第一个周期起点，保持原有相位（用于暂停恢复，不计入丢弃）
+    void skipTo(TimePoint now);
+    
+    // 统计信息（只由调度线程写入，其他线程可随时读取）
+    uint64_t cyclesCompleted() const;
+    uint64_t deadlinesMissed() const;
+    uint64_t cyclesDropped() const;
+    
+    // 解析策略名称（catchup/drop），无法识别时返回false
+    static bool parseMissPolicy(const char* name, MissPolicy& policy);
+
+private:
+    Duration m_period;              // 周期长度
+    Duration m_spinThreshold;       // 自旋阈值
+    MissPolicy m_missPolicy;        // 错过周期的处理策略
+    int m_timerFd;                  // 绝对时间定时器（-1表示使用sleep_until）
+    TimePoint m_cycleStart;         // 当前周期起点（绝对时间）
+    std::atomic<uint64_t> m_cyclesCompleted;    // 已完成周期数
+    std::atomic<uint64_t> m_deadlinesMissed;    // 到达时已超过截止时间的次数
+    std::atomic<uint64_t> m_cyclesDropped;      // 被丢弃的周期数
+};
+
+#endif // DEADLINE_SCHEDULER_H
@@ -0,0 +1,160 @@
+#include "event_loop.h"
+
+#ifdef __linux__
+#include <iostream>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+namespace {
+    // 每轮最多取出的事件数
+    const int MaxEvents = 16;
+}
+
+EventLoop::EventLoop()
+    : m_epollFd(epoll_create1(EPOLL_CLOEXEC))
+    , m_wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_signalFd(-1)
+{
+    if (m_epollFd < 0) {
+        std::cerr << "错误: 无法创建epoll实例" << std::endl;
+    }
+    if (m_wakeFd >= 0) {
+        watch(m_wakeFd, EPOLLIN, [this](uint32_t) {
+            uint64_t value;
+            ssize_t bytes = read(m_wakeFd, &value, sizeof(value));
+            (void)bytes;
+        });
+    }
+}
+
+EventLoop::~EventLoop() {
+    // 定时器和signalfd由事件循环创建，其他描述符归调用方所有
+    if (m_signalFd >= 0) {
+        close(m_signalFd);
+    }
+    if (m_wakeFd >= 0) {
+        close(m_wakeFd);
+    }
+    if (m_epollFd >= 0) {
+        close(m_epollFd);
+    }
+}
+
+bool EventLoop::watch(int fd, uint32_t events, Handler handler) {
+    if (m_epollFd < 0 || fd < 0) {
+        return false;
+    }
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    bool exists = m_watches.count(fd) > 0;
+    if (epoll_ctl(m_epollFd, exists ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) < 0) {
+        return false;
+    }
+    std::shared_ptr<Watch> entry = std::make_shared<Watch>();
+    entry->handler = std::move(handler);
+    m_watches[fd] = entry;
+    return true;
+}
+
+void EventLoop::unwatch(int fd) {
+    auto it = m_watches.find(fd);
+    if (it == m_watches.end()) {
+        return;
+    }
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    m_watches.erase(it);
+}
+
+int EventLoop::addTimer(std::chrono::nanoseconds interval, std::function<void()> handler) {
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd < 0) {
+        return -1;
+    }
+    itimerspec timer = {};
+    timer.it_interval.tv_sec = static_cast<time_t>(interval.count() / 1000000000);
+    timer.it_interval.tv_nsec = static_cast<long>(interval.count() % 1000000000);
+    timer.it_value = timer.it_interval;
+    if (timerfd_settime(timerFd, 0, &timer, nullptr) < 0 ||
+        !watch(timerFd, EPOLLIN, [timerFd, handler](uint32_t) {
+            // 错过的到期合并为一次回调
+            uint64_t expirations;
+            if (read(timerFd, &expirations, sizeof(expirations)) > 0) {
+                handler();
+            }
+        })) {
+        close(timerFd);
+        return -1;
+    }
+    return timerFd;
+}
+
+void EventLoop::removeTimer(int timerFd) {
+    if (timerFd >= 0) {
+        unwatch(timerFd);
+        close(timerFd);
+    }
+}
+
+void EventLoop::blockSignals(std::initializer_list<int> signals) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int signal : signals) {
+        sigaddset(&mask, signal);
+    }
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+}
+
+bool EventLoop::watchSignals(std::initializer_list<int> signals, std::function<void(int)> handler) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int signal : signals) {
+        sigaddset(&mask, signal);
+    }
+    m_signalFd = signalfd(m_signalFd, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (m_signalFd < 0) {
+        return false;
+    }
+    return watch(m_signalFd, EPOLLIN, [this, handler](uint32_t) {
+        signalfd_siginfo info;
+        while (read(m_signalFd, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info))) {
+            handler(static_cast<int>(info.ssi_signo));
+        }
+    });
+}
+
+int EventLoop::runOnce(std::chrono::milliseconds timeout) {
+    if (m_epollFd < 0) {
+        return 0;
+    }
+    epoll_event events[MaxEvents];
+    int ready = epoll_wait(m_epollFd, events, MaxEvents, timeout.count() < 0 ? -1 : static_cast<int>(timeout.count()));
+    if (ready < 0) {
+        return 0;
+    }
+    for (int i = 0; i < ready; i++) {
+        // 回调可能取消注册自己或其他描述符：每次分派前重新查找，并持有回调直到返回
+        auto it = m_watches.find(events[i].data.fd);
+        if (it == m_watches.end()) {
+            continue;
+        }
+        std::shared_ptr<Watch> entry = it->second;
+        entry->handler(events[i].events);
+    }
+    return ready;
+}
+
+void EventLoop::wake() {
+    if (m_wakeFd >= 0) {
+        uint64_t value = 1;
+        ssize_t bytes = write(m_wakeFd, &value, sizeof(value));
+        (void)bytes;
+    }
+}
+#endif
@@ -0,0 +1,65 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <map>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+
+#ifdef __linux__
+/**
+ * 单线程事件循环（epoll）
+ * 监听连接、控制套接字、信号（signalfd）和定时器（timerfd）都注册到同一个epoll实例，
+ * 由调用runOnce()的线程逐个分派，没有事件时一直阻塞，不需要轮询间隔。
+ * 除wake()外的所有方法都只能在运行事件循环的线程中调用
+ */
+class EventLoop {
+public:
+    // 描述符就绪时的回调，参数为epoll事件位（EPOLLIN、EPOLLERR等）
+    using Handler = std::function<void(uint32_t events)>;
+    
+    EventLoop();
+    ~EventLoop();
+    
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+    
+    // 注册描述符（水平触发），重复注册时替换事件和回调；描述符仍归调用方所有
+    bool watch(int fd, uint32_t events, Handler handler);
+    
+    // 取消注册（可在回调中调用，包括取消正在分派的描述符）
+    void unwatch(int fd);
+    
+    // 创建周期定时器并注册，返回定时器描述符（失败时返回-1），用removeTimer删除
+    int addTimer(std::chrono::nanoseconds interval, std::function<void()> handler);
+    void removeTimer(int timerFd);
+    
+    // 通过signalfd接收信号，调用方需在创建其他线程之前用blockSignals屏蔽这些信号
+    bool watchSignals(std::initializer_list<int> signals, std::function<void(int)> handler);
+    
+    // 在调用线程（及之后创建的线程）中屏蔽信号，使它们只能通过signalfd读取
+    static void blockSignals(std::initializer_list<int> signals);
+    
+    // 等待并分派一轮事件，timeout为负数时一直等待，返回分派的事件数
+    int runOnce(std::chrono::milliseconds timeout);
+    
+    // 唤醒阻塞中的runOnce（可在任意线程调用）
+    void wake();
+
+private:
+    // 一个已注册的描述符
+    struct Watch {
+        Handler handler;
+    };
+
+private:
+    int m_epollFd;                                      // epoll实例
+    int m_wakeFd;                                       // 唤醒用的eventfd
+    int m_signalFd;                                     // signalfd（-1表示未使用）
+    std::map<int, std::shared_ptr<Watch>> m_watches;    // 描述符 -> 回调
+};
+#endif
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,187 @@
+#include "hold_model.h"
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    // 去掉首尾空白
+    std::string trim(const std::string& text) {
+        size_t begin = text.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        size_t end = text.find_last_not_of(" \t\r\n");
+        return text.substr(begin, end - begin + 1);
+    }
+    
+    // 按分隔符拆分
+    std::vector<std::string> split(const std::string& text, char separator) {
+        std::vector<std::string> parts;
+        std::stringstream stream(text);
+        std::string part;
+        while (std::getline(stream, part, separator)) {
+            parts.push_back(trim(part));
+        }
+        return parts;
+    }
+    
+    // 解析非负数，失败时返回false
+    bool parseNumber(const std::string& text, double& value) {
+        try {
+            size_t used = 0;
+            value = std::stod(text, &used);
+            return used == text.size() && value >= 0;
+        } catch (...) {
+            return false;
+        }
+    }
+    
+    // 解析时长（毫秒），支持ms/s后缀，无后缀时为毫秒
+    bool parseMs(const std::string& text, double& ms) {
+        if (text.size() > 2 && text.compare(text.size() - 2, 2, "ms") == 0) {
+            return parseNumber(text.substr(0, text.size() - 2), ms);
+        }
+        if (text.size() > 1 && text.back() == 's') {
+            if (!parseNumber(text.substr(0, text.size() - 1), ms)) {
+                return false;
+            }
+            ms *= 1000.0;
+            return true;
+        }
+        return parseNumber(text, ms);
+    }
+}
+
+HoldModel::HoldModel() {
+}
+
+bool HoldModel::addComponent(const std::string& spec) {
+    size_t colon = spec.find(':');
+    std::string kind = colon == std::string::npos ? std::string() : spec.substr(0, colon);
+    std::string params = colon == std::string::npos ? spec : spec.substr(colon + 1);
+    
+    Component component = {Kind::Fixed, 0, 0};
+    bool valid = false;
+    if (kind.empty()) {
+        valid = parseMs(params, component.a);
+    } else if (kind == "uniform") {
+        component.kind = Kind::Uniform;
+        std::vector<std::string> range = split(params, '-');
+        valid = range.size() == 2 && parseMs(range[0], component.a) && parseMs(range[1], component.b) &&
+                component.a <= component.b;
+    } else if (kind == "exp") {
+        component.kind = Kind::Exponential;
+        valid = parseMs(params, component.a) && component.a > 0;
+    } else if (kind == "normal") {
+        component.kind = Kind::Normal;
+        std::vector<std::string> parts = split(params, '/');
+        valid = parts.size() == 2 && parseMs(parts[0], component.a) && parseMs(parts[1], component.b);
+    } else if (kind == "repeat") {
+        component.kind = Kind::Repeat;
+        valid = parseNumber(params, component.a);
+    } else {
+        std::cerr << "错误: 未知的按住时长分布: " << kind << "（可选 uniform/exp/normal/repeat，或直接给出毫秒数）"
+                  << std::endl;
+        return false;
+    }
+    
+    if (!valid) {
+        std::cerr << "错误: 无效的按住时长: " << spec << std::endl;
+        return false;
+    }
+    m_components.push_back(component);
+    return true;
+}
+
+bool HoldModel::parse(const std::string& specs) {
+    for (const std::string& spec : split(specs, ',')) {
+        if (!spec.empty() && !addComponent(spec)) {
+            return false;
+        }
+    }
+    if (m_components.empty()) {
+        std::cerr << "错误: 按住时长不能为空" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool HoldModel::empty() const {
+    return m_components.empty();
+}
+
+size_t HoldModel::componentCount() const {
+    return m_components.size();
+}
+
+const HoldModel::Component& HoldModel::component(size_t index) const {
+    return m_components[index];
+}
+
+bool HoldModel::usesAutoRepeat() const {
+    return std::any_of(m_components.begin(), m_components.end(),
+                       [](const Component& component) { return component.kind == Kind::Repeat; });
+}
+
+std::vector<int64_t> HoldModel::sample(size_t count, uint32_t seed, double repeatDelayMs, double repeatIntervalMs) const {
+    std::vector<int64_t> durations;
+    if (m_components.empty()) {
+        return durations;
+    }
+    durations.reserve(count);
+    std::mt19937_64 generator(seed);
+    std::uniform_int_distribution<size_t> pick(0, m_components.size() - 1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> gauss(0.0, 1.0);
+    
+    for (size_t i = 0; i < count; i++) {
+        const Component& component = m_components[pick(generator)];
+        double ms = 0;
+        switch (component.kind) {
+            case Kind::Uniform:
+                ms = component.a + (component.b - component.a) * unit(generator);
+                break;
+            case Kind::Exponential:
+                ms = -component.a * std::log(1.0 - unit(generator));
+                break;
+            case Kind::Normal:
+                ms = std::max(0.0, component.a + component.b * gauss(generator));
+                break;
+            case Kind::Repeat:
+                // 停在两次重复之间，松开时不会与下一次重复竞争
+                ms = repeatDelayMs + (component.a + 0.5) * repeatIntervalMs;
+                break;
+            case Kind::Fixed:
+            default:
+                ms = component.a;
+                break;
+        }
+        durations.push_back(static_cast<int64_t>(std::llround(ms * 1e6)));
+    }
+    return durations;
+}
+
+std::string HoldModel::describe(const Component& component) {
+    std::ostringstream out;
+    switch (component.kind) {
+        case Kind::Uniform:
+            out << "均匀分布 " << component.a << "-" << component.b << " 毫秒";
+            break;
+        case Kind::Exponential:
+            out << "指数分布，平均 " << component.a << " 毫秒";
+            break;
+        case Kind::Normal:
+            out << "正态分布 " << component.a << "±" << component.b << " 毫秒";
+            break;
+        case Kind::Repeat:
+            out << "按住到自动重复 " << component.a << " 次";
+            break;
+        case Kind::Fixed:
+        default:
+            out << "固定 " << component.a << " 毫秒";
+            break;
+    }
+    return out.str();
+}
@@ -0,0 +1,66 @@
+#ifndef HOLD_MODEL_H
+#define HOLD_MODEL_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * 按键按住时长模型
+ * 由若干分量组成，每次按键等概率选择一个分量抽取按住时长。
+ * 时长在开始输入前一次性抽样为循环使用的序列，输入线程只需按顺序读取，
+ * 热循环中没有随机数和浮点运算
+ *
+ * 分量格式（时长默认单位为毫秒，可带ms/s后缀）：
+ *   50                     固定50毫秒
+ *   uniform:20-200         均匀分布
+ *   exp:80                 指数分布，平均80毫秒
+ *   normal:120/30          正态分布（平均值/标准差，截断到0以上）
+ *   repeat:3               按住到触发3次自动重复：重复延迟 + 3个重复间隔 + 半个间隔
+ */
+class HoldModel {
+public:
+    // 分量类型
+    enum class Kind {
+        Fixed,
+        Uniform,
+        Exponential,
+        Normal,
+        Repeat
+    };
+    
+    // 一个分量
+    struct Component {
+        Kind kind;
+        double a;       // 固定值/下限/平均值（毫秒），repeat为重复次数
+        double b;       // 上限/标准差（毫秒）
+    };
+    
+    HoldModel();
+    
+    // 解析逗号分隔的分量列表，失败时返回false并输出错误
+    bool parse(const std::string& specs);
+    
+    bool empty() const;
+    size_t componentCount() const;
+    const Component& component(size_t index) const;
+    
+    // 是否包含repeat分量（需要查询自动重复的延迟和间隔）
+    bool usesAutoRepeat() const;
+    
+    // 抽取count个按住时长（纳秒），repeat分量按给定的自动重复延迟和间隔（毫秒）换算
+    std::vector<int64_t> sample(size_t count, uint32_t seed, double repeatDelayMs, double repeatIntervalMs) const;
+    
+    // 分量的可读描述
+    static std::string describe(const Component& component);
+
+private:
+    // 解析一个分量
+    bool addComponent(const std::string& spec);
+
+private:
+    std::vector<Component> m_components;    // 分量列表
+};
+
+#endif // HOLD_MODEL_H
@@ -0,0 +1,845 @@
+#include "input_worker.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+    // 距离截止时间超过该值时先在控制状态上等待（可被打断），剩余部分由调度器精确等待
+    const DeadlineScheduler::Duration InterruptibleWaitMargin = std::chrono::milliseconds(2);
+}
+
+InputControl::InputControl()
+    : state(RunState::Stopped)
+    , finishedWorkers(0)
+    , plan(std::make_shared<const KeystrokePlan>())
+    , generation(0)
+{
+}
+
+RunState InputControl::current() const {
+    return state.load(std::memory_order_acquire);
+}
+
+bool InputControl::shouldContinue() const {
+    RunState now = current();
+    return now == RunState::Active || now == RunState::Paused;
+}
+
+bool InputControl::transition(RunState from, RunState to) {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (state.load(std::memory_order_relaxed) != from) {
+            return false;
+        }
+        state.store(to, std::memory_order_release);
+    }
+    stateChanged.notify_all();
+    return true;
+}
+
+bool InputControl::requestExit() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (state.load(std::memory_order_relaxed) == RunState::Stopped) {
+            return false;
+        }
+        state.store(RunState::Exiting, std::memory_order_release);
+    }
+    stateChanged.notify_all();
+    return true;
+}
+
+void InputControl::reset(RunState to) {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        state.store(to, std::memory_order_release);
+    }
+    stateChanged.notify_all();
+}
+
+bool InputControl::waitWhilePaused() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    stateChanged.wait(lock, [this] { return state.load(std::memory_order_relaxed) != RunState::Paused; });
+    return state.load(std::memory_order_relaxed) == RunState::Active;
+}
+
+bool InputControl::sleepUntil(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    return !stateChanged.wait_until(lock, deadline, [this] {
+        return state.load(std::memory_order_relaxed) != RunState::Active;
+    });
+}
+
+void InputControl::publish() {
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+void InputControl::markFinished() {
+    finishedWorkers++;
+    if (notify) {
+        notify();
+    }
+}
+
+InputWorker::InputWorker(size_t index, InputControl& control, std::unique_ptr<KeyEventSink> sink,
+                         const WorkerSettings& settings)
+    : m_index(index)
+    , m_control(control)
+    , m_sink(std::move(sink))
+    , m_settings(settings)
+    , m_generation(~0ull)
+    , m_config(std::atomic_load(&control.config))
+    , m_holdKeysGeneration(~0ull)
+    , m_maxHeld(0)
+    , m_forcedReleases(0)
+    , m_randomGenerator(std::random_device{}())
+{
+    m_scheduler.setPeriod(settings.period);
+    m_scheduler.setSpinThreshold(settings.spinThreshold);
+    m_scheduler.setMissPolicy(settings.missPolicy);
+    m_batchBuffer.reserve(settings.batchSize > 0 ? settings.batchSize + 16 : 1024);
+    m_holding.reserve(settings.holdDurations.empty() ? 0 : settings.overlap + 1);
+    m_pointerBuffer.reserve(settings.pointer ? 2 * PointerStorm::KindCount * PointerTimeline::MaxCatchUp : 0);
+}
+
+InputWorker::~InputWorker() {
+    join();
+}
+
+void InputWorker::start(DeadlineScheduler::TimePoint startTime) {
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&InputWorker::run, this, startTime);
+    }
+}
+
+void InputWorker::join() {
+    if (m_thread.joinable()) {
+        try {
+            m_thread.join();
+        } catch (...) {
+            // 忽略join异常
+        }
+    }
+}
+
+size_t InputWorker::index() const {
+    return m_index;
+}
+
+const DeadlineScheduler& InputWorker::scheduler() const {
+    return m_scheduler;
+}
+
+const KeyEventSink& InputWorker::sink() const {
+    return *m_sink;
+}
+
+const AtomicHistogram& InputWorker::lateness() const {
+    return m_lateness;
+}
+
+DeadlineScheduler::TimePoint InputWorker::startTime() const {
+    return m_startTime;
+}
+
+DeadlineScheduler::TimePoint InputWorker::endTime() const {
+    return m_endTime;
+}
+
+const RealtimeStatus& InputWorker::realtimeStatus() const {
+    return m_realtimeStatus;
+}
+
+size_t InputWorker::maxHeld() const {
+    return m_maxHeld.load(std::memory_order_relaxed);
+}
+
+uint64_t InputWorker::forcedReleases() const {
+    return m_forcedReleases.load(std::memory_order_relaxed);
+}
+
+const PointerTimeline& InputWorker::pointer() const {
+    return m_pointer;
+}
+
+size_t InputWorker::getRandomGroupIndex(size_t groupCount) {
+    if (groupCount <= 1) {
+        return 0;
+    }
+    
+    std::uniform_int_distribution<size_t> dist(0, groupCount - 1);
+    return dist(m_randomGenerator);
+}
+
+void InputWorker::refreshSnapshots() {
+    uint64_t generation = m_control.generation.load(std::memory_order_acquire);
+    if (generation == m_generation) {
+        return;
+    }
+    m_generation = generation;
+    m_plan = std::atomic_load(&m_control.plan);
+    m_keyMap = std::atomic_load(&m_control.keyMap);
+    
+    // 新的周期从下一次advance()开始生效：当前周期按原周期结束，下一个截止时间按新周期计算。
+    // 负载曲线、回放和场景自行决定节奏，不受频率配置影响
+    std::shared_ptr<const InputConfig> config = std::atomic_load(&m_control.config);
+    if (config == m_config) {
+        return;
+    }
+    m_config = config;
+    if (config && m_settings.intervals.empty() && !m_settings.trace) {
+        DeadlineScheduler::Duration period = config->period * m_settings.periodShare;
+        if (period != m_settings.period) {
+            if (m_settings.period.count() == 0) {
+                // 从无间隔连续输入切换到定时输入，从现在开始按新周期调度
+                m_scheduler.reset(DeadlineScheduler::Clock::now());
+            }
+            m_settings.period = period;
+            m_scheduler.setPeriod(period);
+        }
+    }
+}
+
+const KeystrokePlan& InputWorker::compileCorpusGroup(const TextCorpus& corpus) {
+    m_corpusPlan.clear();
+    if (m_keyMap) {
+        m_corpusPlan.addGroup(corpus.group(corpus.sample(m_randomGenerator)), *m_keyMap);
+    }
+    return m_corpusPlan;
+}
+
+void InputWorker::simulateKeyInput(const TimedKeyEvent* events, size_t count) {
+    m_sink->send(events, count);
+}
+
+void InputWorker::queueCharEvents(const KeyEvent* events, size_t count, uint32_t delayMs) {
+    for (size_t i = 0; i < count; i++) {
+        m_batchBuffer.push_back(TimedKeyEvent{events[i], i == 0 ? delayMs : 0});
+    }
+}
+
+void InputWorker::simulateStringInput(const KeystrokePlan& plan, const KeystrokePlan::Group& group) {
+    const uint32_t charDelayMs = 10; // 字符间小延迟
+    const KeyEvent* event = plan.events() + group.firstEvent;
+    const KeyEvent* end = event + group.eventCount;
+    while (event < end && m_control.current() == RunState::Active) {
+        // 批内字符间的延迟由服务器计时，批与批之间在本地等待
+        m_batchBuffer.clear();
+        do {
+            size_t count = KeystrokePlan::charEventCount(event, end);
+            queueCharEvents(event, count, m_batchBuffer.empty() ? 0 : charDelayMs);
+            event += count;
+        } while (event < end && (m_settings.batchSize == 0 || m_batchBuffer.size() < m_settings.batchSize));
+        
+        simulateKeyInput(m_batchBuffer.data(), m_batchBuffer.size());
+        m_control.sleepUntil(DeadlineScheduler::Clock::now() + std::chrono::milliseconds(charDelayMs));
+    }
+}
+
+void InputWorker::trackHeldKey(const KeyEvent& event) {
+    auto held = std::find_if(m_heldKeys.begin(), m_heldKeys.end(),
+                             [&](const KeyEvent& key) { return key.code == event.code; });
+    if (event.isPress() && held == m_heldKeys.end()) {
+        m_heldKeys.push_back(event);
+    } else if (!event.isPress() && held != m_heldKeys.end()) {
+        m_heldKeys.erase(held);
+    }
+}
+
+void InputWorker::sendHeldKeys(bool press) {
+    if (m_heldKeys.empty()) {
+        return;
+    }
+    m_heldBuffer.clear();
+    for (const KeyEvent& key : m_heldKeys) {
+        KeyEvent event = key;
+        event.flags = press ? KeyEvent::Press : 0;
+        m_heldBuffer.push_back(TimedKeyEvent{event, 0});
+    }
+    simulateKeyInput(m_heldBuffer.data(), m_heldBuffer.size());
+}
+
+bool InputWorker::waitForDeadline(DeadlineScheduler::TimePoint deadline) {
+    DeadlineScheduler::TimePoint wakeTime = deadline - InterruptibleWaitMargin;
+    if (wakeTime > DeadlineScheduler::Clock::now() && !m_control.sleepUntil(wakeTime)) {
+        return false;
+    }
+    m_lateness.record(m_scheduler.waitUntil(deadline).count());
+    return true;
+}
+
+bool InputWorker::waitWithPointer(DeadlineScheduler::TimePoint deadline) {
+    while (m_pointer.nextDeadline() < deadline) {
+        if (!waitForDeadline(m_pointer.nextDeadline())) {
+            return false;
+        }
+        sendPointerEvents(DeadlineScheduler::Clock::now());
+    }
+    if (!waitForDeadline(deadline)) {
+        return false;
+    }
+    // 与按键截止时间重合的鼠标事件在同一次唤醒中发送，否则下一次等待时它已过期，被计为错过截止时间
+    sendPointerEvents(DeadlineScheduler::Clock::now());
+    return true;
+}
+
+void InputWorker::sendPointerEvents(DeadlineScheduler::TimePoint now) {
+    if (m_pointer.nextDeadline() > now) {
+        return;
+    }
+    m_pointerBuffer.clear();
+    m_pointer.collectDue(now, m_pointerBuffer);
+    simulateKeyInput(m_pointerBuffer.data(), m_pointerBuffer.size());
+}
+
+bool InputWorker::waitForOffset(DeadlineScheduler::TimePoint& base, DeadlineScheduler::Duration offset) {
+    while (m_control.shouldContinue()) {
+        // 暂停时释放按下的键，恢复时重新按下，并把起点后移暂停的时长
+        if (m_control.current() == RunState::Paused) {
+            DeadlineScheduler::TimePoint pauseStart = DeadlineScheduler::Clock::now();
+            sendHeldKeys(false);
+            bool resumed = m_control.waitWhilePaused();
+            base += DeadlineScheduler::Clock::now() - pauseStart;
+            if (!resumed) {
+                m_heldKeys.clear();
+                return false;
+            }
+            sendHeldKeys(true);
+            continue;
+        }
+        
+        // 等待被暂停或退出打断时重新检查状态
+        if (waitForDeadline(base + offset)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InputWorker::sendBatchAt(DeadlineScheduler::TimePoint& base, DeadlineScheduler::Duration offset) {
+    if (m_batchBuffer.empty()) {
+        return m_control.shouldContinue();
+    }
+    if (!waitForOffset(base, offset)) {
+        return false;
+    }
+    simulateKeyInput(m_batchBuffer.data(), m_batchBuffer.size());
+    for (const TimedKeyEvent& event : m_batchBuffer) {
+        trackHeldKey(event.event);
+    }
+    m_batchBuffer.clear();
+    m_scheduler.advance();
+    return true;
+}
+
+void InputWorker::runScenario(const ScenarioProgram& program, DeadlineScheduler::TimePoint startTime) {
+    // 场景在自己的时钟上执行：Key只排队，Wait在当前时刻发送排队的事件后把时钟前移；
+    // 截止时间都是 起点 + 时钟，不会累积漂移。循环栈是定长数组，运行中不分配内存
+    m_scheduler.setPeriod(DeadlineScheduler::Duration(0));
+    DeadlineScheduler::TimePoint base = startTime + m_settings.phase;
+    DeadlineScheduler::Duration clock(0);
+    std::array<uint32_t, Scenario::MaxLoopDepth> loopRemaining;
+    size_t loopDepth = 0;
+    const ScenarioInstruction* code = program.instructions.data();
+    size_t pc = 0;
+    bool running = !program.instructions.empty();
+    bool finished = false;
+    m_batchBuffer.clear();
+    
+    while (running) {
+        const ScenarioInstruction& instruction = code[pc++];
+        switch (instruction.op) {
+            case ScenarioInstruction::Key:
+                // 两次等待之间的事件很多时（如没有等待的repeat），批次满了先在当前时刻发送，不再扩容
+                if (m_batchBuffer.size() == m_batchBuffer.capacity()) {
+                    running = sendBatchAt(base, clock);
+                }
+                m_batchBuffer.push_back(TimedKeyEvent{instruction.event, 0});
+                break;
+            case ScenarioInstruction::Wait:
+                running = sendBatchAt(base, clock);
+                clock += DeadlineScheduler::Duration(instruction.durationNs);
+                break;
+            case ScenarioInstruction::LoopBegin:
+                loopRemaining[loopDepth++] = instruction.operand;
+                break;
+            case ScenarioInstruction::LoopEnd:
+                // 次数为0的无限循环一直跳回；有限循环计数减到0后出栈
+                if (loopRemaining[loopDepth - 1] == 0 || --loopRemaining[loopDepth - 1] > 0) {
+                    pc = instruction.operand + 1;
+                } else {
+                    loopDepth--;
+                }
+                break;
+            case ScenarioInstruction::Group:
+            case ScenarioInstruction::RandomGroup: {
+                running = sendBatchAt(base, clock);
+                
+                // 字符组来自当前按键计划（映射变化或重新配置时会被替换），随机时有语料库则从语料库抽取
+                refreshSnapshots();
+                const KeystrokePlan* plan = m_plan.get();
+                size_t groupIndex = instruction.operand;
+                if (instruction.op == ScenarioInstruction::RandomGroup) {
+                    if (m_control.corpus) {
+                        plan = &compileCorpusGroup(*m_control.corpus);
+                        groupIndex = 0;
+                    } else {
+                        groupIndex = getRandomGroupIndex(plan->groupCount());
+                    }
+                }
+                if (!running) {
+                    break;
+                }
+                // 字符组在运行中被set-groups删去（或为空）时仍占用一个字符间隔：时钟前移并等到该时刻，
+                // 没有事件要发送时sendBatchAt不会等待，不等待的话循环会空转
+                if (groupIndex >= plan->groupCount() || plan->group(groupIndex).eventCount == 0) {
+                    clock += DeadlineScheduler::Duration(instruction.durationNs);
+                    running = waitForOffset(base, clock);
+                    break;
+                }
+                
+                const KeystrokePlan::Group& group = plan->group(groupIndex);
+                const KeyEvent* event = plan->events() + group.firstEvent;
+                const KeyEvent* end = event + group.eventCount;
+                while (running && event < end) {
+                    size_t count = KeystrokePlan::charEventCount(event, end);
+                    queueCharEvents(event, count, 0);
+                    event += count;
+                    running = sendBatchAt(base, clock);
+                    clock += DeadlineScheduler::Duration(instruction.durationNs);
+                }
+                break;
+            }
+            case ScenarioInstruction::End:
+            default:
+                running = sendBatchAt(base, clock);
+                finished = running;
+                running = false;
+                break;
+        }
+    }
+    
+    // 退出时释放仍按下的键（down之后没有up，或中途退出）
+    sendHeldKeys(false);
+    m_heldKeys.clear();
+    if (finished) {
+        m_control.markFinished();
+    }
+}
+
+void InputWorker::runReplay(TraceReader& trace, DeadlineScheduler::TimePoint startTime) {
+    // 轨迹时刻换算为绝对截止时间：起点 + (t - 第一个事件的时刻) / 速度，
+    // 每个截止时间都由起点直接算出，不会累积漂移；暂停期间起点随之后移
+    m_scheduler.setPeriod(DeadlineScheduler::Duration(0));
+    DeadlineScheduler::TimePoint base = startTime + m_settings.phase;
+    const double scale = 1.0 / m_settings.replaySpeed;
+    RecordedKeyEvent event;
+    bool hasEvent = trace.next(event);
+    const int64_t origin = hasEvent ? event.timestampNs : 0;
+    auto deadlineOf = [&](int64_t timestampNs) {
+        return base + DeadlineScheduler::Duration(static_cast<int64_t>(static_cast<double>(timestampNs - origin) * scale));
+    };
+    
+#ifdef __linux__
+    // 第一个事件发生时已经按下的修饰键（从轨迹中间开始回放时常见）先补按下，
+    // 锁定类修饰键（CapsLock、NumLock）按下会切换状态，不补
+    refreshSnapshots();
+    const KeyMap* keyMap = m_keyMap.get();
+    if (hasEvent && keyMap && trace.codeType() == TraceHeader::X11Keycode) {
+        const uint16_t heldMask = ShiftMask | ControlMask | Mod1Mask | Mod3Mask | Mod4Mask | Mod5Mask;
+        for (int i = 0; i < 8; i++) {
+            uint8_t keycode = keyMap->modifierKeycode(i);
+            if ((event.event.modifiers & heldMask & (1 << i)) && keycode != 0) {
+                trackHeldKey(KeyEvent{keycode, 0, KeyEvent::Press});
+            }
+        }
+        sendHeldKeys(true);
+    }
+#endif
+    
+    while (hasEvent) {
+        if (!waitForOffset(base, deadlineOf(event.timestampNs) - base)) {
+            break;
+        }
+        DeadlineScheduler::TimePoint batchStart = deadlineOf(event.timestampNs);
+        
+        // 批量大小为0时只合并已经到期的事件；否则和普通模式一样，
+        // 批内后续事件的时间差换算成毫秒延迟交给XTest
+        DeadlineScheduler::TimePoint now = DeadlineScheduler::Clock::now();
+        m_batchBuffer.clear();
+        int64_t queuedMs = 0;
+        do {
+            uint32_t delayMs = 0;
+            if (!m_batchBuffer.empty() && m_settings.batchSize != 0) {
+                int64_t offsetMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadlineOf(event.timestampNs) - batchStart).count();
+                delayMs = static_cast<uint32_t>(offsetMs - queuedMs);
+                queuedMs = offsetMs;
+            }
+            m_batchBuffer.push_back(TimedKeyEvent{event.event, delayMs});
+            trackHeldKey(event.event);
+            hasEvent = trace.next(event);
+        } while (hasEvent && (m_settings.batchSize == 0 ? deadlineOf(event.timestampNs) <= now
+                                                        : m_batchBuffer.size() < m_settings.batchSize));
+        
+        simulateKeyInput(m_batchBuffer.data(), m_batchBuffer.size());
+        m_scheduler.advance();
+    }
+    
+    // 退出时释放仍按下的键，避免目标端留下卡住的修饰键（暂停中退出时已释放过）
+    sendHeldKeys(false);
+    if (!hasEvent) {
+        m_control.markFinished();
+    }
+}
+
+void InputWorker::refreshHoldKeys() {
+    if (m_holdKeysGeneration == m_generation) {
+        return;
+    }
+    m_holdKeysGeneration = m_generation;
+    m_holdKeys.clear();
+    
+    // 只使用一次按下加一次释放、不需要修饰键的字符：带修饰键的字符重叠按住时修饰键状态会互相干扰，
+    // Unicode字符的临时键码可能在按住期间被淘汰改绑
+    const KeystrokePlan* plan = m_plan.get();
+    for (size_t g = 0; plan && g < plan->groupCount(); g++) {
+        const KeystrokePlan::Group& group = plan->group(g);
+        const KeyEvent* event = plan->events() + group.firstEvent;
+        const KeyEvent* end = event + group.eventCount;
+        while (event < end) {
+            size_t count = KeystrokePlan::charEventCount(event, end);
+            const KeyEvent& press = event[0];
+            bool plain = count == 2 && press.isPress() && press.modifiers == 0 && !press.isUnicode();
+            if (plain && std::none_of(m_holdKeys.begin(), m_holdKeys.end(),
+                                      [&](const KeyEvent& key) { return key.code == press.code; })) {
+                m_holdKeys.push_back(KeyEvent{press.code, 0, KeyEvent::Press});
+            }
+            event += count;
+        }
+    }
+}
+
+void InputWorker::queueHoldRelease(size_t index) {
+    KeyEvent release = m_holding[index].key;
+    release.flags = 0;
+    m_batchBuffer.push_back(TimedKeyEvent{release, 0});
+    m_holding[index] = m_holding.back();
+    m_holding.pop_back();
+}
+
+void InputWorker::releaseHolding() {
+    m_batchBuffer.clear();
+    while (!m_holding.empty()) {
+        queueHoldRelease(m_holding.size() - 1);
+    }
+    if (!m_batchBuffer.empty()) {
+        simulateKeyInput(m_batchBuffer.data(), m_batchBuffer.size());
+    }
+}
+
+void InputWorker::runHold(DeadlineScheduler::TimePoint startTime) {
+    // 按下时刻由调度器给出，释放时刻 = 按下的截止时间 + 按住时长（不受发送迟到影响）；
+    // 每轮等到最近的按下或释放时刻，把此时到期的释放和按下合成一批发送。
+    // 按住的键最多overlap个，数量很小，线性查找比有序结构更快，运行中不分配内存
+    m_scheduler.reset(startTime + m_settings.phase);
+    if (m_settings.pointer) {
+        m_pointer.reset(*m_settings.pointer, startTime + m_settings.phase);
+    }
+    const std::vector<int64_t>& holds = m_settings.holdDurations;
+    const std::vector<int64_t>& intervals = m_settings.intervals;
+    size_t holdIndex = 0;
+    size_t intervalIndex = 0;
+    bool wasPaused = false;
+    
+    while (m_control.shouldContinue()) {
+        // 暂停时释放所有按住的键，恢复后重新开始按下
+        if (m_control.current() == RunState::Paused) {
+            releaseHolding();
+            wasPaused = true;
+            m_control.waitWhilePaused();
+            continue;
+        }
+        if (wasPaused) {
+            wasPaused = false;
+            m_scheduler.skipTo(DeadlineScheduler::Clock::now());
+            m_pointer.skipTo(DeadlineScheduler::Clock::now());
+        }
+        
+        // 负载曲线结束后不再按下，等按住的键全部释放后线程退出
+        bool profileDone = !intervals.empty() && intervalIndex >= intervals.size();
+        if (profileDone && m_holding.empty()) {
+            m_control.markFinished();
+            break;
+        }
+        if (!profileDone && !intervals.empty()) {
+            m_scheduler.setPeriod(DeadlineScheduler::Duration(intervals[intervalIndex]));
+        }
+        
+        refreshSnapshots();
+        refreshHoldKeys();
+        bool pressPending = !profileDone && !m_holdKeys.empty();
+        
+        DeadlineScheduler::TimePoint next = pressPending ? m_scheduler.cycleStart()
+                                                         : DeadlineScheduler::TimePoint::max();
+        for (const HoldingKey& holding : m_holding) {
+            next = std::min(next, holding.release);
+        }
+        next = std::min(next, m_pointer.nextDeadline());
+        if (next == DeadlineScheduler::TimePoint::max()) {
+            // 没有可按住的键，等待一小段时间（可被暂停和退出打断）
+            m_control.sleepUntil(DeadlineScheduler::Clock::now() + std::chrono::milliseconds(100));
+            continue;
+        }
+        if (!waitForDeadline(next)) {
+            continue;
+        }
+        
+        // 到期的释放排在按下之前：同一时刻先松开旧键再按新键；到期的鼠标事件合在同一批
+        DeadlineScheduler::TimePoint now = DeadlineScheduler::Clock::now();
+        m_batchBuffer.clear();
+        if (m_pointer.nextDeadline() <= now) {
+            m_pointer.collectDue(now, m_batchBuffer);
+        }
+        for (size_t i = 0; i < m_holding.size(); ) {
+            if (m_holding[i].release <= now) {
+                queueHoldRelease(i);
+            } else {
+                i++;
+            }
+        }
+        
+        DeadlineScheduler::TimePoint pressAt = m_scheduler.cycleStart();
+        if (pressPending && pressAt <= now) {
+            // 已按住overlap个键（或所有可用的键都已按住）时，提前释放最早到期的键
+            size_t limit = std::min(m_settings.overlap, m_holdKeys.size());
+            while (m_holding.size() >= limit) {
+                size_t earliest = 0;
+                for (size_t i = 1; i < m_holding.size(); i++) {
+                    if (m_holding[i].release < m_holding[earliest].release) {
+                        earliest = i;
+                    }
+                }
+                queueHoldRelease(earliest);
+                m_forcedReleases.fetch_add(1, std::memory_order_relaxed);
+            }
+            
+            // 随机选一个键，已按住时顺序找下一个未按住的
+            size_t keyIndex = getRandomGroupIndex(m_holdKeys.size());
+            auto isHeld = [&](const KeyEvent& key) {
+                return std::any_of(m_holding.begin(), m_holding.end(),
+                                   [&](const HoldingKey& holding) { return holding.key.code == key.code; });
+            };
+            while (isHeld(m_holdKeys[keyIndex])) {
+                keyIndex = (keyIndex + 1) % m_holdKeys.size();
+            }
+            
+            const KeyEvent& key = m_holdKeys[keyIndex];
+            m_batchBuffer.push_back(TimedKeyEvent{key, 0});
+            m_holding.push_back(HoldingKey{key, pressAt + DeadlineScheduler::Duration(holds[holdIndex])});
+            holdIndex = (holdIndex + 1) % holds.size();
+            if (m_holding.size() > m_maxHeld.load(std::memory_order_relaxed)) {
+                m_maxHeld.store(m_holding.size(), std::memory_order_relaxed);
+            }
+            
+            uint64_t dropped = m_scheduler.advance();
+            intervalIndex += 1 + dropped;
+        }
+        
+        if (!m_batchBuffer.empty()) {
+            simulateKeyInput(m_batchBuffer.data(), m_batchBuffer.size());
+        }
+    }
+    
+    // 退出时释放仍按住的键，避免目标端留下卡住的键
+    releaseHolding();
+}
+
+void InputWorker::runTyping(const TypingModel& model, DeadlineScheduler::TimePoint startTime) {
+    // 每个字符一个截止时间：下一个字符和它与上一个字符的按下间隔都从模型中抽取，
+    // 间隔按 当前周期 / 模型平均间隔 缩放，平均频率等于请求的频率（重新配置后随之改变）。
+    // 调度器的周期逐字符设为抽到的间隔，错过截止时间的处理和暂停恢复与普通输入相同
+    m_scheduler.reset(startTime + m_settings.phase);
+    if (m_settings.pointer) {
+        m_pointer.reset(*m_settings.pointer, startTime + m_settings.phase);
+    }
+    auto random64 = [this]() {
+        uint64_t high = m_randomGenerator();
+        return (high << 32) | m_randomGenerator();
+    };
+    uint32_t state = model.startState(random64());
+    int64_t intervalNs = 0;
+    uint32_t symbol = model.next(state, random64(), random64(), intervalNs);
+    std::chrono::nanoseconds scaledPeriod(-1);
+    double scale = 0;
+    bool wasPaused = false;
+    
+    while (m_control.shouldContinue()) {
+        if (m_control.current() == RunState::Paused) {
+            wasPaused = true;
+            m_control.waitWhilePaused();
+            continue;
+        }
+        if (wasPaused) {
+            wasPaused = false;
+            m_scheduler.skipTo(DeadlineScheduler::Clock::now());
+            m_pointer.skipTo(DeadlineScheduler::Clock::now());
+        }
+        
+        // 符号i对应字符组i，映射变化后字符组随之重新编译，编号不变
+        refreshSnapshots();
+        if (m_settings.period != scaledPeriod) {
+            scaledPeriod = m_settings.period;
+            scale = static_cast<double>(scaledPeriod.count()) / model.meanIntervalNs();
+        }
+        if (!waitWithPointer(m_scheduler.cycleStart())) {
+            continue;
+        }
+        if (symbol < m_plan->groupCount()) {
+            const KeystrokePlan::Group& group = m_plan->group(symbol);
+            m_batchBuffer.clear();
+            queueCharEvents(m_plan->events() + group.firstEvent, group.eventCount, 0);
+            simulateKeyInput(m_batchBuffer.data(), m_batchBuffer.size());
+        }
+        
+        symbol = model.next(state, random64(), random64(), intervalNs);
+        m_scheduler.setPeriod(DeadlineScheduler::Duration(static_cast<int64_t>(intervalNs * scale)));
+        m_scheduler.advance();
+    }
+}
+
+void InputWorker::run(DeadlineScheduler::TimePoint startTime) {
+    // 实时模式的设置只作用于本线程，在第一个截止时间之前完成
+    if (m_settings.realtime.enabled) {
+        m_realtimeStatus = Realtime::applyToCurrentThread(m_settings.realtime, m_index);
+        m_realtimeStatus.timerFd = m_scheduler.useTimerFd();
+    }
+    m_startTime = DeadlineScheduler::Clock::now();
+    if (m_settings.trace) {
+        runReplay(*m_settings.trace, startTime);
+        m_endTime = DeadlineScheduler::Clock::now();
+        return;
+    }
+    std::shared_ptr<const ScenarioProgram> scenario = std::atomic_load(&m_control.scenario);
+    if (scenario) {
+        runScenario(*scenario, startTime);
+        m_endTime = DeadlineScheduler::Clock::now();
+        return;
+    }
+    if (!m_settings.holdDurations.empty()) {
+        runHold(startTime);
+        m_endTime = DeadlineScheduler::Clock::now();
+        return;
+    }
+    if (m_control.typing) {
+        runTyping(*m_control.typing, startTime);
+        m_endTime = DeadlineScheduler::Clock::now();
+        return;
+    }
+    
+    m_scheduler.reset(startTime + m_settings.phase);
+    if (m_settings.pointer) {
+        m_pointer.reset(*m_settings.pointer, startTime + m_settings.phase);
+    }
+    bool wasPaused = false;
+    const std::vector<int64_t>& intervals = m_settings.intervals;
+    size_t intervalIndex = 0;
+    
+    while (m_control.shouldContinue()) {
+        // 如果暂停，阻塞到恢复或退出
+        if (m_control.current() == RunState::Paused) {
+            wasPaused = true;
+            m_control.waitWhilePaused();
+            continue;
+        }
+        
+        // 暂停恢复后跳过暂停期间的周期，保持原有相位，各工作线程仍然错开
+        if (wasPaused) {
+            wasPaused = false;
+            m_scheduler.skipTo(DeadlineScheduler::Clock::now());
+            m_pointer.skipTo(DeadlineScheduler::Clock::now());
+        }
+        
+        // 按负载曲线运行时，每个周期的长度取自预先算好的序列，曲线结束后线程退出
+        if (!intervals.empty()) {
+            if (intervalIndex >= intervals.size()) {
+                m_control.markFinished();
+                break;
+            }
+            m_scheduler.setPeriod(DeadlineScheduler::Duration(intervals[intervalIndex]));
+        }
+        
+        // 每个周期检查一次快照版本，映射变化或重新配置后计划和周期会被原子替换，
+        // 在下一个截止时间生效；语料库模式下每个周期抽取一行，只编译这一行
+        refreshSnapshots();
+        const KeystrokePlan* plan = m_plan.get();
+        size_t groupIndex = 0;
+        if (m_control.corpus) {
+            plan = &compileCorpusGroup(*m_control.corpus);
+        } else if (!plan->empty()) {
+            groupIndex = getRandomGroupIndex(plan->groupCount());
+        }
+        
+        if (!plan->empty() && m_settings.period.count() > 0) {
+            const KeystrokePlan::Group& group = plan->group(groupIndex);
+            const KeyEvent* event = plan->events() + group.firstEvent;
+            const KeyEvent* end = event + group.eventCount;
+            size_t charCount = group.charCount;
+            
+            // 将整个输入周期平均分配给每个字符，每个字符对应一个绝对截止时间
+            // 例如：100ms周期，4个字符 -> 在0、25、50、75ms处输入
+            for (size_t i = 0; i < charCount && event < end; ) {
+                // 检查是否暂停或退出，等待中暂停或退出时立即结束本周期
+                if (m_control.current() != RunState::Active) {
+                    break;
+                }
+                
+                // 字符之间到期的鼠标事件在各自的截止时间插入发送
+                DeadlineScheduler::TimePoint batchStart = m_scheduler.slotDeadline(i, charCount);
+                if (!waitWithPointer(batchStart)) {
+                    break;
+                }
+                
+                // 从当前字符开始组成一批：批内后续字符的截止时间换算成相对上一个字符的
+                // 毫秒延迟交给XTest，按累计偏移取整，避免亚毫秒间隔的舍入误差累积
+                m_batchBuffer.clear();
+                int64_t queuedMs = 0;
+                do {
+                    uint32_t delayMs = 0;
+                    if (!m_batchBuffer.empty()) {
+                        int64_t offsetMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            m_scheduler.slotDeadline(i, charCount) - batchStart).count();
+                        delayMs = static_cast<uint32_t>(offsetMs - queuedMs);
+                        queuedMs = offsetMs;
+                    }
+                    size_t count = KeystrokePlan::charEventCount(event, end);
+                    queueCharEvents(event, count, delayMs);
+                    event += count;
+                    i++;
+                } while (i < charCount && event < end &&
+                         (m_settings.batchSize == 0 || m_batchBuffer.size() < m_settings.batchSize));
+                
+                // 输入这一批字符（含修饰键）
+                simulateKeyInput(m_batchBuffer.data(), m_batchBuffer.size());
+            }
+            
+            // 进入下一个周期，下一轮在其第一个时间槽（即周期起点）等待，
+            // 而不是按已用时间计算剩余等待
+            uint64_t dropped = m_scheduler.advance();
+            intervalIndex += 1 + dropped;
+        } else if (plan->empty() && m_pointer.active()) {
+            // 没有输入内容时只注入鼠标事件
+            if (waitForDeadline(m_pointer.nextDeadline())) {
+                sendPointerEvents(DeadlineScheduler::Clock::now());
+            }
+        } else if (plan->empty()) {
+            // 如果没有输入内容，等待一小段时间（可被暂停和退出打断）
+            m_control.sleepUntil(DeadlineScheduler::Clock::now() + std::chrono::milliseconds(100));
+        } else {
+            // 如果延迟为0，直接输入，每组之前补发已到期的鼠标事件
+            sendPointerEvents(DeadlineScheduler::Clock::now());
+            simulateStringInput(*plan, plan->group(groupIndex));
+        }
+    }
+    
+    m_endTime = DeadlineScheduler::Clock::now();
+}
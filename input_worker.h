@@ -0,0 +1,244 @@
+#ifndef INPUT_WORKER_H
+#define INPUT_WORKER_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <random>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include "deadline_scheduler.h"
+#include "keystroke_plan.h"
+#include "key_event_sink.h"
+#include "latency_histogram.h"
+#include "text_corpus.h"
+#include "key_trace.h"
+#include "scenario.h"
+#include "realtime.h"
+#include "pointer_storm.h"
+#include "typing_model.h"
+
+/**
+ * 运行中可替换的输入配置
+ * 不可变快照：修改时构造新的快照整体替换，工作线程在下一个截止时间生效
+ */
+struct InputConfig {
+    std::chrono::nanoseconds period;            // 输入周期（所有工作线程合计；定向注入时为每个目标的周期）
+};
+
+/**
+ * 运行状态
+ * Stopped -> Armed（已启动，等待左键）-> Active <-> Paused，
+ * 运行中的任何状态都可以进入Exiting（ESC、信号、stop()），stop()结束后回到Stopped
+ */
+enum class RunState {
+    Stopped,    // 未启动或已停止
+    Armed,      // 已启动，等待鼠标左键开始输入
+    Active,     // 正在输入
+    Paused,     // 暂停（右键暂停）
+    Exiting     // 正在退出，工作线程应尽快结束
+};
+
+/**
+ * 输入控制状态
+ * 由模拟器持有，事件循环修改，所有工作线程共享读取。
+ * 状态在互斥锁内切换并广播条件变量，等待中的工作线程立即醒来，不需要轮询间隔；
+ * 热循环中只读取原子状态，不加锁
+ */
+struct InputControl {
+    std::atomic<RunState> state;                // 当前运行状态（只通过transition/requestExit/reset修改）
+    std::mutex stateMutex;                      // 保护状态切换，配合stateChanged避免丢失唤醒
+    std::condition_variable stateChanged;       // 状态切换时广播
+    std::atomic<size_t> finishedWorkers;        // 已执行完负载曲线的工作线程数
+    std::shared_ptr<const KeystrokePlan> plan;  // 编译后的按键计划（通过std::atomic_load/atomic_store访问）
+    std::shared_ptr<const KeyMap> keyMap;       // 当前键盘映射（通过std::atomic_load/atomic_store访问）
+    std::shared_ptr<const TextCorpus> corpus;   // 语料库（启动前设置，之后只读；为空时使用plan中的字符组）
+    std::shared_ptr<const TypingModel> typing;  // 打字模型（启动前设置，之后只读；符号i对应plan中的字符组i）
+    std::shared_ptr<const ScenarioProgram> scenario;    // 编译后的场景（通过std::atomic_load/atomic_store访问，为空时随机输入字符组）
+    std::shared_ptr<const InputConfig> config;  // 当前输入配置（通过std::atomic_load/atomic_store访问）
+    std::atomic<uint64_t> generation;           // plan/keyMap/config每次替换后加1
+    std::function<void()> notify;               // 工作线程执行完时调用（唤醒模拟器的事件循环，启动前设置，可为空）
+    
+    InputControl();
+    
+    // 当前状态
+    RunState current() const;
+    
+    // 工作线程是否应继续运行（正在输入或暂停中）
+    bool shouldContinue() const;
+    
+    // 当前状态为from时切换到to并唤醒所有等待者，否则返回false
+    bool transition(RunState from, RunState to);
+    
+    // 运行中时进入Exiting并唤醒所有等待者，已停止时返回false
+    bool requestExit();
+    
+    // 无条件设置状态（启动和停止时使用）
+    void reset(RunState to);
+    
+    // 暂停时阻塞到恢复或退出，返回是否应继续运行
+    bool waitWhilePaused();
+    
+    // 正在输入时等到deadline，状态改变（暂停、退出）时立即返回false
+    bool sleepUntil(std::chrono::steady_clock::time_point deadline);
+    
+    // 替换plan/keyMap/config之后调用，通知工作线程重新读取快照
+    void publish();
+    
+    // 工作线程执行完负载曲线、轨迹或场景时调用
+    void markFinished();
+};
+
+/**
+ * 工作线程的调度参数
+ */
+struct WorkerSettings {
+    std::chrono::nanoseconds period;            // 本工作线程的输入周期
+    std::chrono::nanoseconds phase;             // 相对公共起点的相位偏移
+    std::chrono::nanoseconds spinThreshold;     // 自旋阈值
+    DeadlineScheduler::MissPolicy missPolicy;   // 错过周期的处理策略
+    int64_t periodShare;                        // 本工作线程周期 = 配置周期 × periodShare（总频率由几个工作线程分摊）
+    size_t batchSize;                           // 每批事件数（0表示整个周期）
+    std::vector<int64_t> intervals;             // 负载曲线预先算好的周期序列（纳秒，为空时使用固定周期）
+    std::shared_ptr<TraceReader> trace;         // 回放的按键轨迹（为空时输入字符组）
+    double replaySpeed;                         // 回放速度倍数（2表示两倍速）
+    std::vector<int64_t> holdDurations;         // 按住模式预先抽样的按住时长（纳秒，循环使用；为空时不启用按住模式）
+    size_t overlap;                             // 按住模式下最多同时按住的键数
+    std::shared_ptr<const PointerStorm> pointer;    // 与按键并行注入的鼠标事件（为空时不注入）
+    RealtimeOptions realtime;                   // 实时运行选项（未启用时使用普通调度）
+};
+
+/**
+ * 输入工作线程
+ * 每个工作线程拥有自己的输出后端（独立的X连接）、调度器和随机数生成器，
+ * 多个工作线程按相位错开，共同组成目标总频率
+ */
+class InputWorker {
+public:
+    InputWorker(size_t index, InputControl& control, std::unique_ptr<KeyEventSink> sink,
+                const WorkerSettings& settings);
+    ~InputWorker();
+    
+    // 以startTime为公共起点启动线程（实际第一个周期在startTime + phase）
+    void start(DeadlineScheduler::TimePoint startTime);
+    
+    // 等待线程退出
+    void join();
+    
+    // 统计信息（计数器可在运行中读取，起止时间在线程退出后读取）
+    size_t index() const;
+    const DeadlineScheduler& scheduler() const;
+    const KeyEventSink& sink() const;
+    const AtomicHistogram& lateness() const;
+    DeadlineScheduler::TimePoint startTime() const;
+    DeadlineScheduler::TimePoint endTime() const;
+    const RealtimeStatus& realtimeStatus() const;
+    size_t maxHeld() const;
+    uint64_t forcedReleases() const;
+    const PointerTimeline& pointer() const;
+
+private:
+    // 输入线程主循环
+    void run(DeadlineScheduler::TimePoint startTime);
+    
+    // 回放按键轨迹：每个事件在 起点 + 轨迹时刻/速度 处发送，轨迹结束后线程退出
+    void runReplay(TraceReader& trace, DeadlineScheduler::TimePoint startTime);
+    
+    // 执行场景指令：时钟只由Wait和字符间隔推进，场景结束后线程退出
+    void runScenario(const ScenarioProgram& program, DeadlineScheduler::TimePoint startTime);
+    
+    // 按住模式：按下按周期（或负载曲线）调度，每个键按住抽样的时长后释放，
+    // 按下和释放两条时间线在同一个循环中合并，每次等到最近的一个时刻
+    void runHold(DeadlineScheduler::TimePoint startTime);
+    
+    // 按打字模型逐字符输入：下一个字符和按下间隔由模型抽取，间隔缩放到当前频率
+    void runTyping(const TypingModel& model, DeadlineScheduler::TimePoint startTime);
+    
+    // 按键计划变化时重新挑选按住模式可用的键
+    void refreshHoldKeys();
+    
+    // 把m_holding中第index个键的释放事件加入当前批次并移除
+    void queueHoldRelease(size_t index);
+    
+    // 立即释放所有按住的键（暂停和退出时）
+    void releaseHolding();
+    
+    // 等到截止时间，期间到期的鼠标事件在各自的截止时间发送；被暂停或退出打断时返回false
+    bool waitWithPointer(DeadlineScheduler::TimePoint deadline);
+    
+    // 立即发送截止时间不晚于now的鼠标事件
+    void sendPointerEvents(DeadlineScheduler::TimePoint now);
+    
+    // 在 起点 + 偏移 处发送当前批次并清空，返回false表示应退出
+    bool sendBatchAt(DeadlineScheduler::TimePoint& base, DeadlineScheduler::Duration offset);
+    
+    // 等到截止时间并记录调度延迟：远离截止时间的部分在控制状态上等待，可被暂停和退出立即打断，
+    // 最后一段交给调度器精确等待；被打断时返回false
+    bool waitForDeadline(DeadlineScheduler::TimePoint deadline);
+    
+    // 等到 base + offset，期间暂停时释放按下的键并把base后移暂停的时长，
+    // 恢复时重新按下；返回false表示应退出（此时按下的键已释放）
+    bool waitForOffset(DeadlineScheduler::TimePoint& base, DeadlineScheduler::Duration offset);
+    
+    // 记录回放和场景中按下未释放的键；暂停和退出时释放它们，恢复时重新按下
+    void trackHeldKey(const KeyEvent& event);
+    void sendHeldKeys(bool press);
+    
+    // 模拟键盘输入：把一批按键事件交给输出后端，批内只提交一次
+    void simulateKeyInput(const TimedKeyEvent* events, size_t count);
+    void simulateStringInput(const KeystrokePlan& plan, const KeystrokePlan::Group& group);
+    
+    // 将一个字符对应的按键事件追加到当前批次，delayMs作用于其中第一个事件
+    void queueCharEvents(const KeyEvent* events, size_t count, uint32_t delayMs);
+    
+    // 快照有更新时重新读取按键计划、键盘映射和输入配置；热循环中只读一个原子计数器，
+    // shared_ptr的原子读取（内部有锁）只在配置被替换后发生一次
+    void refreshSnapshots();
+    
+    // 随机选择一个输入文本组的索引
+    size_t getRandomGroupIndex(size_t groupCount);
+    
+    // 从语料库抽取一个字符组，按当前键盘映射编译到本线程复用的计划中
+    const KeystrokePlan& compileCorpusGroup(const TextCorpus& corpus);
+
+private:
+    size_t m_index;                             // 工作线程编号
+    InputControl& m_control;                    // 共享的控制状态
+    std::unique_ptr<KeyEventSink> m_sink;       // 输出后端
+    WorkerSettings m_settings;                  // 调度参数
+    DeadlineScheduler m_scheduler;              // 截止时间调度器
+    AtomicHistogram m_lateness;                 // 每批相对截止时间的调度延迟
+    std::vector<TimedKeyEvent> m_batchBuffer;   // 当前批次
+    uint64_t m_generation;                      // 已读取的快照版本
+    std::shared_ptr<const KeystrokePlan> m_plan;    // 当前按键计划快照
+    std::shared_ptr<const KeyMap> m_keyMap;     // 当前键盘映射快照
+    std::shared_ptr<const InputConfig> m_config;    // 已生效的输入配置（创建时的配置由settings.period体现）
+    KeystrokePlan m_corpusPlan;                 // 语料库模式下本周期字符组的按键计划（复用容量）
+    std::vector<KeyEvent> m_heldKeys;           // 回放和场景中当前按下的键
+    std::vector<TimedKeyEvent> m_heldBuffer;    // 释放/重新按下这些键时使用的批次（不打断当前批次）
+    
+    // 按住模式中已按下、等待释放的键
+    struct HoldingKey {
+        KeyEvent key;                           // 按下事件
+        DeadlineScheduler::TimePoint release;   // 释放时刻
+    };
+    std::vector<KeyEvent> m_holdKeys;           // 按住模式可用的键（不需要修饰键的普通按键，按键码去重）
+    uint64_t m_holdKeysGeneration;              // m_holdKeys对应的快照版本
+    std::vector<HoldingKey> m_holding;          // 当前按住的键
+    std::atomic<size_t> m_maxHeld;              // 同时按住的最大键数
+    std::atomic<uint64_t> m_forcedReleases;     // 达到重叠深度时提前释放的次数
+    PointerTimeline m_pointer;                  // 鼠标事件的时间线（与按键共用调度器等待）
+    std::vector<TimedKeyEvent> m_pointerBuffer; // 鼠标事件的批次（不打断当前按键批次）
+    std::mt19937 m_randomGenerator;             // 随机数生成器
+    std::thread m_thread;                       // 工作线程
+    DeadlineScheduler::TimePoint m_startTime;   // 开始时间
+    DeadlineScheduler::TimePoint m_endTime;     // 结束时间
+    RealtimeStatus m_realtimeStatus;            // 实际生效的实时设置（线程启动时写入）
+};
+
+#endif // INPUT_WORKER_H
@@ -0,0 +1,322 @@
+#include "key_event_sink.h"
+#include <chrono>
+
+#ifdef __linux__
+#include <X11/extensions/XTest.h>
+#endif
+
+KeyEventSink::KeyEventSink()
+    : m_eventsSent(0)
+    , m_requestsSent(0)
+    , m_flushCount(0)
+    , m_lockWaitNs(0)
+    , m_lockHoldNs(0)
+    , m_keycodeRemaps(0)
+{
+}
+
+KeyEventSink::~KeyEventSink() {
+}
+
+uint64_t KeyEventSink::eventsSent() const {
+    return m_eventsSent.load(std::memory_order_relaxed);
+}
+
+uint64_t KeyEventSink::requestsSent() const {
+    return m_requestsSent.load(std::memory_order_relaxed);
+}
+
+uint64_t KeyEventSink::flushCount() const {
+    return m_flushCount.load(std::memory_order_relaxed);
+}
+
+uint64_t KeyEventSink::lockWaitNs() const {
+    return m_lockWaitNs.load(std::memory_order_relaxed);
+}
+
+uint64_t KeyEventSink::lockHoldNs() const {
+    return m_lockHoldNs.load(std::memory_order_relaxed);
+}
+
+uint64_t KeyEventSink::keycodeRemaps() const {
+    return m_keycodeRemaps.load(std::memory_order_relaxed);
+}
+
+#ifdef __linux__
+XTestSink::XTestSink(Display* display, std::mutex& displayMutex)
+    : m_display(display)
+    , m_displayMutex(displayMutex)
+    , m_ownsDisplay(false)
+{
+}
+
+std::unique_ptr<XTestSink> XTestSink::open(const char* displayName) {
+    Display* display = XOpenDisplay(displayName);
+    if (!display) {
+        return nullptr;
+    }
+    return std::unique_ptr<XTestSink>(new XTestSink(display));
+}
+
+XTestSink::XTestSink(Display* display)
+    : m_display(display)
+    , m_displayMutex(m_ownMutex)
+    , m_ownsDisplay(true)
+{
+}
+
+XTestSink::~XTestSink() {
+    if (m_ownsDisplay && m_display) {
+        // 独立连接可能连到另一个显示器，主连接停止时不会恢复那里的键码，由本后端自己恢复
+        if (m_keycodePool.remaps() > 0) {
+            KeycodePool::clear(m_display, m_spareKeycodes);
+        }
+        XCloseDisplay(m_display);
+        m_display = nullptr;
+    }
+}
+
+void XTestSink::setSpareKeycodes(const std::vector<uint8_t>& keycodes) {
+    std::lock_guard<std::mutex> lock(m_displayMutex);
+    m_keycodePool.assign(keycodes);
+    m_spareKeycodes = keycodes;
+}
+
+void XTestSink::send(const TimedKeyEvent* events, size_t count) {
+    try {
+        auto requested = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(m_displayMutex);
+        auto acquired = std::chrono::steady_clock::now();
+        m_lockWaitNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(acquired - requested).count(),
+                               std::memory_order_relaxed);
+        if (!m_display) {
+            return;
+        }
+        
+        // 键码和修饰键已在编译按键计划时解析，这里只需依次排队，
+        // 批内的时间间隔通过XTest的delay参数交给服务器，整批只刷新一次；
+        // Unicode字符先取得临时绑定的键码，已绑定时不产生额外请求；
+        // 鼠标事件同样按序排队，与按键共用一次刷新
+        unsigned long firstRequest = NextRequest(m_display);
+        for (size_t i = 0; i < count; i++) {
+            const KeyEvent& event = events[i].event;
+            if (event.isPointer()) {
+                if (event.code == 0) {
+                    XTestFakeRelativeMotionEvent(m_display, event.pointerDx(), event.pointerDy(), events[i].delayMs);
+                } else {
+                    XTestFakeButtonEvent(m_display, event.code, event.isPress() ? True : False, events[i].delayMs);
+                }
+                continue;
+            }
+            unsigned int keycode = event.isUnicode() ? m_keycodePool.bind(m_display, event.codePoint()) : event.code;
+            if (keycode != 0) {
+                XTestFakeKeyEvent(m_display, keycode, event.isPress() ? True : False, events[i].delayMs);
+            }
+        }
+        XFlush(m_display);
+        unsigned long requests = NextRequest(m_display) - firstRequest;
+        lock.unlock();
+        
+        m_lockHoldNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - acquired).count(), std::memory_order_relaxed);
+        m_requestsSent.fetch_add(requests, std::memory_order_relaxed);
+        m_eventsSent.fetch_add(count, std::memory_order_relaxed);
+        m_flushCount.fetch_add(1, std::memory_order_relaxed);
+        m_keycodeRemaps.store(m_keycodePool.remaps(), std::memory_order_relaxed);
+    } catch (...) {
+        // 忽略X11操作中的异常，避免程序崩溃
+    }
+}
+
+const char* XTestSink::name() const {
+    return "xtest";
+}
+
+XSendEventSink::XSendEventSink(Display* display, Window window)
+    : m_display(display)
+    , m_window(window)
+    , m_root(DefaultRootWindow(display))
+{
+}
+
+std::unique_ptr<XSendEventSink> XSendEventSink::open(const char* displayName, Window window) {
+    Display* display = XOpenDisplay(displayName);
+    if (!display) {
+        return nullptr;
+    }
+    return std::unique_ptr<XSendEventSink>(new XSendEventSink(display, window));
+}
+
+XSendEventSink::~XSendEventSink() {
+    if (m_display) {
+        XCloseDisplay(m_display);
+        m_display = nullptr;
+    }
+}
+
+void XSendEventSink::setSpareKeycodes(const std::vector<uint8_t>& keycodes) {
+    m_keycodePool.assign(keycodes);
+}
+
+void XSendEventSink::send(const TimedKeyEvent* events, size_t count) {
+    try {
+        if (!m_display) {
+            return;
+        }
+        
+        // 合成事件的state就是应用看到的修饰键状态（并没有真正按下修饰键），
+        // 直接使用编译按键计划时记录的修饰键掩码
+        XKeyEvent key = {};
+        key.display = m_display;
+        key.window = m_window;
+        key.root = m_root;
+        key.subwindow = None;
+        key.time = CurrentTime;
+        key.x = 1;
+        key.y = 1;
+        key.x_root = 1;
+        key.y_root = 1;
+        key.same_screen = True;
+        // Unicode字符的映射修改与XSendEvent在同一连接上按序处理，目标应用先收到MappingNotify
+        unsigned long firstRequest = NextRequest(m_display);
+        for (size_t i = 0; i < count; i++) {
+            const KeyEvent& event = events[i].event;
+            if (event.isPointer()) {
+                // 合成的指针事件不会移动真实指针，定向注入不发送鼠标事件
+                continue;
+            }
+            bool press = event.isPress();
+            key.type = press ? KeyPress : KeyRelease;
+            key.keycode = event.isUnicode() ? m_keycodePool.bind(m_display, event.codePoint()) : event.code;
+            key.state = event.isUnicode() ? 0 : event.modifiers;
+            if (key.keycode == 0) {
+                continue;
+            }
+            XSendEvent(m_display, m_window, True, press ? KeyPressMask : KeyReleaseMask,
+                       reinterpret_cast<XEvent*>(&key));
+        }
+        XFlush(m_display);
+        
+        m_requestsSent.fetch_add(NextRequest(m_display) - firstRequest, std::memory_order_relaxed);
+        m_eventsSent.fetch_add(count, std::memory_order_relaxed);
+        m_flushCount.fetch_add(1, std::memory_order_relaxed);
+        m_keycodeRemaps.store(m_keycodePool.remaps(), std::memory_order_relaxed);
+    } catch (...) {
+        // 忽略X11操作中的异常，避免程序崩溃
+    }
+}
+
+const char* XSendEventSink::name() const {
+    return "xsendevent";
+}
+#endif
+
+#ifdef _WIN32
+void SendInputSink::send(const TimedKeyEvent* events, size_t count) {
+    INPUT input[16] = {};
+    
+    m_eventsSent.fetch_add(count, std::memory_order_relaxed);
+    while (count > 0) {
+        size_t batch = count < 16 ? count : 16;
+        UINT filled = 0;
+        for (size_t i = 0; i < batch; i++) {
+            const KeyEvent& event = events[i].event;
+            INPUT& item = input[filled];
+            item = INPUT{};
+            if (!event.isPointer()) {
+                item.type = INPUT_KEYBOARD;
+                item.ki.wScan = event.code;
+                item.ki.dwFlags = KEYEVENTF_UNICODE | (event.isPress() ? 0 : KEYEVENTF_KEYUP);
+                filled++;
+                continue;
+            }
+            
+            // 按钮编号与X11核心协议一致：1/2/3为左/中/右键，4/5为滚轮上/下（只在按下时滚动一格）
+            item.type = INPUT_MOUSE;
+            switch (event.code) {
+                case 0:
+                    item.mi.dx = event.pointerDx();
+                    item.mi.dy = event.pointerDy();
+                    item.mi.dwFlags = MOUSEEVENTF_MOVE;
+                    break;
+                case 1:
+                    item.mi.dwFlags = event.isPress() ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP;
+                    break;
+                case 2:
+                    item.mi.dwFlags = event.isPress() ? MOUSEEVENTF_MIDDLEDOWN : MOUSEEVENTF_MIDDLEUP;
+                    break;
+                case 3:
+                    item.mi.dwFlags = event.isPress() ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP;
+                    break;
+                case 4:
+                case 5:
+                    if (!event.isPress()) {
+                        continue;
+                    }
+                    item.mi.mouseData = static_cast<DWORD>(event.code == 4 ? WHEEL_DELTA : -WHEEL_DELTA);
+                    item.mi.dwFlags = MOUSEEVENTF_WHEEL;
+                    break;
+                default:
+                    continue;
+            }
+            filled++;
+        }
+        if (filled > 0) {
+            SendInput(filled, input, sizeof(INPUT));
+            m_requestsSent.fetch_add(1, std::memory_order_relaxed);
+        }
+        events += batch;
+        count -= batch;
+    }
+    m_flushCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* SendInputSink::name() const {
+    return "sendinput";
+}
+#endif
+
+RecordingSink::RecordingSink(size_t capacity)
+    : m_mask(0)
+    , m_head(0)
+{
+    if (capacity > 0) {
+        size_t rounded = 1;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        m_ring.resize(rounded);
+        m_mask = rounded - 1;
+    }
+}
+
+void RecordingSink::send(const TimedKeyEvent* events, size_t count) {
+    m_eventsSent.fetch_add(count, std::memory_order_relaxed);
+    m_requestsSent.fetch_add(1, std::memory_order_relaxed);
+    m_flushCount.fetch_add(1, std::memory_order_relaxed);
+    if (m_ring.empty()) {
+        return;
+    }
+    
+    // 每批只读一次时钟，批内事件按延迟参数推算预期时间
+    int64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    for (size_t i = 0; i < count; i++) {
+        timestamp += static_cast<int64_t>(events[i].delayMs) * 1000000;
+        m_ring[m_head & m_mask] = RecordedKeyEvent{timestamp, events[i].event};
+        m_head++;
+    }
+}
+
+const char* RecordingSink::name() const {
+    return m_ring.empty() ? "null" : "memory";
+}
+
+size_t RecordingSink::size() const {
+    return m_head < m_ring.size() ? static_cast<size_t>(m_head) : m_ring.size();
+}
+
+const RecordedKeyEvent& RecordingSink::at(size_t index) const {
+    uint64_t oldest = m_head - size();
+    return m_ring[(oldest + index) & m_mask];
+}
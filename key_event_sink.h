@@ -0,0 +1,165 @@
+#ifndef KEY_EVENT_SINK_H
+#define KEY_EVENT_SINK_H
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "keystroke_plan.h"
+#include "keycode_pool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif __linux__
+#include <X11/Xlib.h>
+#endif
+
+/**
+ * 按键事件输出后端接口
+ * 输入线程把编译好的按键事件按批交给后端，由后端负责实际注入，
+ * 不同后端可以直接比较吞吐量，也可以在无X服务器的环境下测量工具本身的开销
+ */
+class KeyEventSink {
+public:
+    KeyEventSink();
+    virtual ~KeyEventSink();
+    
+    // 发送一批按键事件，整批只提交一次
+    virtual void send(const TimedKeyEvent* events, size_t count) = 0;
+    
+    // 后端名称
+    virtual const char* name() const = 0;
+    
+    // 统计信息（只由发送线程写入，其他线程可随时读取）
+    uint64_t eventsSent() const;
+    uint64_t requestsSent() const;
+    uint64_t flushCount() const;
+    
+    // 等待和持有连接互斥锁的累计时间（纳秒），不使用锁的后端为0
+    // 持有时间包含XFlush，目标端处理不过来时写阻塞会体现在这里
+    uint64_t lockWaitNs() const;
+    uint64_t lockHoldNs() const;
+    
+    // 为输入Unicode字符而修改键盘映射的次数，不需要临时绑定键码的后端为0
+    uint64_t keycodeRemaps() const;
+
+protected:
+    std::atomic<uint64_t> m_eventsSent;     // 已发送事件数
+    std::atomic<uint64_t> m_requestsSent;   // 已发送请求数（X请求或SendInput调用）
+    std::atomic<uint64_t> m_flushCount;     // 提交次数
+    std::atomic<uint64_t> m_lockWaitNs;     // 等待互斥锁的累计时间
+    std::atomic<uint64_t> m_lockHoldNs;     // 持有互斥锁的累计时间
+    std::atomic<uint64_t> m_keycodeRemaps;  // 修改键盘映射的次数
+};
+
+#ifdef __linux__
+/**
+ * XTest后端：通过XTestFakeKeyEvent注入按键，鼠标事件通过XTestFakeRelativeMotionEvent/XTestFakeButtonEvent注入，
+ * 每批只刷新一次
+ */
+class XTestSink : public KeyEventSink {
+public:
+    // display由调用方持有，displayMutex用于与其他使用同一连接的线程互斥
+    XTestSink(Display* display, std::mutex& displayMutex);
+    
+    // 打开一个独立的X连接，由本后端持有并在析构时关闭；失败时返回nullptr
+    static std::unique_ptr<XTestSink> open(const char* displayName);
+    
+    ~XTestSink() override;
+    
+    // 设置用于输入Unicode字符的空闲键码（开始发送前调用，为空时跳过Unicode事件）
+    void setSpareKeycodes(const std::vector<uint8_t>& keycodes);
+    
+    void send(const TimedKeyEvent* events, size_t count) override;
+    const char* name() const override;
+
+private:
+    // 持有独立连接的构造函数，使用自己的互斥锁
+    explicit XTestSink(Display* display);
+    
+    Display* m_display;
+    std::mutex m_ownMutex;          // 独立连接时使用的互斥锁
+    std::mutex& m_displayMutex;
+    bool m_ownsDisplay;             // 是否由本后端持有连接
+    KeycodePool m_keycodePool;      // Unicode字符临时绑定的键码（只在持有连接锁时使用）
+    std::vector<uint8_t> m_spareKeycodes;   // 分到的空闲键码（持有连接时在关闭前恢复为空映射）
+};
+#endif
+
+#ifdef __linux__
+/**
+ * 定向注入后端：通过XSendEvent把按键事件直接发给指定窗口，不依赖输入焦点，
+ * 多个后端可以同时驱动同一显示器上的多个应用实例。
+ * 合成事件带有send_event标记，部分应用（如默认配置的xterm）会忽略这类事件；
+ * XSendEvent没有事件级延迟参数，批内延迟被忽略；鼠标事件被忽略
+ */
+class XSendEventSink : public KeyEventSink {
+public:
+    // 打开一个独立的X连接，向window发送事件；失败时返回nullptr
+    static std::unique_ptr<XSendEventSink> open(const char* displayName, Window window);
+    
+    ~XSendEventSink() override;
+    
+    // 设置用于输入Unicode字符的空闲键码（开始发送前调用，为空时跳过Unicode事件）
+    void setSpareKeycodes(const std::vector<uint8_t>& keycodes);
+    
+    void send(const TimedKeyEvent* events, size_t count) override;
+    const char* name() const override;
+
+private:
+    XSendEventSink(Display* display, Window window);
+    
+    Display* m_display;     // 本后端独占的连接（只由所属工作线程使用，不需要互斥锁）
+    Window m_window;        // 目标窗口
+    Window m_root;          // 目标所在屏幕的根窗口
+    KeycodePool m_keycodePool;  // Unicode字符临时绑定的键码
+};
+#endif
+
+#ifdef _WIN32
+/**
+ * SendInput后端：以KEYEVENTF_UNICODE方式注入按键，鼠标事件以INPUT_MOUSE注入
+ * SendInput没有事件级延迟参数，批内延迟被忽略
+ */
+class SendInputSink : public KeyEventSink {
+public:
+    void send(const TimedKeyEvent* events, size_t count) override;
+    const char* name() const override;
+};
+#endif
+
+/**
+ * 记录的按键事件（steady_clock纳秒时间戳）
+ */
+struct RecordedKeyEvent {
+    int64_t timestampNs;
+    KeyEvent event;
+};
+
+/**
+ * 内存记录后端：把事件写入预分配的环形缓冲区，不与任何外部系统交互
+ * 容量为0时只计数（空后端），用于测量调度器和文本处理本身的吞吐量
+ */
+class RecordingSink : public KeyEventSink {
+public:
+    // capacity会向上取整到2的幂，0表示不记录
+    explicit RecordingSink(size_t capacity);
+    
+    void send(const TimedKeyEvent* events, size_t count) override;
+    const char* name() const override;
+    
+    // 环形缓冲区中保留的事件数（最多为容量）
+    size_t size() const;
+    
+    // 按时间顺序获取保留的第index个事件（0为最早）
+    const RecordedKeyEvent& at(size_t index) const;
+
+private:
+    std::vector<RecordedKeyEvent> m_ring;   // 预分配的环形缓冲区
+    size_t m_mask;                          // 容量掩码
+    uint64_t m_head;                        // 下一个写入位置（单调递增）
+};
+
+#endif // KEY_EVENT_SINK_H
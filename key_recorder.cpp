@@ -0,0 +1,244 @@
+#include "key_recorder.h"
+
+#ifdef __linux__
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <X11/Xproto.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace {
+    // 队列容量（事件数），每个事件16字节
+    const size_t RingCapacity = 1 << 16;
+    
+    // 写入线程每次最多取出的事件数
+    const size_t WriteBatch = 4096;
+}
+
+KeyRecorder::KeyRecorder()
+    : m_controlDisplay(nullptr)
+    , m_dataDisplay(nullptr)
+    , m_context(0)
+    , m_ring(RingCapacity)
+    , m_recording(false)
+    , m_writing(false)
+    , m_wakeFd(-1)
+    , m_captured(0)
+    , m_dropped(0)
+    , m_written(0)
+{
+}
+
+KeyRecorder::~KeyRecorder() {
+    stop();
+}
+
+bool KeyRecorder::start(const std::string& path, const char* displayName) {
+    if (isRecording()) {
+        return false;
+    }
+    
+    // XRecord需要两个连接：数据连接启用上下文后只用于接收录制数据，
+    // 上下文的创建和停用通过控制连接完成
+    m_controlDisplay = XOpenDisplay(displayName);
+    m_dataDisplay = XOpenDisplay(displayName);
+    if (!m_controlDisplay || !m_dataDisplay) {
+        std::cerr << "错误: 无法连接到X服务器" << std::endl;
+        closeDisplays();
+        return false;
+    }
+    
+    int major = 0;
+    int minor = 0;
+    if (!XRecordQueryVersion(m_controlDisplay, &major, &minor)) {
+        std::cerr << "错误: X服务器不支持XRecord扩展" << std::endl;
+        closeDisplays();
+        return false;
+    }
+    
+    // 只录制按键事件（KeyPress到KeyRelease），来自所有客户端
+    XRecordRange* range = XRecordAllocRange();
+    if (!range) {
+        std::cerr << "错误: 无法分配XRecord范围" << std::endl;
+        closeDisplays();
+        return false;
+    }
+    range->device_events.first = KeyPress;
+    range->device_events.last = KeyRelease;
+    XRecordClientSpec clients = XRecordAllClients;
+    m_context = XRecordCreateContext(m_controlDisplay, 0, &clients, 1, &range, 1);
+    XFree(range);
+    if (!m_context) {
+        std::cerr << "错误: 无法创建XRecord上下文" << std::endl;
+        closeDisplays();
+        return false;
+    }
+    // 确保上下文在服务器端已创建，数据连接才能启用它
+    XSync(m_controlDisplay, False);
+    
+    if (!m_writer.open(path, TraceHeader::X11Keycode)) {
+        closeDisplays();
+        return false;
+    }
+    
+    m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    m_captured = 0;
+    m_dropped = 0;
+    m_written = 0;
+    m_recording = true;
+    m_writing = true;
+    m_writerThread = std::thread(&KeyRecorder::writerLoop, this);
+    m_recordThread = std::thread(&KeyRecorder::recordLoop, this);
+    return true;
+}
+
+void KeyRecorder::stop() {
+    if (!m_recordThread.joinable() && !m_writerThread.joinable()) {
+        return;
+    }
+    
+    // 先停录制线程，再停用上下文，最后让写入线程取空队列
+    m_recording = false;
+    if (m_wakeFd >= 0) {
+        uint64_t value = 1;
+        ssize_t bytes = write(m_wakeFd, &value, sizeof(value));
+        (void)bytes;
+    }
+    if (m_recordThread.joinable()) {
+        m_recordThread.join();
+    }
+    
+    try {
+        if (m_controlDisplay && m_context) {
+            XRecordDisableContext(m_controlDisplay, m_context);
+            XRecordFreeContext(m_controlDisplay, m_context);
+            XSync(m_controlDisplay, False);
+        }
+    } catch (...) {
+        // 忽略X11操作中的异常
+    }
+    m_context = 0;
+    
+    m_writing = false;
+    if (m_writerThread.joinable()) {
+        m_writerThread.join();
+    }
+    m_writer.close();
+    
+    closeDisplays();
+    if (m_wakeFd >= 0) {
+        close(m_wakeFd);
+        m_wakeFd = -1;
+    }
+}
+
+bool KeyRecorder::isRecording() const {
+    return m_recording;
+}
+
+uint64_t KeyRecorder::eventsCaptured() const {
+    return m_captured.load(std::memory_order_relaxed);
+}
+
+uint64_t KeyRecorder::eventsDropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t KeyRecorder::eventsWritten() const {
+    return m_written.load(std::memory_order_relaxed);
+}
+
+void KeyRecorder::onIntercept(XPointer closure, XRecordInterceptData* data) {
+    KeyRecorder* recorder = reinterpret_cast<KeyRecorder*>(closure);
+    if (data->category == XRecordFromServer && data->data_len > 0) {
+        // 录制数据是原始协议事件：detail为键码，state为事件发生前的修饰键和按钮状态
+        const xEvent* event = reinterpret_cast<const xEvent*>(data->data);
+        int type = event->u.u.type & 0x7f;
+        if (type == KeyPress || type == KeyRelease) {
+            RecordedKeyEvent recorded;
+            recorded.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            recorded.event.code = event->u.u.detail;
+            recorded.event.modifiers = static_cast<uint16_t>(event->u.keyButtonPointer.state & 0xff);
+            recorded.event.flags = type == KeyPress ? KeyEvent::Press : 0;
+            if (recorder->m_ring.push(recorded)) {
+                recorder->m_captured.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                recorder->m_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    XRecordFreeData(data);
+}
+
+void KeyRecorder::recordLoop() {
+    try {
+        if (!XRecordEnableContextAsync(m_dataDisplay, m_context, &KeyRecorder::onIntercept,
+                                       reinterpret_cast<XPointer>(this))) {
+            std::cerr << "错误: 无法启用XRecord上下文" << std::endl;
+            m_recording = false;
+            return;
+        }
+        
+        pollfd fds[2];
+        fds[0].fd = ConnectionNumber(m_dataDisplay);
+        fds[0].events = POLLIN;
+        fds[1].fd = m_wakeFd;
+        fds[1].events = POLLIN;
+        
+        while (m_recording) {
+            // 处理已到达的录制数据（回调只入队，不做任何阻塞操作），再阻塞等待新数据
+            XRecordProcessReplies(m_dataDisplay);
+            
+            fds[0].revents = 0;
+            fds[1].revents = 0;
+            int ready = poll(fds, m_wakeFd >= 0 ? 2 : 1, m_wakeFd >= 0 ? -1 : 100);
+            if (ready > 0 && (fds[1].revents & POLLIN)) {
+                break;
+            }
+            if (fds[0].revents & (POLLERR | POLLHUP)) {
+                std::cerr << "错误: 与X服务器的录制连接已断开" << std::endl;
+                break;
+            }
+        }
+        XRecordProcessReplies(m_dataDisplay);
+    } catch (...) {
+        // 忽略X11操作中的异常，避免程序崩溃
+    }
+    m_recording = false;
+}
+
+void KeyRecorder::writerLoop() {
+    std::vector<RecordedKeyEvent> batch(WriteBatch);
+    while (true) {
+        // 先读停止标志再取队列，停止后也会把队列取空
+        bool stopping = !m_writing;
+        size_t count = m_ring.pop(batch.data(), batch.size());
+        for (size_t i = 0; i < count; i++) {
+            m_writer.append(batch[i]);
+        }
+        m_written.fetch_add(count, std::memory_order_relaxed);
+        
+        if (count == 0) {
+            if (stopping) {
+                break;
+            }
+            // 队列可容纳65536个事件，10毫秒的轮询间隔远不会让它溢出
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+void KeyRecorder::closeDisplays() {
+    if (m_dataDisplay) {
+        XCloseDisplay(m_dataDisplay);
+        m_dataDisplay = nullptr;
+    }
+    if (m_controlDisplay) {
+        XCloseDisplay(m_controlDisplay);
+        m_controlDisplay = nullptr;
+    }
+}
+#endif
@@ -0,0 +1,72 @@
+#ifndef KEY_RECORDER_H
+#define KEY_RECORDER_H
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include "key_trace.h"
+#include "spsc_ring.h"
+
+#ifdef __linux__
+#include <X11/Xlib.h>
+#include <X11/extensions/record.h>
+
+/**
+ * 键盘输入录制器
+ * 通过XRecord扩展捕获显示器上所有客户端收到的按键事件，写入按键轨迹文件。
+ * 录制线程只给事件打上steady_clock时间戳并放入无锁环形队列，从不等待磁盘；
+ * 写入线程批量取出事件编码，攒够后大块顺序写入。队列满时丢弃并计数，不会拖慢X事件流
+ */
+class KeyRecorder {
+public:
+    KeyRecorder();
+    ~KeyRecorder();
+    
+    KeyRecorder(const KeyRecorder&) = delete;
+    KeyRecorder& operator=(const KeyRecorder&) = delete;
+    
+    // 连接X服务器并开始录制到path，displayName为空时使用DISPLAY；失败时返回false并输出错误
+    bool start(const std::string& path, const char* displayName = nullptr);
+    
+    // 停止录制，写完队列中剩余的事件并关闭文件
+    void stop();
+    
+    bool isRecording() const;
+    
+    // 统计信息（可在录制中读取）
+    uint64_t eventsCaptured() const;    // 已放入队列的事件数
+    uint64_t eventsDropped() const;     // 队列满而丢弃的事件数
+    uint64_t eventsWritten() const;     // 已交给轨迹写入器的事件数
+
+private:
+    // XRecord回调（在录制线程中调用）
+    static void onIntercept(XPointer closure, XRecordInterceptData* data);
+    
+    // 录制线程：在数据连接上接收XRecord数据
+    void recordLoop();
+    
+    // 写入线程：从队列取出事件写入文件
+    void writerLoop();
+    
+    // 释放X资源
+    void closeDisplays();
+
+private:
+    Display* m_controlDisplay;              // 控制连接（创建/停用录制上下文）
+    Display* m_dataDisplay;                 // 数据连接（只由录制线程使用）
+    XRecordContext m_context;               // 录制上下文
+    SpscRing<RecordedKeyEvent> m_ring;      // 录制线程到写入线程的队列
+    TraceWriter m_writer;                   // 轨迹写入器（只由写入线程使用）
+    std::thread m_recordThread;             // 录制线程
+    std::thread m_writerThread;             // 写入线程
+    std::atomic<bool> m_recording;          // 录制线程是否应继续
+    std::atomic<bool> m_writing;            // 写入线程是否应继续（停止后仍会取空队列）
+    int m_wakeFd;                           // 唤醒录制线程的eventfd
+    std::atomic<uint64_t> m_captured;       // 已放入队列的事件数
+    std::atomic<uint64_t> m_dropped;        // 丢弃的事件数
+    std::atomic<uint64_t> m_written;        // 已写入的事件数
+};
+#endif
+
+#endif // KEY_RECORDER_H
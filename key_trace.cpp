@@ -0,0 +1,420 @@
+#include "key_trace.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    const char Magic[8] = {'K', 'S', 'T', 'R', 'A', 'C', 'E', '1'};
+    const uint16_t Version = 1;
+    
+    // 写缓冲区攒够这么多字节后写入文件
+    const size_t WriteChunkBytes = 1024 * 1024;
+    
+    // 读取时每次预读/释放的窗口大小
+    const uint64_t ReadWindowBytes = 4 * 1024 * 1024;
+    
+    // 按小端序读写定长整数
+    void putLE(uint8_t* out, uint64_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+    
+    uint64_t getLE(const char* in, size_t bytes) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (8 * i);
+        }
+        return value;
+    }
+    
+    // LEB128变长整数：每字节7位，最高位表示后面还有字节
+    void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+    
+    bool getVarint(const char* data, uint64_t end, uint64_t& position, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && position < end; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(data[position++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+const size_t TraceHeader::Size = 64;
+const size_t TraceHeader::IndexEntrySize = 32;
+const uint32_t TraceHeader::IndexStride = 4096;
+
+void TraceHeader::encode(uint8_t* out) const {
+    std::memset(out, 0, Size);
+    std::memcpy(out, Magic, sizeof(Magic));
+    putLE(out + 8, Version, 2);
+    putLE(out + 10, Size, 2);
+    putLE(out + 12, codeType, 4);
+    putLE(out + 16, eventCount, 8);
+    putLE(out + 24, static_cast<uint64_t>(durationNs), 8);
+    putLE(out + 32, indexOffset, 8);
+    putLE(out + 40, indexCount, 8);
+    putLE(out + 48, indexStride, 4);
+}
+
+bool TraceHeader::decode(const char* data, uint64_t size) {
+    if (size < Size || std::memcmp(data, Magic, sizeof(Magic)) != 0) {
+        return false;
+    }
+    if (getLE(data + 8, 2) != Version || getLE(data + 10, 2) != Size) {
+        return false;
+    }
+    codeType = static_cast<uint32_t>(getLE(data + 12, 4));
+    eventCount = getLE(data + 16, 8);
+    durationNs = static_cast<int64_t>(getLE(data + 24, 8));
+    indexOffset = getLE(data + 32, 8);
+    indexCount = getLE(data + 40, 8);
+    indexStride = static_cast<uint32_t>(getLE(data + 48, 4));
+    return true;
+}
+
+TraceHeader::CodeType TraceHeader::nativeCodeType() {
+#ifdef _WIN32
+    return Utf16;
+#else
+    return X11Keycode;
+#endif
+}
+
+const char* TraceHeader::codeTypeName(uint32_t type) {
+    switch (type) {
+        case X11Keycode:
+            return "X11键码";
+        case Utf16:
+            return "UTF-16码元";
+        default:
+            return "未知";
+    }
+}
+
+TraceWriter::TraceWriter()
+    : m_file(nullptr)
+    , m_codeType(TraceHeader::nativeCodeType())
+    , m_offset(0)
+    , m_eventCount(0)
+    , m_firstTimestamp(0)
+    , m_lastTimestamp(0)
+    , m_lastModifiers(0)
+    , m_failed(false)
+{
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const std::string& path, TraceHeader::CodeType codeType) {
+    close();
+    
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) {
+        std::cerr << "错误: 无法创建轨迹文件: " << path << std::endl;
+        return false;
+    }
+    m_path = path;
+    m_codeType = codeType;
+    m_buffer.clear();
+    m_buffer.reserve(WriteChunkBytes + 64);
+    m_index.clear();
+    m_eventCount = 0;
+    m_lastTimestamp = 0;
+    m_lastModifiers = 0;
+    m_failed = false;
+    
+    // 先占位写入文件头，close()时回填
+    m_buffer.resize(TraceHeader::Size, 0);
+    m_offset = 0;
+    return true;
+}
+
+bool TraceWriter::append(const RecordedKeyEvent& event) {
+    if (!m_file || m_failed) {
+        return false;
+    }
+    
+    if (m_eventCount == 0) {
+        m_firstTimestamp = event.timestampNs;
+    }
+    // 时间戳不单调时（不同线程的时钟读数交错）按0间隔处理
+    int64_t timestamp = std::max(event.timestampNs - m_firstTimestamp, m_lastTimestamp);
+    
+    // 每隔IndexStride个事件记录一次解码状态
+    if (m_eventCount % TraceHeader::IndexStride == 0) {
+        uint8_t entry[TraceHeader::IndexEntrySize] = {};
+        putLE(entry, m_eventCount, 8);
+        putLE(entry + 8, static_cast<uint64_t>(m_lastTimestamp), 8);
+        putLE(entry + 16, m_offset + m_buffer.size(), 8);
+        putLE(entry + 24, m_lastModifiers, 2);
+        m_index.insert(m_index.end(), entry, entry + sizeof(entry));
+    }
+    
+    bool modifiersChanged = event.event.modifiers != m_lastModifiers;
+    uint64_t head = (static_cast<uint64_t>(timestamp - m_lastTimestamp) << 2) |
+                    (modifiersChanged ? 0x2u : 0u) | (event.event.isPress() ? 0x1u : 0u);
+    putVarint(m_buffer, head);
+    putVarint(m_buffer, event.event.code);
+    if (modifiersChanged) {
+        putVarint(m_buffer, event.event.modifiers);
+    }
+    
+    m_lastTimestamp = timestamp;
+    m_lastModifiers = event.event.modifiers;
+    m_eventCount++;
+    
+    if (m_buffer.size() >= WriteChunkBytes) {
+        return flushBuffer();
+    }
+    return true;
+}
+
+bool TraceWriter::flushBuffer() {
+    if (m_buffer.empty() || m_failed) {
+        return !m_failed;
+    }
+    if (std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()) {
+        std::cerr << "错误: 写入轨迹文件失败: " << m_path << std::endl;
+        m_failed = true;
+        return false;
+    }
+    m_offset += m_buffer.size();
+    m_buffer.clear();
+    return true;
+}
+
+bool TraceWriter::close() {
+    if (!m_file) {
+        return false;
+    }
+    
+    TraceHeader header;
+    header.codeType = m_codeType;
+    header.eventCount = m_eventCount;
+    header.durationNs = m_lastTimestamp;
+    header.indexStride = TraceHeader::IndexStride;
+    
+    bool ok = flushBuffer();
+    header.indexOffset = m_offset;
+    header.indexCount = m_index.size() / TraceHeader::IndexEntrySize;
+    if (ok && !m_index.empty()) {
+        ok = std::fwrite(m_index.data(), 1, m_index.size(), m_file) == m_index.size();
+    }
+    
+    uint8_t encoded[TraceHeader::Size];
+    header.encode(encoded);
+    if (ok) {
+        ok = std::fseek(m_file, 0, SEEK_SET) == 0 && std::fwrite(encoded, 1, sizeof(encoded), m_file) == sizeof(encoded);
+    }
+    ok = std::fclose(m_file) == 0 && ok;
+    m_file = nullptr;
+    m_index.clear();
+    
+    if (!ok) {
+        std::cerr << "错误: 写入轨迹文件失败: " << m_path << std::endl;
+    }
+    return ok;
+}
+
+bool TraceWriter::isOpen() const {
+    return m_file != nullptr;
+}
+
+uint64_t TraceWriter::eventCount() const {
+    return m_eventCount;
+}
+
+TraceReader::TraceReader()
+    : m_position(TraceHeader::Size)
+    , m_eventNumber(0)
+    , m_timestamp(0)
+    , m_modifiers(0)
+    , m_prefetchedTo(0)
+    , m_releasedTo(0)
+    , m_corrupt(false)
+{
+}
+
+bool TraceReader::open(const std::string& path) {
+    if (!m_file.open(path)) {
+        return false;
+    }
+    
+    const char* data = m_file.data();
+    uint64_t size = m_file.size();
+    if (!m_header.decode(data, size)) {
+        std::cerr << "错误: 不是有效的按键轨迹文件: " << path << std::endl;
+        m_file.close();
+        return false;
+    }
+    if (m_header.indexOffset < TraceHeader::Size || m_header.indexOffset > size ||
+        m_header.indexCount > (size - m_header.indexOffset) / TraceHeader::IndexEntrySize) {
+        std::cerr << "错误: 按键轨迹文件不完整（录制未正常结束？）: " << path << std::endl;
+        m_file.close();
+        return false;
+    }
+    
+    m_position = TraceHeader::Size;
+    m_eventNumber = 0;
+    m_timestamp = 0;
+    m_modifiers = 0;
+    m_releasedTo = 0;
+    m_prefetchedTo = 0;
+    m_corrupt = false;
+    
+    // 事件流只顺序读一遍，由updateWindow按窗口预读和释放
+    m_file.advise(MappedFile::Access::Sequential);
+    updateWindow();
+    return true;
+}
+
+bool TraceReader::decode(RecordedKeyEvent& event) {
+    if (m_eventNumber >= m_header.eventCount || m_corrupt) {
+        return false;
+    }
+    
+    const char* data = m_file.data();
+    uint64_t end = m_header.indexOffset;
+    uint64_t position = m_position;
+    uint64_t head = 0;
+    uint64_t code = 0;
+    uint64_t modifiers = m_modifiers;
+    if (!getVarint(data, end, position, head) || !getVarint(data, end, position, code) ||
+        ((head & 0x2) && !getVarint(data, end, position, modifiers)) ||
+        code > 0xffff || modifiers > 0xffff) {
+        std::cerr << "警告: 按键轨迹在偏移 " << m_position << " 处损坏，回放提前结束" << std::endl;
+        m_corrupt = true;
+        return false;
+    }
+    
+    m_position = position;
+    m_eventNumber++;
+    m_timestamp += static_cast<int64_t>(head >> 2);
+    m_modifiers = static_cast<uint16_t>(modifiers);
+    
+    event.timestampNs = m_timestamp;
+    event.event.code = static_cast<uint16_t>(code);
+    event.event.modifiers = m_modifiers;
+    event.event.flags = (head & 0x1) ? KeyEvent::Press : 0;
+    return true;
+}
+
+bool TraceReader::next(RecordedKeyEvent& event) {
+    if (!decode(event)) {
+        return false;
+    }
+    // 预读余量不足半个窗口，或身后积累了两个窗口时才调整，每个事件只多两次比较
+    if (m_position + ReadWindowBytes / 2 >= m_prefetchedTo || m_position >= m_releasedTo + 2 * ReadWindowBytes) {
+        updateWindow();
+    }
+    return true;
+}
+
+void TraceReader::updateWindow() {
+    // 前方保持至少一个窗口已提示预读
+    while (m_prefetchedTo < m_position + ReadWindowBytes && m_prefetchedTo < m_header.indexOffset) {
+        m_file.willNeed(m_prefetchedTo, ReadWindowBytes);
+        m_prefetchedTo += ReadWindowBytes;
+    }
+    
+    // 身后超过一个窗口的部分已经不会再读，释放其物理页
+    if (m_position > m_releasedTo + ReadWindowBytes) {
+        uint64_t page = MappedFile::pageSize();
+        uint64_t releaseTo = (m_position - ReadWindowBytes) / page * page;
+        if (releaseTo > m_releasedTo) {
+            m_file.release(m_releasedTo, releaseTo - m_releasedTo);
+            m_releasedTo = releaseTo;
+        }
+    }
+}
+
+void TraceReader::seek(int64_t timestampNs) {
+    if (!m_file.isOpen()) {
+        return;
+    }
+    
+    // 二分查找最后一个不晚于目标时刻的索引条目，从它记录的解码状态开始
+    const char* index = m_file.data() + m_header.indexOffset;
+    uint64_t low = 0;
+    uint64_t high = m_header.indexCount;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (static_cast<int64_t>(getLE(index + middle * TraceHeader::IndexEntrySize + 8, 8)) < timestampNs) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    
+    m_position = TraceHeader::Size;
+    m_eventNumber = 0;
+    m_timestamp = 0;
+    m_modifiers = 0;
+    m_corrupt = false;
+    if (low > 0) {
+        const char* entry = index + (low - 1) * TraceHeader::IndexEntrySize;
+        m_eventNumber = getLE(entry, 8);
+        m_timestamp = static_cast<int64_t>(getLE(entry + 8, 8));
+        m_position = getLE(entry + 16, 8);
+        m_modifiers = static_cast<uint16_t>(getLE(entry + 24, 2));
+        if (m_position < TraceHeader::Size || m_position > m_header.indexOffset) {
+            m_corrupt = true;
+            return;
+        }
+    }
+    
+    // 向前解码到目标时刻，停在第一个不早于它的事件之前
+    RecordedKeyEvent event;
+    while (m_eventNumber < m_header.eventCount) {
+        uint64_t position = m_position;
+        uint64_t eventNumber = m_eventNumber;
+        int64_t timestamp = m_timestamp;
+        uint16_t modifiers = m_modifiers;
+        if (!decode(event)) {
+            break;
+        }
+        if (event.timestampNs >= timestampNs) {
+            m_position = position;
+            m_eventNumber = eventNumber;
+            m_timestamp = timestamp;
+            m_modifiers = modifiers;
+            break;
+        }
+    }
+    
+    // 定位点之前的页不再需要，预读从定位点重新开始
+    uint64_t page = MappedFile::pageSize();
+    m_releasedTo = m_position / page * page;
+    m_file.release(0, m_releasedTo);
+    m_prefetchedTo = m_position;
+    updateWindow();
+}
+
+uint64_t TraceReader::eventCount() const {
+    return m_header.eventCount;
+}
+
+int64_t TraceReader::durationNs() const {
+    return m_header.durationNs;
+}
+
+uint32_t TraceReader::codeType() const {
+    return m_header.codeType;
+}
+
+double TraceReader::eventRate() const {
+    return m_header.durationNs > 0 ? static_cast<double>(m_header.eventCount) * 1e9 / static_cast<double>(m_header.durationNs) : 0.0;
+}
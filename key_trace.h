@@ -0,0 +1,156 @@
+#ifndef KEY_TRACE_H
+#define KEY_TRACE_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include "key_event_sink.h"
+#include "mapped_file.h"
+
+/**
+ * 按键轨迹文件头
+ * 轨迹文件格式（所有整数为小端序）：
+ *
+ *   文件头（64字节）：
+ *     0   char[8]  魔数 "KSTRACE1"
+ *     8   u16      版本（1）
+ *     10  u16      文件头长度（64）
+ *     12  u32      键码类型（0: X11键码，1: UTF-16码元）
+ *     16  u64      事件数
+ *     24  u64      最后一个事件的时间戳（纳秒，第一个事件为0）
+ *     32  u64      索引偏移
+ *     40  u64      索引条目数
+ *     48  u32      索引间隔（每多少个事件一个条目）
+ *     52  保留
+ *
+ *   事件流（紧跟文件头，每个事件2-4个变长整数，通常5-6字节）：
+ *     varint  (相对上一个事件的纳秒间隔 << 2) | (修饰键变化 << 1) | 按下
+ *     varint  键码
+ *     varint  修饰键掩码（仅在与上一个事件不同时出现）
+ *
+ *   索引（事件流之后，每个条目32字节）：
+ *     u64 事件序号，u64 该事件之前一个事件的时间戳，u64 事件在文件中的偏移，
+ *     u16 之前一个事件的修饰键掩码，6字节保留
+ *     从任一条目开始都可以独立解码，用于按时间定位
+ */
+struct TraceHeader {
+    // 键码类型
+    enum CodeType : uint32_t {
+        X11Keycode = 0,
+        Utf16 = 1
+    };
+    
+    static const size_t Size;           // 文件头长度
+    static const size_t IndexEntrySize; // 索引条目长度
+    static const uint32_t IndexStride;  // 默认索引间隔
+    
+    uint32_t codeType = X11Keycode;     // 键码类型
+    uint64_t eventCount = 0;            // 事件数
+    int64_t durationNs = 0;             // 最后一个事件的时间戳
+    uint64_t indexOffset = 0;           // 索引偏移
+    uint64_t indexCount = 0;            // 索引条目数
+    uint32_t indexStride = 0;           // 索引间隔
+    
+    // 编码为Size字节
+    void encode(uint8_t* out) const;
+    
+    // 从文件开头解码，魔数或版本不符时返回false
+    bool decode(const char* data, uint64_t size);
+    
+    // 本平台注入后端使用的键码类型
+    static CodeType nativeCodeType();
+    
+    // 键码类型名称
+    static const char* codeTypeName(uint32_t type);
+};
+
+/**
+ * 按键轨迹写入器
+ * 事件先编码到内存缓冲区，攒够后一次顺序写入文件；索引条目留在内存中（每4096个事件32字节），
+ * close()时追加索引并回填文件头
+ */
+class TraceWriter {
+public:
+    TraceWriter();
+    ~TraceWriter();
+    
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    
+    // 创建轨迹文件，失败时返回false并输出错误
+    bool open(const std::string& path, TraceHeader::CodeType codeType);
+    
+    // 追加一个事件，时间戳为任意单调时钟的纳秒值（写入时以第一个事件为0）
+    bool append(const RecordedKeyEvent& event);
+    
+    // 写入缓冲区剩余内容、索引和文件头并关闭文件
+    bool close();
+    
+    bool isOpen() const;
+    uint64_t eventCount() const;
+
+private:
+    // 把缓冲区写入文件
+    bool flushBuffer();
+
+private:
+    std::FILE* m_file;                  // 输出文件
+    std::string m_path;                 // 文件路径（用于错误信息）
+    TraceHeader::CodeType m_codeType;   // 键码类型
+    std::vector<uint8_t> m_buffer;      // 待写入的编码数据
+    std::vector<uint8_t> m_index;       // 已编码的索引条目
+    uint64_t m_offset;                  // 缓冲区起点在文件中的偏移
+    uint64_t m_eventCount;              // 已写入事件数
+    int64_t m_firstTimestamp;           // 第一个事件的原始时间戳
+    int64_t m_lastTimestamp;            // 上一个事件的相对时间戳
+    uint16_t m_lastModifiers;           // 上一个事件的修饰键掩码
+    bool m_failed;                      // 是否发生过写入错误
+};
+
+/**
+ * 按键轨迹读取器
+ * 文件通过mmap映射后顺序解码：读取位置前方的窗口提前预读，身后的窗口读过即释放，
+ * 无论轨迹有多长，常驻内存都只有约两个窗口
+ */
+class TraceReader {
+public:
+    TraceReader();
+    
+    // 映射并校验轨迹文件，失败时返回false并输出错误
+    bool open(const std::string& path);
+    
+    // 读取下一个事件（timestampNs为相对轨迹起点的纳秒），轨迹结束或数据损坏时返回false
+    bool next(RecordedKeyEvent& event);
+    
+    // 定位到第一个时间戳不早于timestampNs的事件，借助索引只需解码不到一个索引间隔的事件
+    void seek(int64_t timestampNs);
+    
+    uint64_t eventCount() const;
+    int64_t durationNs() const;
+    uint32_t codeType() const;
+    
+    // 轨迹中平均每秒的事件数
+    double eventRate() const;
+
+private:
+    // 解码当前位置的一个事件，不推进预读窗口
+    bool decode(RecordedKeyEvent& event);
+    
+    // 推进预读和释放窗口
+    void updateWindow();
+
+private:
+    MappedFile m_file;                  // 映射的轨迹文件
+    TraceHeader m_header;               // 文件头
+    uint64_t m_position;                // 下一个事件的偏移
+    uint64_t m_eventNumber;             // 下一个事件的序号
+    int64_t m_timestamp;                // 上一个事件的时间戳
+    uint16_t m_modifiers;               // 上一个事件的修饰键掩码
+    uint64_t m_prefetchedTo;            // 已提示预读到的位置
+    uint64_t m_releasedTo;              // 已释放到的位置
+    bool m_corrupt;                     // 是否遇到损坏的数据
+};
+
+#endif // KEY_TRACE_H
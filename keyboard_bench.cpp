@@ -0,0 +1,409 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include "deadline_scheduler.h"
+#include "keystroke_plan.h"
+#include "key_event_sink.h"
+#include "latency_histogram.h"
+
+/**
+ * 注入热路径基准测试
+ * 每项结果输出为一行JSON（JSON Lines），便于在不同版本之间比较；进度信息输出到stderr。
+ * 计时类测试先预热，再重复若干轮，每轮至少运行指定时长，报告各轮的最小值和中位数
+ */
+
+namespace {
+    // 防止被测代码被优化掉
+    volatile uint64_t g_sink = 0;
+    
+    struct BenchOptions {
+        int repetitions = 5;            // 每项重复轮数
+        double minSec = 0.2;            // 每轮最短运行时间
+        double jitterSec = 2.0;         // 每个频率的调度抖动测量时长
+        size_t maxGroups = 1 << 20;     // 选择开销测试的最大字符组数
+        std::string displayName;        // XTest测试使用的显示器（为空时跳过）
+        std::string outputPath;         // 输出文件（为空时输出到stdout）
+        std::string filter;             // 只运行名称包含该字符串的测试
+    };
+    
+    struct Measurement {
+        double minNs;                   // 各轮中最小的每次操作耗时
+        double medianNs;                // 各轮的中位数
+        uint64_t operations;            // 总操作次数
+    };
+    
+    /**
+     * 单行JSON构造器
+     */
+    class JsonLine {
+    public:
+        explicit JsonLine(const std::string& bench) {
+            m_out << "{\"bench\":\"" << bench << "\"";
+        }
+        
+        JsonLine& add(const std::string& key, const std::string& value) {
+            m_out << ",\"" << key << "\":\"" << value << "\"";
+            return *this;
+        }
+        
+        JsonLine& add(const std::string& key, const char* value) {
+            return add(key, std::string(value));
+        }
+        
+        JsonLine& add(const std::string& key, double value) {
+            m_out << ",\"" << key << "\":" << std::fixed << std::setprecision(3) << value;
+            return *this;
+        }
+        
+        JsonLine& add(const std::string& key, uint64_t value) {
+            m_out << ",\"" << key << "\":" << value;
+            return *this;
+        }
+        
+        JsonLine& add(const std::string& key, bool value) {
+            m_out << ",\"" << key << "\":" << (value ? "true" : "false");
+            return *this;
+        }
+        
+        JsonLine& add(const Measurement& measurement) {
+            add("ns_per_op_min", measurement.minNs);
+            add("ns_per_op_median", measurement.medianNs);
+            return add("operations", measurement.operations);
+        }
+        
+        std::string str() const {
+            return m_out.str() + "}";
+        }
+    
+    private:
+        std::ostringstream m_out;
+    };
+    
+    // 重复调用body（每次完成opsPerCall次操作），返回每次操作的耗时
+    Measurement measure(const std::function<void()>& body, uint64_t opsPerCall, const BenchOptions& options) {
+        using Clock = std::chrono::steady_clock;
+        
+        // 预热：填充缓存、触发惰性初始化
+        Clock::time_point warmupEnd = Clock::now() + std::chrono::milliseconds(50);
+        while (Clock::now() < warmupEnd) {
+            body();
+        }
+        
+        std::vector<double> samples;
+        uint64_t total = 0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            uint64_t calls = 0;
+            Clock::time_point start = Clock::now();
+            Clock::time_point now;
+            do {
+                body();
+                calls++;
+                now = Clock::now();
+            } while (std::chrono::duration<double>(now - start).count() < options.minSec);
+            double elapsedNs = std::chrono::duration<double, std::nano>(now - start).count();
+            samples.push_back(elapsedNs / static_cast<double>(calls * opsPerCall));
+            total += calls * opsPerCall;
+        }
+        std::sort(samples.begin(), samples.end());
+        return Measurement{samples.front(), samples[samples.size() / 2], total};
+    }
+    
+    // 加载键盘映射：有显示器时使用真实映射，否则使用合成映射
+    void loadKeyMap(KeyMap& keymap, const BenchOptions& options) {
+#ifdef __linux__
+        if (!options.displayName.empty()) {
+            Display* display = XOpenDisplay(options.displayName.c_str());
+            if (display && keymap.load(display)) {
+                XCloseDisplay(display);
+                return;
+            }
+            if (display) {
+                XCloseDisplay(display);
+            }
+        }
+        keymap.loadFallback();
+#else
+        (void)keymap;
+        (void)options;
+#endif
+    }
+    
+    // 所有可打印ASCII字符
+    std::string printableAscii() {
+        std::string text;
+        for (char ch = 0x20; ch < 0x7f; ch++) {
+            text.push_back(ch);
+        }
+        return text;
+    }
+    
+    // 输出后端每个按键事件的开销（即InputWorker::simulateKeyInput的开销）
+    void benchSinks(const BenchOptions& options, const KeyMap& keymap, std::ostream& out) {
+        KeystrokePlan plan;
+        plan.addGroup("The quick brown fox jumps over the lazy dog 0123456789", keymap);
+        if (plan.group(0).eventCount == 0) {
+            std::cerr << "跳过输出后端测试：键盘映射中没有可输入的字符" << std::endl;
+            return;
+        }
+        std::vector<TimedKeyEvent> events;
+        while (events.size() < 256) {
+            for (size_t i = 0; i < plan.group(0).eventCount && events.size() < 256; i++) {
+                events.push_back(TimedKeyEvent{plan.events()[plan.group(0).firstEvent + i], 0});
+            }
+        }
+        
+        struct SinkCase {
+            const char* label;
+            std::function<std::unique_ptr<KeyEventSink>()> create;
+        };
+        std::vector<SinkCase> cases;
+        cases.push_back({"null", [] { return std::unique_ptr<KeyEventSink>(new RecordingSink(0)); }});
+        cases.push_back({"memory", [] { return std::unique_ptr<KeyEventSink>(new RecordingSink(1 << 16)); }});
+#ifdef __linux__
+        // XTest会真正注入按键，只在显式指定显示器（应为Xvfb）时运行
+        if (!options.displayName.empty()) {
+            std::string displayName = options.displayName;
+            cases.push_back({"xtest", [displayName] {
+                return std::unique_ptr<KeyEventSink>(XTestSink::open(displayName.c_str()).release());
+            }});
+        }
+#endif
+        
+        for (const SinkCase& sinkCase : cases) {
+            std::unique_ptr<KeyEventSink> sink = sinkCase.create();
+            if (!sink) {
+                std::cerr << "跳过 " << sinkCase.label << " 后端：无法创建" << std::endl;
+                continue;
+            }
+            for (size_t batch : {static_cast<size_t>(1), static_cast<size_t>(16), static_cast<size_t>(64)}) {
+                std::cerr << "  sink_send " << sinkCase.label << " batch=" << batch << std::endl;
+                size_t offset = 0;
+                Measurement result = measure([&] {
+                    sink->send(events.data() + offset, batch);
+                    offset = (offset + batch) % (events.size() - 64);
+                }, batch, options);
+                out << JsonLine("sink_send").add("backend", sinkCase.label).add("batch", static_cast<uint64_t>(batch))
+                       .add("unit", "event").add(result).str() << std::endl;
+            }
+        }
+    }
+    
+    // KeySym解析开销：缓存查找、编译整个字符组，以及（有显示器时）Xlib的XKeysymToKeycode
+    void benchKeysym(const BenchOptions& options, const KeyMap& keymap, std::ostream& out) {
+        const std::string text = printableAscii();
+        
+#ifdef __linux__
+        std::cerr << "  keysym_lookup" << std::endl;
+        Measurement lookup = measure([&] {
+            uint64_t sum = 0;
+            KeyMap::Binding binding;
+            for (char ch : text) {
+                if (keymap.lookup(static_cast<KeySym>(static_cast<unsigned char>(ch)), binding)) {
+                    sum += binding.keycode;
+                }
+            }
+            g_sink = g_sink + sum;
+        }, text.size(), options);
+        out << JsonLine("keysym_lookup").add("method", "keymap_cache").add("unit", "char").add(lookup).str() << std::endl;
+        
+        if (!options.displayName.empty()) {
+            Display* display = XOpenDisplay(options.displayName.c_str());
+            if (display) {
+                std::cerr << "  keysym_lookup xlib" << std::endl;
+                Measurement xlib = measure([&] {
+                    uint64_t sum = 0;
+                    for (char ch : text) {
+                        sum += XKeysymToKeycode(display, static_cast<KeySym>(static_cast<unsigned char>(ch)));
+                    }
+                    g_sink = g_sink + sum;
+                }, text.size(), options);
+                out << JsonLine("keysym_lookup").add("method", "XKeysymToKeycode").add("unit", "char").add(xlib).str() << std::endl;
+                XCloseDisplay(display);
+            }
+        }
+#endif
+        
+        std::cerr << "  plan_compile" << std::endl;
+        KeystrokePlan plan;
+        Measurement compile = measure([&] {
+            plan.clear();
+            plan.addGroup(text, keymap);
+            g_sink = g_sink + plan.group(0).eventCount;
+        }, text.size(), options);
+        out << JsonLine("plan_compile").add("unit", "char").add(compile).str() << std::endl;
+    }
+    
+    // 调度器醒来抖动：每个周期在起点醒来，记录相对截止时间的迟到量
+    void benchJitter(const BenchOptions& options, std::ostream& out) {
+        for (double hz : {100.0, 1000.0, 10000.0}) {
+            for (int spinUs : {0, 50}) {
+                std::cerr << "  scheduler_jitter " << hz << " Hz spin=" << spinUs << "us" << std::endl;
+                DeadlineScheduler scheduler;
+                scheduler.setPeriod(DeadlineScheduler::Duration(static_cast<int64_t>(1e9 / hz)));
+                scheduler.setSpinThreshold(std::chrono::microseconds(spinUs));
+                scheduler.reset(DeadlineScheduler::Clock::now() + scheduler.period());
+                
+                LatencyHistogram lateness;
+                DeadlineScheduler::TimePoint end = DeadlineScheduler::Clock::now() +
+                    std::chrono::duration_cast<DeadlineScheduler::Duration>(std::chrono::duration<double>(options.jitterSec));
+                while (scheduler.cycleStart() < end) {
+                    lateness.record(scheduler.waitUntil(scheduler.cycleStart()).count());
+                    scheduler.advance();
+                }
+                
+                out << JsonLine("scheduler_jitter").add("rate_hz", hz).add("spin_us", static_cast<uint64_t>(spinUs))
+                       .add("cycles", lateness.count()).add("missed", scheduler.deadlinesMissed())
+                       .add("p50_us", lateness.percentile(50) / 1000.0).add("p90_us", lateness.percentile(90) / 1000.0)
+                       .add("p99_us", lateness.percentile(99) / 1000.0).add("p999_us", lateness.percentile(99.9) / 1000.0)
+                       .add("max_us", lateness.max() / 1000.0).str() << std::endl;
+            }
+        }
+    }
+    
+    // 字符组选择开销：随机选一个字符组并读取它的第一个事件，字符组增多后计划超出缓存
+    void benchSelection(const BenchOptions& options, const KeyMap& keymap, std::ostream& out) {
+        std::mt19937 textGenerator(42);
+        std::uniform_int_distribution<int> letter('a', 'z');
+        std::uniform_int_distribution<int> length(4, 12);
+        
+        KeystrokePlan plan;
+        for (size_t groups = 1; groups <= options.maxGroups; groups *= 16) {
+            while (plan.groupCount() < groups) {
+                std::string text(static_cast<size_t>(length(textGenerator)), ' ');
+                for (char& ch : text) {
+                    ch = static_cast<char>(letter(textGenerator));
+                }
+                plan.addGroup(text, keymap);
+            }
+            
+            std::cerr << "  group_select groups=" << groups << std::endl;
+            std::mt19937 generator(7);
+            const size_t selections = 1024;
+            Measurement result = measure([&] {
+                uint64_t sum = 0;
+                std::uniform_int_distribution<size_t> pick(0, plan.groupCount() - 1);
+                for (size_t i = 0; i < selections; i++) {
+                    const KeystrokePlan::Group& group = plan.group(pick(generator));
+                    sum += plan.events()[group.firstEvent].code + group.eventCount;
+                }
+                g_sink = g_sink + sum;
+            }, selections, options);
+            out << JsonLine("group_select").add("groups", static_cast<uint64_t>(groups))
+                   .add("events", static_cast<uint64_t>(plan.group(plan.groupCount() - 1).firstEvent))
+                   .add("unit", "selection").add(result).str() << std::endl;
+        }
+    }
+    
+    void printUsage(const char* programName) {
+        std::cout << "注入热路径基准测试，结果以JSON Lines输出" << std::endl;
+        std::cout << "用法: " << programName << " [选项]" << std::endl;
+        std::cout << std::endl;
+        std::cout << "选项:" << std::endl;
+        std::cout << "      --display <显示器>   同时测试XTest后端和Xlib查找（会真正注入按键，请使用Xvfb，如 :99）" << std::endl;
+        std::cout << "      --out <文件>         结果写入文件（默认输出到stdout）" << std::endl;
+        std::cout << "      --filter <名称>      只运行名称包含该字符串的测试（sink_send、keysym、scheduler_jitter、group_select）" << std::endl;
+        std::cout << "      --repetitions <次数> 每项重复轮数（默认: 5）" << std::endl;
+        std::cout << "      --quick              缩短运行时间（每轮0.05秒，抖动每项0.5秒，最多65536个字符组）" << std::endl;
+        std::cout << "  -h, --help               显示此帮助信息" << std::endl;
+    }
+    
+    bool parseArguments(int argc, char* argv[], BenchOptions& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "-h" || arg == "--help") {
+                return false;
+            } else if (arg == "--display" && hasValue) {
+                options.displayName = argv[++i];
+            } else if (arg == "--out" && hasValue) {
+                options.outputPath = argv[++i];
+            } else if (arg == "--filter" && hasValue) {
+                options.filter = argv[++i];
+            } else if (arg == "--repetitions" && hasValue) {
+                options.repetitions = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--quick") {
+                options.minSec = 0.05;
+                options.jitterSec = 0.5;
+                options.maxGroups = 1 << 16;
+            } else {
+                std::cerr << "未知选项或缺少参数: " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    bool selected(const BenchOptions& options, const char* name) {
+        return options.filter.empty() || std::string(name).find(options.filter) != std::string::npos;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            std::cerr << "错误: 无法创建输出文件: " << options.outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.outputPath.empty() ? std::cout : file;
+    
+#ifndef NDEBUG
+    std::cerr << "警告: 未开启优化（非Release构建），结果不能与其他版本比较" << std::endl;
+#endif
+    
+    // 第一行记录运行环境，便于比较时确认条件一致
+    out << JsonLine("meta").add("format_version", static_cast<uint64_t>(1))
+           .add("timestamp", static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count()))
+#ifdef __VERSION__
+           .add("compiler", __VERSION__)
+#endif
+#ifdef NDEBUG
+           .add("optimized", true)
+#else
+           .add("optimized", false)
+#endif
+           .add("hardware_threads", static_cast<uint64_t>(std::thread::hardware_concurrency()))
+           .add("display", options.displayName)
+           .add("repetitions", static_cast<uint64_t>(options.repetitions))
+           .add("min_sec", options.minSec).str() << std::endl;
+    
+    KeyMap keymap;
+    loadKeyMap(keymap, options);
+    
+    if (selected(options, "sink_send")) {
+        std::cerr << "输出后端开销..." << std::endl;
+        benchSinks(options, keymap, out);
+    }
+    if (selected(options, "keysym") || selected(options, "plan_compile")) {
+        std::cerr << "KeySym解析开销..." << std::endl;
+        benchKeysym(options, keymap, out);
+    }
+    if (selected(options, "scheduler_jitter")) {
+        std::cerr << "调度器醒来抖动..." << std::endl;
+        benchJitter(options, out);
+    }
+    if (selected(options, "group_select")) {
+        std::cerr << "字符组选择开销..." << std::endl;
+        benchSelection(options, keymap, out);
+    }
+    return 0;
+}
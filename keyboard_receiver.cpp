@@ -0,0 +1,212 @@
+/**
+ * 按键接收窗口
+ * 端到端延迟测量的接收端：创建一个获得输入焦点的最小X窗口，
+ * 给收到的每个KeyPress打上CLOCK_MONOTONIC时间戳，并通过UNIX套接字发给模拟器
+ */
+#include "latency_probe.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+    volatile std::sig_atomic_t g_stop = 0;
+    
+    void onSignal(int) {
+        g_stop = 1;
+    }
+    
+    int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    void printUsage(const char* programName) {
+        std::cout << "按键接收窗口（端到端延迟测量的接收端）" << std::endl;
+        std::cout << "用法: " << programName << " [选项]" << std::endl;
+        std::cout << std::endl;
+        std::cout << "选项:" << std::endl;
+        std::cout << "      --socket <路径>      监听的UNIX套接字路径（默认: /tmp/keyboard_receiver.sock）" << std::endl;
+        std::cout << "      --display <显示>     X显示名（默认使用DISPLAY环境变量）" << std::endl;
+        std::cout << "  -h, --help               显示此帮助信息" << std::endl;
+    }
+    
+    // 创建监听套接字，失败时返回-1
+    int listenSocket(const std::string& path) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            std::cerr << "无法创建套接字: " << std::strerror(errno) << std::endl;
+            return -1;
+        }
+        
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "套接字路径过长: " << path << std::endl;
+            close(fd);
+            return -1;
+        }
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 1) < 0) {
+            std::cerr << "无法监听 " << path << ": " << std::strerror(errno) << std::endl;
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    
+    // 把记录完整写入客户端，失败时返回false
+    bool writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string socketPath = "/tmp/keyboard_receiver.sock";
+    const char* displayName = nullptr;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--display" && i + 1 < argc) {
+            displayName = argv[++i];
+        } else {
+            std::cerr << "未知选项: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    
+    Display* display = XOpenDisplay(displayName);
+    if (!display) {
+        std::cerr << "无法打开X显示" << std::endl;
+        return 1;
+    }
+    
+    // 创建接收窗口，只关心按键、映射和焦点事件
+    int screen = DefaultScreen(display);
+    Window window = XCreateSimpleWindow(display, RootWindow(display, screen), 0, 0, 320, 120, 0,
+                                        BlackPixel(display, screen), WhitePixel(display, screen));
+    XStoreName(display, window, "KeyboardReceiver");
+    XSelectInput(display, window, KeyPressMask | StructureNotifyMask | FocusChangeMask);
+    XMapRaised(display, window);
+    
+    // 窗口映射后才能设置焦点
+    XEvent event;
+    do {
+        XNextEvent(display, &event);
+    } while (event.type != MapNotify);
+    XSetInputFocus(display, window, RevertToParent, CurrentTime);
+    XSync(display, False);
+    
+    int listenFd = listenSocket(socketPath);
+    if (listenFd < 0) {
+        XCloseDisplay(display);
+        return 1;
+    }
+    std::cout << "接收窗口已就绪，等待连接: " << socketPath << std::endl;
+    
+    int clientFd = -1;
+    uint32_t sequence = 0;
+    uint64_t total = 0;
+    std::vector<LatencyRecord> records;
+    records.reserve(256);
+    
+    while (!g_stop) {
+        // 先处理Xlib已缓存的事件，再阻塞在X连接和套接字上
+        records.clear();
+        while (XPending(display) > 0) {
+            XNextEvent(display, &event);
+            int64_t timestamp = nowNs();
+            if (event.type == KeyPress) {
+                records.push_back(LatencyRecord{timestamp, event.xkey.keycode, sequence++});
+                total++;
+            } else if (event.type == FocusOut) {
+                // 焦点被抢走时重新获取，避免后续按键发往其他窗口
+                XSetInputFocus(display, window, RevertToParent, CurrentTime);
+                XFlush(display);
+            }
+        }
+        if (clientFd >= 0 && !records.empty()) {
+            if (!writeAll(clientFd, reinterpret_cast<const char*>(records.data()),
+                          records.size() * sizeof(LatencyRecord))) {
+                std::cout << "模拟器已断开连接" << std::endl;
+                close(clientFd);
+                clientFd = -1;
+            }
+        }
+        
+        pollfd fds[3];
+        nfds_t count = 0;
+        fds[count++] = pollfd{ConnectionNumber(display), POLLIN, 0};
+        fds[count++] = pollfd{listenFd, POLLIN, 0};
+        if (clientFd >= 0) {
+            fds[count++] = pollfd{clientFd, POLLIN, 0};
+        }
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        
+        if (fds[1].revents & POLLIN) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                // 只服务一个模拟器，新连接替换旧连接
+                if (clientFd >= 0) {
+                    close(clientFd);
+                }
+                clientFd = fd;
+                sequence = 0;
+                std::cout << "模拟器已连接" << std::endl;
+            }
+        }
+        if (count > 2 && (fds[2].revents & (POLLIN | POLLHUP | POLLERR))) {
+            char discard[64];
+            if (read(clientFd, discard, sizeof(discard)) <= 0) {
+                std::cout << "模拟器已断开连接" << std::endl;
+                close(clientFd);
+                clientFd = -1;
+            }
+        }
+    }
+    
+    std::cout << "共接收 " << total << " 个按键" << std::endl;
+    if (clientFd >= 0) {
+        close(clientFd);
+    }
+    close(listenFd);
+    unlink(socketPath.c_str());
+    XDestroyWindow(display, window);
+    XCloseDisplay(display);
+    return 0;
+}
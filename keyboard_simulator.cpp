@@ -1,41 +1,177 @@
 #include "keyboard_simulator.h"
 #include <iostream>
+#ifdef __linux__
+#include <X11/XKBlib.h>
+#include <X11/extensions/XInput2.h>
+#include <csignal>
+#include <sys/epoll.h>
+#endif
 #include <chrono>
 #include <algorithm>
+#include <iomanip>
 #include <random>
+#include <sstream>
+
+namespace {
+    // 按住模式预先抽样的按住时长个数（循环使用）
+    const size_t HoldSampleCount = 4096;
+    
+    // 取不到系统设置时使用的自动重复延迟和间隔（X服务器默认值，毫秒）
+    const double DefaultRepeatDelayMs = 660.0;
+    const double DefaultRepeatIntervalMs = 40.0;
+    
+#ifdef __linux__
+    // 显示器的核心键盘映射（起始键码和每个键码前两级的KeySym），用于比较各显示器的布局是否一致
+    std::vector<KeySym> coreKeyboardMapping(Display* display) {
+        int minKeycode = 0;
+        int maxKeycode = 0;
+        XDisplayKeycodes(display, &minKeycode, &maxKeycode);
+        int count = maxKeycode - minKeycode + 1;
+        int perKeycode = 0;
+        KeySym* keysyms = XGetKeyboardMapping(display, static_cast<KeyCode>(minKeycode), count, &perKeycode);
+        std::vector<KeySym> mapping;
+        if (!keysyms) {
+            return mapping;
+        }
+        mapping.reserve(static_cast<size_t>(count) * 2 + 1);
+        mapping.push_back(static_cast<KeySym>(minKeycode));
+        for (int i = 0; i < count; i++) {
+            for (int level = 0; level < 2; level++) {
+                mapping.push_back(level < perKeycode ? keysyms[i * perKeycode + level] : NoSymbol);
+            }
+        }
+        XFree(keysyms);
+        return mapping;
+    }
+#endif
+}
 
 KeyboardSimulator::KeyboardSimulator()
-    : m_inputDelayMs(100)
-    , m_running(false)
-    , m_active(false)
-    , m_paused(false)
-    , m_shouldExit(false)
+    : KeyboardSimulator(std::vector<std::string>())
+{
+}
+
+KeyboardSimulator::KeyboardSimulator(const std::vector<std::string>& displays)
+    : m_spinThreshold(0)
+    , m_missPolicy(DeadlineScheduler::MissPolicy::CatchUp)
+    , m_batchSize(1)
+    , m_workerCount(1)
+    , m_replaySpeed(1.0)
+    , m_holdOverlap(1)
+    , m_holdSeed(0)
+    , m_outputBackend(OutputBackend::Native)
+    , m_ringCapacity(0)
+    , m_autoStart(false)
+    , m_latencyProbe(nullptr)
+    , m_metricsInterval(std::chrono::seconds(5))
 #ifdef _WIN32
     , m_lastLeftMouseState(0)
     , m_lastRightMouseState(0)
+    , m_lastPauseKeyState(0)
 #elif __linux__
     , m_lastLeftMouseState(false)
     , m_lastRightMouseState(false)
+    , m_lastPauseKeyState(false)
     , m_display(nullptr)
+    , m_displayNames(displays)
+    , m_monitorDisplay(nullptr)
+    , m_xkbEventBase(-1)
+    , m_xiOpcode(-1)
+    , m_escKeycode(0)
+    , m_pauseKeycode(0)
+    , m_pollTimerFd(-1)
 #endif
-    , m_randomGenerator(std::random_device{}())
 {
 #ifdef __linux__
     // 初始化X11线程支持（必须在XOpenDisplay之前调用）
     XInitThreads();
     
-    // 初始化X11显示连接
-    m_display = XOpenDisplay(nullptr);
-    if (!m_display) {
-        std::cerr << "错误: 无法连接到X服务器" << std::endl;
-    } else {
+    // 初始化X11显示连接（连到第一个显示器）
+    const char* displayName = m_displayNames.empty() ? nullptr : m_displayNames.front().c_str();
+    // 连接失败时不在这里报错：null和memory后端不需要X服务器，原生后端在start()中报错
+    m_display = XOpenDisplay(displayName);
+    if (m_display) {
         // 检查XTest扩展是否可用
         int event_base, error_base, major, minor;
         if (!XTestQueryExtension(m_display, &event_base, &error_base, &major, &minor)) {
             std::cerr << "警告: XTest扩展不可用，键盘模拟可能无法正常工作" << std::endl;
         }
+        
+        // 空闲键码留给输出后端临时绑定映射中没有的字符，解析映射时跳过它们
+        m_spareKeycodes = KeycodePool::findSpareKeycodes(m_display);
+        
+        // 按键计划只按第一个显示器的映射编译一次，其他显示器的映射应当与它相同；
+        // 空闲键码只保留在所有显示器上都空闲的，临时绑定不会改写任何显示器上已有的按键
+        std::vector<KeySym> mapping = coreKeyboardMapping(m_display);
+        for (size_t i = 1; i < m_displayNames.size(); i++) {
+            Display* other = XOpenDisplay(m_displayNames[i].c_str());
+            if (!other) {
+                std::cerr << "警告: 无法连接到显示器 " << m_displayNames[i] << std::endl;
+                continue;
+            }
+            if (!XTestQueryExtension(other, &event_base, &error_base, &major, &minor)) {
+                std::cerr << "警告: 显示器 " << m_displayNames[i] << " 上XTest扩展不可用" << std::endl;
+            }
+            if (coreKeyboardMapping(other) != mapping) {
+                std::cerr << "警告: 显示器 " << m_displayNames[i] << " 的键盘映射与 " << m_displayNames[0]
+                          << " 不同，按键按 " << m_displayNames[0] << " 的映射注入，在该显示器上可能输入不同的字符"
+                          << std::endl;
+            }
+            std::vector<uint8_t> spare = KeycodePool::findSpareKeycodes(other);
+            m_spareKeycodes.erase(std::remove_if(m_spareKeycodes.begin(), m_spareKeycodes.end(), [&](uint8_t keycode) {
+                return std::find(spare.begin(), spare.end(), keycode) == spare.end();
+            }), m_spareKeycodes.end());
+            XCloseDisplay(other);
+        }
+        if (m_spareKeycodes.empty()) {
+            std::cerr << "警告: 没有空闲键码，当前键盘映射中没有的字符将被跳过" << std::endl;
+        }
+        m_keyMap.setReservedKeycodes(m_spareKeycodes);
+        m_keyMap.load(m_display);
+    }
+    
+    // 监听使用独立的X11连接：鼠标、ESC和键盘映射变化都由服务器推送到这个连接，
+    // 注入连接只被输入线程使用，注入时不会等待监听
+    m_monitorDisplay = XOpenDisplay(displayName);
+    if (m_monitorDisplay) {
+        // 订阅XKB映射变化通知，映射变化时重新编译按键计划
+        int opcode, eventBase, errorBase;
+        int major = XkbMajorVersion;
+        int minor = XkbMinorVersion;
+        if (XkbQueryExtension(m_monitorDisplay, &opcode, &eventBase, &errorBase, &major, &minor)) {
+            m_xkbEventBase = eventBase;
+            XkbSelectEvents(m_monitorDisplay, XkbUseCoreKbd,
+                            XkbNewKeyboardNotifyMask | XkbMapNotifyMask,
+                            XkbNewKeyboardNotifyMask | XkbMapNotifyMask);
+        }
+        
+        // 订阅XInput2原始事件，鼠标点击和ESC由服务器推送，无需轮询
+        major = 2;
+        minor = 0;
+        if (XQueryExtension(m_monitorDisplay, "XInputExtension", &opcode, &eventBase, &errorBase) &&
+            XIQueryVersion(m_monitorDisplay, &major, &minor) == Success) {
+            unsigned char mask[XIMaskLen(XI_LASTEVENT)] = {};
+            XISetMask(mask, XI_RawKeyPress);
+            XISetMask(mask, XI_RawButtonRelease);
+            XIEventMask eventMask;
+            eventMask.deviceid = XIAllMasterDevices;
+            eventMask.mask_len = sizeof(mask);
+            eventMask.mask = mask;
+            XISelectEvents(m_monitorDisplay, DefaultRootWindow(m_monitorDisplay), &eventMask, 1);
+            XFlush(m_monitorDisplay);
+            m_xiOpcode = opcode;
+        } else {
+            std::cerr << "警告: XInput2扩展不可用，退回到轮询方式监听鼠标和键盘" << std::endl;
+        }
     }
+    
+    // 工作线程执行完时唤醒事件循环，主循环立即结束
+    m_control.notify = [this] { wakeEventLoop(); };
 #endif
+    
+    // 发布键盘映射的快照，语料库模式下工作线程用它编译抽取到的字符组
+    std::atomic_store(&m_control.keyMap, std::make_shared<const KeyMap>(m_keyMap));
+    setInputPeriod(std::chrono::milliseconds(100));
 }
 
 KeyboardSimulator::~KeyboardSimulator() {
@@ -44,87 +180,759 @@ KeyboardSimulator::~KeyboardSimulator() {
 }
 
 void KeyboardSimulator::setInputText(const std::string& text) {
-    m_inputTexts.clear();
-    m_inputTexts.push_back(text);
+    clearInputTexts();
+    addInputText(text);
 }
 
 void KeyboardSimulator::addInputText(const std::string& text) {
+    std::lock_guard<std::mutex> lock(m_planMutex);
     m_inputTexts.push_back(text);
+    
+    // 在当前计划的副本上追加新字符组，然后原子替换
+    auto plan = std::make_shared<KeystrokePlan>(*std::atomic_load(&m_control.plan));
+    size_t skipped = plan->addGroup(text, m_keyMap);
+    if (skipped > 0) {
+        std::cerr << "警告: 字符组 \"" << text << "\" 中有 " << skipped
+                  << " 个字符在当前键盘映射中无法输入，已跳过" << std::endl;
+    }
+    std::atomic_store(&m_control.plan, std::shared_ptr<const KeystrokePlan>(plan));
+    m_control.publish();
 }
 
 void KeyboardSimulator::clearInputTexts() {
+    std::lock_guard<std::mutex> lock(m_planMutex);
     m_inputTexts.clear();
+    std::atomic_store(&m_control.plan, std::make_shared<const KeystrokePlan>());
+    m_control.publish();
 }
 
-std::string KeyboardSimulator::getRandomInputText() {
-    if (m_inputTexts.empty()) {
-        return "";
+size_t KeyboardSimulator::setInputTexts(const std::vector<std::string>& texts) {
+    std::lock_guard<std::mutex> lock(m_planMutex);
+    
+    // 整组编译后一次替换，工作线程不会看到只替换了一半（或为空）的计划
+    auto plan = std::make_shared<KeystrokePlan>();
+    size_t skipped = 0;
+    for (const auto& text : texts) {
+        skipped += plan->addGroup(text, m_keyMap);
     }
+    m_inputTexts = texts;
+    std::atomic_store(&m_control.plan, std::shared_ptr<const KeystrokePlan>(plan));
+    m_control.publish();
+    return skipped;
+}
+
+void KeyboardSimulator::rebuildKeystrokePlan(bool reloadKeyMap) {
+    std::lock_guard<std::mutex> lock(m_planMutex);
+#ifdef __linux__
+    // 映射变化只由事件循环处理，使用监听连接加载，不占用注入连接
+    if (reloadKeyMap) {
+        m_keyMap.load(m_monitorDisplay);
+    }
+#else
+    (void)reloadKeyMap;
+#endif
+    
+    auto plan = std::make_shared<KeystrokePlan>();
+    size_t skipped = 0;
+    for (const auto& text : m_inputTexts) {
+        skipped += plan->addGroup(text, m_keyMap);
+    }
+    if (skipped > 0) {
+        std::cerr << "警告: 共有 " << skipped << " 个字符在当前键盘映射中无法输入，已跳过" << std::endl;
+    }
+    std::atomic_store(&m_control.plan, std::shared_ptr<const KeystrokePlan>(plan));
+    std::atomic_store(&m_control.keyMap, std::make_shared<const KeyMap>(m_keyMap));
+    m_control.publish();
     
-    std::uniform_int_distribution<size_t> dist(0, m_inputTexts.size() - 1);
-    size_t index = dist(m_randomGenerator);
-    return m_inputTexts[index];
+    // 新映射下编译失败时保留原来的场景
+    if (m_scenario) {
+        compileScenario();
+    }
+}
+
+bool KeyboardSimulator::compileScenario() {
+    auto program = std::make_shared<ScenarioProgram>();
+    size_t groupCount = std::atomic_load(&m_control.plan)->groupCount();
+    if (!m_scenario->compile(m_keyMap, groupCount, m_control.corpus != nullptr, *program)) {
+        return false;
+    }
+    std::atomic_store(&m_control.scenario, std::shared_ptr<const ScenarioProgram>(program));
+    return true;
 }
 
 void KeyboardSimulator::setInputFrequency(double frequency) {
     if (frequency > 0) {
-        m_inputDelayMs = static_cast<int>(1000.0 / frequency);
+        // 以纳秒保存周期，保留小数频率并支持1000次/秒以上的频率
+        setInputPeriod(std::chrono::nanoseconds(static_cast<int64_t>(1e9 / frequency + 0.5)));
     }
 }
 
 void KeyboardSimulator::setInputDelay(int delayMs) {
-    m_inputDelayMs = delayMs;
+    setInputPeriod(std::chrono::milliseconds(delayMs > 0 ? delayMs : 0));
+}
+
+void KeyboardSimulator::setInputPeriod(std::chrono::nanoseconds period) {
+    // 构造新的配置快照整体替换，运行中的工作线程在下一个截止时间读到新周期
+    auto config = std::make_shared<InputConfig>();
+    config->period = period;
+    std::atomic_store(&m_control.config, std::shared_ptr<const InputConfig>(config));
+    m_control.publish();
+}
+
+std::chrono::nanoseconds KeyboardSimulator::inputPeriod() const {
+    return std::atomic_load(&m_control.config)->period;
+}
+
+void KeyboardSimulator::setSpinThreshold(int spinUs) {
+    m_spinThreshold = std::chrono::microseconds(spinUs > 0 ? spinUs : 0);
+}
+
+void KeyboardSimulator::setMissPolicy(DeadlineScheduler::MissPolicy policy) {
+    m_missPolicy = policy;
+}
+
+#ifdef __linux__
+void KeyboardSimulator::setTargets(const std::vector<TargetWindow>& targets) {
+    m_targets = targets;
+    if (!m_targets.empty()) {
+        WindowFinder::installErrorHandler();
+    }
+}
+#endif
+
+void KeyboardSimulator::setRealtime(const RealtimeOptions& options) {
+    m_realtime = options;
+}
+
+void KeyboardSimulator::setWorkerCount(size_t workers) {
+    m_workerCount = workers > 0 ? workers : 1;
+}
+
+void KeyboardSimulator::setBatchSize(size_t events) {
+    m_batchSize = events;
+}
+
+void KeyboardSimulator::setOutputBackend(OutputBackend backend, size_t ringCapacity) {
+    m_outputBackend = backend;
+    m_ringCapacity = ringCapacity;
+    
+#ifdef __linux__
+    // 非原生后端在没有X服务器时使用合成映射，保证按键计划仍可编译
+    if (backend != OutputBackend::Native && !m_keyMap.isLoaded()) {
+        std::cout << "提示: 没有连接到X服务器，按内置的ASCII键盘映射编译按键" << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(m_planMutex);
+            m_keyMap.loadFallback();
+        }
+        rebuildKeystrokePlan(false);
+    }
+#endif
+}
+
+void KeyboardSimulator::setAutoStart(bool autoStart) {
+    m_autoStart = autoStart;
+}
+
+void KeyboardSimulator::setCorpus(std::shared_ptr<const TextCorpus> corpus) {
+    m_control.corpus = corpus;
+}
+
+size_t KeyboardSimulator::setTypingModel(std::shared_ptr<const TypingModel> model) {
+    m_control.typing = model;
+    if (!model) {
+        return 0;
+    }
+    // 符号编号即字符组编号，映射变化时随字符组一起重新编译
+    return setInputTexts(model->symbolTexts());
+}
+
+std::shared_ptr<const KeyMap> KeyboardSimulator::keyMap() const {
+    return std::atomic_load(&m_control.keyMap);
+}
+
+void KeyboardSimulator::setRateProfile(std::shared_ptr<const RateProfile> profile) {
+    m_rateProfile = profile;
+}
+
+void KeyboardSimulator::setReplayTrace(std::shared_ptr<TraceReader> trace, double speed) {
+    m_replayTrace = trace;
+    if (speed > 0) {
+        m_replaySpeed = speed;
+    }
+}
+
+bool KeyboardSimulator::setScenario(std::shared_ptr<const Scenario> scenario) {
+    std::lock_guard<std::mutex> lock(m_planMutex);
+    m_scenario = scenario;
+    if (!m_scenario) {
+        std::atomic_store(&m_control.scenario, std::shared_ptr<const ScenarioProgram>());
+        return true;
+    }
+    return compileScenario();
+}
+
+void KeyboardSimulator::setHoldModel(std::shared_ptr<const HoldModel> model, size_t overlap, uint32_t seed) {
+    m_holdModel = model;
+    m_holdOverlap = std::max<size_t>(1, overlap);
+    m_holdSeed = seed;
+}
+
+void KeyboardSimulator::setPointerStorm(std::shared_ptr<const PointerStorm> storm) {
+    m_pointerStorm = storm;
+}
+
+void KeyboardSimulator::setMetricsOutput(const std::string& path, double intervalSec) {
+    m_metricsPath = path;
+    if (intervalSec > 0) {
+        m_metricsInterval = std::chrono::milliseconds(static_cast<int64_t>(intervalSec * 1000.0));
+    }
+}
+
+void KeyboardSimulator::setLatencyProbe(LatencyProbe* probe) {
+    m_latencyProbe = probe;
+}
+
+#ifdef __linux__
+void KeyboardSimulator::setControlSocket(const std::string& path) {
+    m_controlPath = path;
+}
+#endif
+
+std::string KeyboardSimulator::handleControlCommand(const std::string& command) {
+    std::istringstream input(command);
+    std::string name;
+    input >> name;
+    
+    if (name == "set-rate" || name == "set-delay") {
+        // 负载曲线、回放和场景自行决定节奏，固定频率对它们没有意义
+        if (m_rateProfile || m_replayTrace || m_scenario) {
+            return "error 负载曲线、回放和场景模式下不能修改频率";
+        }
+        double value = 0;
+        std::string extra;
+        if (!(input >> value) || (input >> extra)) {
+            return "error 用法: " + name + (name == "set-rate" ? " <次/秒>" : " <毫秒>");
+        }
+        if (name == "set-rate") {
+            if (value <= 0) {
+                return "error 频率必须大于0";
+            }
+            setInputFrequency(value);
+        } else {
+            if (value < 0) {
+                return "error 延迟不能为负数";
+            }
+            setInputPeriod(std::chrono::nanoseconds(static_cast<int64_t>(value * 1e6 + 0.5)));
+        }
+        std::ostringstream reply;
+        std::chrono::nanoseconds period = inputPeriod();
+        reply << "ok period_ns=" << period.count();
+        if (period.count() > 0) {
+            reply << " rate=" << 1e9 / static_cast<double>(period.count());
+        }
+        return reply.str();
+    }
+    
+    if (name == "set-groups") {
+        // 字符组之间用制表符分隔，字符组本身可以包含空格
+        if (m_control.corpus) {
+            return "error 使用语料库时不能修改字符组";
+        }
+        if (m_control.typing) {
+            return "error 使用打字模型时不能修改字符组";
+        }
+        size_t start = command.find_first_not_of(" \t", name.size());
+        if (start == std::string::npos) {
+            return "error 用法: set-groups <字符组>[\t<字符组>...]";
+        }
+        std::vector<std::string> texts;
+        std::string rest = command.substr(start);
+        size_t begin = 0;
+        while (begin <= rest.size()) {
+            size_t tab = rest.find('\t', begin);
+            std::string text = rest.substr(begin, tab == std::string::npos ? std::string::npos : tab - begin);
+            if (!text.empty()) {
+                texts.push_back(text);
+            }
+            if (tab == std::string::npos) {
+                break;
+            }
+            begin = tab + 1;
+        }
+        size_t skipped = setInputTexts(texts);
+        std::ostringstream reply;
+        reply << "ok groups=" << texts.size() << " skipped=" << skipped;
+        return reply.str();
+    }
+    
+    if (name == "pause") {
+        return pause() ? "ok paused" : "error 未在输入或已暂停";
+    }
+    if (name == "resume") {
+        return resume() ? "ok resumed" : "error 已在输入";
+    }
+    if (name == "stats") {
+        std::string json = metrics().toJson();
+        while (!json.empty() && json.back() == '\n') {
+            json.pop_back();
+        }
+        return "ok " + json;
+    }
+    if (name == "help") {
+        return "ok set-rate <次/秒> | set-delay <毫秒> | set-groups <字符组>[\\t<字符组>...] | pause | resume | stats";
+    }
+    return "error 未知命令: " + name;
+}
+
+std::unique_ptr<KeyEventSink> KeyboardSimulator::createSink(size_t workerIndex) {
+    switch (m_outputBackend) {
+        case OutputBackend::Null:
+            return std::unique_ptr<KeyEventSink>(new RecordingSink(0));
+        case OutputBackend::Memory:
+            return std::unique_ptr<KeyEventSink>(new RecordingSink(m_ringCapacity));
+        case OutputBackend::Native:
+        default:
+            break;
+    }
+    
+#ifdef _WIN32
+    (void)workerIndex;
+    return std::unique_ptr<KeyEventSink>(new SendInputSink());
+#elif __linux__
+    // 第一个工作线程复用主连接，其余工作线程各自打开独立的X连接
+    // 每个后端分到互不重叠的一部分空闲键码，临时绑定时不会改写其他后端正在使用的键码；
+    // 驱动多个显示器时每个工作线程连到自己的显示器，映射修改互不影响，每个后端都使用全部空闲键码
+    bool multiDisplay = m_displayNames.size() > 1;
+    const char* displayName = nullptr;
+    if (!m_displayNames.empty()) {
+        displayName = m_displayNames[multiDisplay ? workerIndex : 0].c_str();
+    }
+    std::vector<uint8_t> spareKeycodes = multiDisplay ? m_spareKeycodes
+        : KeycodePool::partition(m_spareKeycodes, workerIndex, effectiveWorkerCount());
+    if (workerIndex == 0 && m_targets.empty()) {
+        std::unique_ptr<XTestSink> sink(new XTestSink(m_display, m_displayMutex));
+        sink->setSpareKeycodes(spareKeycodes);
+        return std::unique_ptr<KeyEventSink>(sink.release());
+    }
+    // 定向注入：每个目标使用自己的连接，通过XSendEvent直接发给目标窗口
+    if (workerIndex < m_targets.size()) {
+        std::unique_ptr<XSendEventSink> sink = XSendEventSink::open(displayName, m_targets[workerIndex].window);
+        if (!sink) {
+            std::cerr << "警告: 目标 " << workerIndex << " 无法连接到X服务器，改用空后端" << std::endl;
+            return std::unique_ptr<KeyEventSink>(new RecordingSink(0));
+        }
+        sink->setSpareKeycodes(spareKeycodes);
+        return std::unique_ptr<KeyEventSink>(sink.release());
+    }
+    std::unique_ptr<XTestSink> sink = XTestSink::open(displayName);
+    if (!sink) {
+        std::cerr << "警告: 工作线程 " << workerIndex << " 无法连接到"
+                  << (multiDisplay ? std::string("显示器 ") + displayName : std::string("X服务器")) << "，改用空后端"
+                  << std::endl;
+        return std::unique_ptr<KeyEventSink>(new RecordingSink(0));
+    }
+    sink->setSpareKeycodes(spareKeycodes);
+    return std::unique_ptr<KeyEventSink>(sink.release());
+#endif
+}
+
+size_t KeyboardSimulator::effectiveWorkerCount() const {
+#ifdef __linux__
+    // 定向注入时每个目标一个工作线程，各自执行完整的输入（包括场景）
+    if (!m_targets.empty()) {
+        return m_targets.size();
+    }
+    // 驱动多个显示器时每个显示器一个工作线程，同样各自执行完整的输入
+    if (m_displayNames.size() > 1) {
+        return m_displayNames.size();
+    }
+#endif
+    // 轨迹和场景中的事件有先后依赖（修饰键、按下与释放），只能由一个工作线程按顺序执行；
+    // 按住模式中同一个键不能被两个工作线程同时按下
+    return (m_replayTrace || m_scenario || m_holdModel) ? 1 : m_workerCount;
+}
+
+double KeyboardSimulator::workerRate(size_t workerIndex) const {
+    std::chrono::nanoseconds period = inputPeriod();
+    double totalRate = period.count() > 0 ? 1e9 / static_cast<double>(period.count()) : 0.0;
+#ifdef __linux__
+    if (workerIndex < m_targets.size()) {
+        return m_targets[workerIndex].frequency > 0 ? m_targets[workerIndex].frequency : totalRate;
+    }
+    if (m_displayNames.size() > 1) {
+        return totalRate;
+    }
+#endif
+    return totalRate / static_cast<double>(effectiveWorkerCount());
+}
+
+bool KeyboardSimulator::independentWorkers() const {
+#ifdef __linux__
+    return !m_targets.empty() || m_displayNames.size() > 1;
+#else
+    return false;
+#endif
+}
+
+void KeyboardSimulator::autoRepeatTiming(double& delayMs, double& intervalMs) {
+    delayMs = DefaultRepeatDelayMs;
+    intervalMs = DefaultRepeatIntervalMs;
+#ifdef _WIN32
+    // 延迟为0-3对应250-1000毫秒，速度为0-31对应约每秒2.5-30次
+    int delay = 0;
+    DWORD speed = 0;
+    if (SystemParametersInfo(SPI_GETKEYBOARDDELAY, 0, &delay, 0)) {
+        delayMs = (delay + 1) * 250.0;
+    }
+    if (SystemParametersInfo(SPI_GETKEYBOARDSPEED, 0, &speed, 0)) {
+        intervalMs = 1000.0 / (2.5 + speed * (30.0 - 2.5) / 31.0);
+    }
+#elif __linux__
+    std::lock_guard<std::mutex> lock(m_displayMutex);
+    unsigned int delay = 0;
+    unsigned int interval = 0;
+    if (m_display && XkbGetAutoRepeatRate(m_display, XkbUseCoreKbd, &delay, &interval) && interval > 0) {
+        delayMs = delay;
+        intervalMs = interval;
+    }
+#endif
+}
+
+void KeyboardSimulator::startWorkers() {
+    std::lock_guard<std::mutex> lock(m_workersMutex);
+    if (!m_workers.empty()) {
+        return;
+    }
+    
+    // 协调者把总频率平均分给各工作线程：每个工作线程的周期是总周期的N倍，
+    // 相位依次错开一个总周期，合起来恰好是目标频率
+    // 定向注入或驱动多个显示器时各工作线程互不分摊：每个目标或显示器按自己的频率执行完整的负载，
+    // 相位在一个周期内错开
+    size_t count = effectiveWorkerCount();
+    bool independent = independentWorkers();
+    std::chrono::nanoseconds period = inputPeriod();
+    double repeatDelayMs = DefaultRepeatDelayMs;
+    double repeatIntervalMs = DefaultRepeatIntervalMs;
+    if (m_holdModel && m_holdModel->usesAutoRepeat()) {
+        autoRepeatTiming(repeatDelayMs, repeatIntervalMs);
+    }
+    for (size_t i = 0; i < count; i++) {
+        WorkerSettings settings;
+        settings.period = period * static_cast<int64_t>(count);
+        settings.phase = period * static_cast<int64_t>(i);
+        settings.periodShare = independent ? 1 : static_cast<int64_t>(count);
+        if (independent) {
+            double rate = workerRate(i);
+            settings.period = DeadlineScheduler::Duration(rate > 0 ? static_cast<int64_t>(1e9 / rate + 0.5) : 0);
+            settings.phase = settings.period * static_cast<int64_t>(i) / static_cast<int64_t>(count);
+        }
+        settings.spinThreshold = m_spinThreshold;
+        settings.missPolicy = m_missPolicy;
+        settings.batchSize = m_batchSize;
+        settings.trace = m_replayTrace;
+        settings.replaySpeed = m_replaySpeed;
+        settings.realtime = m_realtime;
+        settings.overlap = m_holdOverlap;
+        // 鼠标事件只由第一个工作线程注入（每个显示器各自注入），各类事件和按键共用它的调度器
+        if (i == 0 || independent) {
+            settings.pointer = m_pointerStorm;
+        }
+        if (m_holdModel) {
+            // 按住时长在启动前抽样，热循环中只按顺序读取
+            settings.holdDurations = m_holdModel->sample(HoldSampleCount, m_holdSeed + static_cast<uint32_t>(i),
+                                                         repeatDelayMs, repeatIntervalMs);
+        }
+        if (m_rateProfile && !m_replayTrace) {
+            // 按负载曲线运行：到达轮流分配给各工作线程，周期序列预先算好
+            int64_t phaseNs = 0;
+            settings.intervals = independent ? m_rateProfile->workerIntervals(0, 1, phaseNs)
+                                          : m_rateProfile->workerIntervals(i, count, phaseNs);
+            if (settings.intervals.empty()) {
+                // 到达数少于工作线程数，多出的工作线程无事可做
+                m_control.finishedWorkers++;
+                continue;
+            }
+            settings.period = DeadlineScheduler::Duration(settings.intervals.front());
+            settings.phase = DeadlineScheduler::Duration(phaseNs);
+        }
+        std::unique_ptr<KeyEventSink> sink = createSink(i);
+        if (m_latencyProbe) {
+            sink.reset(new ProbeSink(std::move(sink), *m_latencyProbe));
+        }
+        m_workers.emplace_back(new InputWorker(i, m_control, std::move(sink), settings));
+    }
+    
+    m_inputStartTime = DeadlineScheduler::Clock::now();
+    for (auto& worker : m_workers) {
+        worker->start(m_inputStartTime);
+    }
+    
+    // 工作线程的缓冲区和栈都已分配，此时锁定可以覆盖输入路径用到的全部内存
+    if (m_realtime.enabled) {
+        Realtime::lockMemory();
+    }
+    
+    // 工作线程创建后才启动指标输出，输出线程只读取已存在的工作线程
+    if (!m_metricsPath.empty()) {
+        m_metricsReporter.start(m_metricsPath, m_metricsInterval, [this] {
+            return collectMetrics(DeadlineScheduler::Clock::now());
+        });
+    }
+}
+
+MetricsSnapshot KeyboardSimulator::collectMetrics(DeadlineScheduler::TimePoint end) const {
+    MetricsSnapshot snapshot;
+    if (m_workers.empty()) {
+        return snapshot;
+    }
+    
+    snapshot.backend = m_workers.front()->sink().name();
+    snapshot.elapsedSec = std::chrono::duration<double>(end - m_inputStartTime).count();
+    std::shared_ptr<const ScenarioProgram> scenario = std::atomic_load(&m_control.scenario);
+    if (m_replayTrace) {
+        snapshot.requestedRate = m_replayTrace->eventRate() * m_replaySpeed;
+    } else if (scenario) {
+        snapshot.requestedRate = scenario->eventRate();
+    } else if (m_rateProfile) {
+        snapshot.requestedRate = m_rateProfile->averageRate();
+    } else {
+        for (size_t i = 0; i < m_workers.size(); i++) {
+            snapshot.requestedRate += workerRate(m_workers[i]->index());
+        }
+    }
+    // 定向注入或驱动多个显示器时每个工作线程都执行完整的场景或负载曲线
+    if (independentWorkers() && (scenario || m_rateProfile)) {
+        snapshot.requestedRate *= static_cast<double>(effectiveWorkerCount());
+    }
+    
+    // 计数器都是relaxed原子变量，输入运行中读取也不会阻塞工作线程
+    for (const auto& worker : m_workers) {
+        const DeadlineScheduler& scheduler = worker->scheduler();
+        const KeyEventSink& sink = worker->sink();
+        MetricsSample sample;
+        sample.cyclesCompleted = scheduler.cyclesCompleted();
+        sample.deadlinesMissed = scheduler.deadlinesMissed();
+        sample.cyclesDropped = scheduler.cyclesDropped();
+        sample.eventsSent = sink.eventsSent();
+        sample.requestsSent = sink.requestsSent();
+        sample.flushCount = sink.flushCount();
+        sample.lockWaitNs = sink.lockWaitNs();
+        sample.lockHoldNs = sink.lockHoldNs();
+        sample.keycodeRemaps = sink.keycodeRemaps();
+        sample.lateness = worker->lateness().snapshot();
+#ifdef __linux__
+        if (m_displayNames.size() > 1) {
+            sample.display = m_displayNames[worker->index()];
+        }
+#endif
+        snapshot.total.merge(sample);
+        snapshot.workers.push_back(std::move(sample));
+    }
+    return snapshot;
+}
+
+void KeyboardSimulator::printStatistics() const {
+    if (m_workers.empty()) {
+        return;
+    }
+    
+    // 所有工作线程都已退出，以最后一个工作线程的结束时间计算时长
+    DeadlineScheduler::TimePoint lastEnd = m_workers.front()->endTime();
+    for (const auto& worker : m_workers) {
+        lastEnd = std::max(lastEnd, worker->endTime());
+    }
+    MetricsSnapshot snapshot = collectMetrics(lastEnd);
+    const MetricsSample& total = snapshot.total;
+    
+    if (m_workers.size() > 1) {
+        for (size_t i = 0; i < snapshot.workers.size(); i++) {
+            const MetricsSample& sample = snapshot.workers[i];
+            std::cout << "  工作线程 " << i << " [" << snapshot.backend << "]: 周期 "
+                      << sample.cyclesCompleted << "，错过截止时间 " << sample.deadlinesMissed
+                      << "，丢弃周期 " << sample.cyclesDropped << "，按键事件 " << sample.eventsSent;
+#ifdef __linux__
+            size_t index = m_workers[i]->index();
+            if (index < m_targets.size()) {
+                std::cout << "，目标 0x" << std::hex << m_targets[index].window << std::dec;
+                if (!m_targets[index].name.empty()) {
+                    std::cout << " \"" << m_targets[index].name << "\"";
+                }
+            }
+#endif
+            if (!sample.display.empty()) {
+                std::cout << "，显示器 " << sample.display;
+            }
+            std::cout << std::endl;
+        }
+    }
+    
+    if (total.cyclesCompleted > 0) {
+        std::cout << "已完成周期: " << total.cyclesCompleted << "，错过截止时间: " << total.deadlinesMissed
+                  << "，丢弃周期: " << total.cyclesDropped << std::endl;
+        std::cout << "实际频率: " << std::fixed << std::setprecision(2) << snapshot.achievedRate()
+                  << " 次/秒（请求 " << snapshot.requestedRate << " 次/秒）" << std::endl;
+    }
+    if (total.lateness.count() > 0) {
+        std::cout << "调度延迟: " << total.lateness.summary() << std::endl;
+    }
+    if (m_realtime.enabled) {
+        // 唤醒抖动即醒来时间相对截止时间的分布宽度，以p99与p50之差表示
+        for (const auto& worker : m_workers) {
+            const RealtimeStatus& status = worker->realtimeStatus();
+            std::cout << "实时模式: 工作线程 " << worker->index() << " "
+                      << (status.fifo ? "SCHED_FIFO" : "普通调度") << "，"
+                      << (status.cpu >= 0 ? "CPU " + std::to_string(status.cpu) : std::string("未绑定CPU")) << "，"
+                      << (status.timerFd ? "timerfd" : "sleep_until") << std::endl;
+        }
+        if (total.lateness.count() > 0) {
+            std::cout << "唤醒抖动: " << std::setprecision(1)
+                      << (total.lateness.percentile(99.0) - total.lateness.percentile(50.0)) / 1e3
+                      << " 微秒（p99 - p50），最大迟到 " << total.lateness.max() / 1e3 << " 微秒" << std::endl;
+        }
+    }
+    
+    double inputSeconds = snapshot.elapsedSec;
+    if (total.flushCount > 0 && inputSeconds > 0) {
+        std::cout << "输出后端: " << snapshot.backend
+                  << "，按键事件: " << total.eventsSent << "（" << static_cast<uint64_t>(total.eventsSent / inputSeconds)
+                  << " 个/秒），请求: " << total.requestsSent << "（" << static_cast<uint64_t>(total.requestsSent / inputSeconds)
+                  << " 次/秒），刷新: " << total.flushCount << "（" << static_cast<uint64_t>(total.flushCount / inputSeconds)
+                  << " 次/秒）" << std::endl;
+    }
+    if (total.keycodeRemaps > 0) {
+        // 重新绑定次数接近Unicode字符数时说明空闲键码不够覆盖常用字符，每个字符都多一次映射修改
+        std::cout << "Unicode字符: 修改键盘映射 " << total.keycodeRemaps << " 次（空闲键码 "
+                  << m_spareKeycodes.size() << " 个）" << std::endl;
+    }
+    if (m_holdModel) {
+        // 提前释放说明按住时长相对按下间隔太长，实际重叠深度被限制在overlap
+        size_t maxHeld = 0;
+        uint64_t forcedReleases = 0;
+        for (const auto& worker : m_workers) {
+            maxHeld = std::max(maxHeld, worker->maxHeld());
+            forcedReleases += worker->forcedReleases();
+        }
+        std::cout << "按住模式: 最多同时按住 " << maxHeld << " 个键（上限 " << m_holdOverlap
+                  << "），达到上限提前释放 " << forcedReleases << " 次" << std::endl;
+    }
+    if (m_pointerStorm) {
+        // 鼠标事件计入上面的按键事件数（点击和滚轮各为按下和释放两个事件），这里按类别分开列出
+        std::cout << "鼠标事件:";
+        for (size_t kind = 0; kind < PointerStorm::KindCount; kind++) {
+            uint64_t count = 0;
+            for (const auto& worker : m_workers) {
+                count += worker->pointer().count(static_cast<PointerStorm::Kind>(kind));
+            }
+            std::cout << (kind == 0 ? " " : "，") << PointerStorm::kindName(static_cast<PointerStorm::Kind>(kind))
+                      << " " << count;
+            if (inputSeconds > 0) {
+                std::cout << "（" << std::fixed << std::setprecision(1) << count / inputSeconds << " 次/秒）";
+            }
+        }
+        std::cout << std::endl;
+    }
+    if (total.lockHoldNs > 0 && inputSeconds > 0) {
+        // 锁持有时间包含XFlush，占比高说明写入被X服务器阻塞，而不是生成端跟不上
+        std::cout << "连接互斥锁: 等待 " << std::setprecision(1) << total.lockWaitNs / 1e6 << " 毫秒，持有 "
+                  << total.lockHoldNs / 1e6 << " 毫秒（占运行时间 "
+                  << total.lockHoldNs / 1e7 / inputSeconds / static_cast<double>(snapshot.workers.size()) << "%）" << std::endl;
+    }
+#ifdef __linux__
+    if (!m_targets.empty() && WindowFinder::ignoredErrors() > 0) {
+        std::cout << "目标窗口: 忽略了 " << WindowFinder::ignoredErrors() << " 个BadWindow错误（目标窗口已关闭）" << std::endl;
+    }
+#endif
 }
 
 void KeyboardSimulator::start() {
-    if (m_running) {
+    if (m_control.current() != RunState::Stopped) {
         return;
     }
     
 #ifdef __linux__
-    if (!m_display) {
-        std::cerr << "错误: X11显示连接未初始化" << std::endl;
+    if (!m_display && m_outputBackend == OutputBackend::Native) {
+        std::cerr << "错误: 无法连接到X服务器"
+                  << (m_displayNames.empty() ? std::string() : " " + m_displayNames.front()) << std::endl;
         return;
     }
 #endif
     
-    m_running = true;
-    m_active = false;
-    m_paused = false;
-    m_shouldExit = false;
+    m_control.finishedWorkers = 0;
+    m_control.reset(RunState::Armed);
+    if (m_realtime.enabled) {
+        Realtime::checkPermissions(m_realtime);
+    }
 #ifdef _WIN32
     m_lastLeftMouseState = GetAsyncKeyState(VK_LBUTTON);
     m_lastRightMouseState = GetAsyncKeyState(VK_RBUTTON);
+    m_lastPauseKeyState = GetAsyncKeyState(VK_PAUSE);
+    
+    // 启动监听线程（鼠标和键盘）
+    m_monitorThread = std::thread(&KeyboardSimulator::inputMonitorThread, this);
 #elif __linux__
     m_lastLeftMouseState = isMouseLeftButtonClicked();
     m_lastRightMouseState = isMouseRightButtonClicked();
-#endif
+    m_lastPauseKeyState = isPauseKeyPressed();
     
-    // 启动监听线程（鼠标和键盘）
-    m_monitorThread = std::thread(&KeyboardSimulator::inputMonitorThread, this);
+    // 监听连接、控制套接字和信号都注册到同一个事件循环，由调用waitForEvents()的线程分派，
+    // 没有事件时不唤醒任何线程
+    m_eventLoop.watchSignals({SIGINT, SIGTERM}, [this](int signal) {
+        onStopSignal(signal);
+    });
+    if (m_monitorDisplay && m_xiOpcode >= 0) {
+        m_escKeycode = XKeysymToKeycode(m_monitorDisplay, XK_Escape);
+        m_pauseKeycode = XKeysymToKeycode(m_monitorDisplay, XK_Pause);
+        m_eventLoop.watch(ConnectionNumber(m_monitorDisplay), EPOLLIN, [this](uint32_t events) {
+            processMonitorEvents(events);
+        });
+    } else if (m_monitorDisplay) {
+        // XInput2不可用时按10ms间隔轮询鼠标和键盘状态
+        m_pollTimerFd = m_eventLoop.addTimer(std::chrono::milliseconds(10), [this] {
+            pollInputState();
+        });
+    }
+    
+    // 控制命令在事件循环中执行，监听失败不影响输入本身
+    if (!m_controlPath.empty()) {
+        m_controlServer.start(m_eventLoop, m_controlPath, [this](const std::string& command) {
+            return handleControlCommand(command);
+        });
+    }
+#endif
     
-    std::cout << "键盘模拟器已启动，等待鼠标左键点击..." << std::endl;
+    if (m_autoStart) {
+        m_control.transition(RunState::Armed, RunState::Active);
+        startWorkers();
+        std::cout << "键盘模拟器已启动，使用 " << m_workers.front()->sink().name() << " 后端立即开始输入..." << std::endl;
+    } else {
+        std::cout << "键盘模拟器已启动，等待鼠标左键点击..." << std::endl;
+    }
 }
 
 void KeyboardSimulator::stop() {
-    if (!m_running) {
+    // 进入Exiting会唤醒所有等待中的工作线程（暂停中或长周期的等待），它们立即退出
+    if (!m_control.requestExit()) {
         return;
     }
-    
-    m_running = false;
-    m_active = false;
-    m_paused = false;
-    m_shouldExit = true;
+#ifdef __linux__
+    // 先从事件循环中移除控制套接字和监听连接，之后不会再有命令启动工作线程或读取统计
+    m_controlServer.stop();
+    if (m_monitorDisplay) {
+        m_eventLoop.unwatch(ConnectionNumber(m_monitorDisplay));
+    }
+    m_eventLoop.removeTimer(m_pollTimerFd);
+    m_pollTimerFd = -1;
+#endif
     
     // 等待所有线程退出
-    if (m_inputThread.joinable()) {
-        try {
-            m_inputThread.join();
-        } catch (...) {
-            // 忽略join异常
-        }
+    for (auto& worker : m_workers) {
+        worker->join();
     }
     
+    // 工作线程退出后停止指标输出，最后一次写入的是最终结果
+    m_metricsReporter.stop();
+    
+#ifdef _WIN32
     if (m_monitorThread.joinable()) {
         try {
             m_monitorThread.join();
@@ -132,255 +940,321 @@ void KeyboardSimulator::stop() {
             // 忽略join异常
         }
     }
-    
+#endif
+
 #ifdef __linux__
     // 在关闭Display之前，确保所有X11操作都已完成
     try {
-        // 先获取锁，确保没有其他线程在使用Display
-        {
-            std::lock_guard<std::mutex> lock(m_displayMutex);
-            if (m_display) {
-                XSync(m_display, False);  // 同步所有待处理的X11请求
+        // 工作线程都已退出；XSync返回时服务器已处理完所有请求，可以直接关闭
+        std::lock_guard<std::mutex> lock(m_displayMutex);
+        if (m_display) {
+            // 临时绑定了Unicode字符的键码恢复为空映射
+            bool remapped = false;
+            for (const auto& worker : m_workers) {
+                remapped = remapped || worker->sink().keycodeRemaps() > 0;
             }
-        }
-        
-        // 等待一小段时间，确保所有操作完成
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        
-        // 关闭Display（在确保所有线程都退出后）
-        {
-            std::lock_guard<std::mutex> lock(m_displayMutex);
-            if (m_display) {
-                XCloseDisplay(m_display);
-                m_display = nullptr;
+            if (remapped) {
+                KeycodePool::clear(m_display, m_spareKeycodes);
             }
+            XSync(m_display, False);  // 同步所有待处理的X11请求
+            XCloseDisplay(m_display);
+            m_display = nullptr;
         }
     } catch (...) {
         // 如果关闭Display时出错，至少确保指针被清空
         std::lock_guard<std::mutex> lock(m_displayMutex);
         m_display = nullptr;
     }
+    
+    // 监听连接只由事件循环使用，已取消注册，直接关闭
+    if (m_monitorDisplay) {
+        XCloseDisplay(m_monitorDisplay);
+        m_monitorDisplay = nullptr;
+    }
 #endif
     
+    printStatistics();
+    m_workers.clear();
+    m_control.reset(RunState::Stopped);
+    
     std::cout << "键盘模拟器已停止" << std::endl;
 }
 
 bool KeyboardSimulator::isRunning() const {
-    return m_running;
+    return m_control.current() != RunState::Stopped;
 }
 
 bool KeyboardSimulator::isActive() const {
-    return m_active;
+    return m_control.shouldContinue();
 }
 
 bool KeyboardSimulator::shouldExit() const {
-    return m_shouldExit;
+    return m_control.current() == RunState::Exiting;
 }
 
-void KeyboardSimulator::simulateKeyInput(char key) {
-#ifdef _WIN32
-    INPUT input[2] = {};
-    
-    // 按下键
-    input[0].type = INPUT_KEYBOARD;
-    input[0].ki.wVk = 0;
-    input[0].ki.wScan = key;
-    input[0].ki.dwFlags = KEYEVENTF_UNICODE;
-    input[0].ki.time = 0;
-    input[0].ki.dwExtraInfo = 0;
-    
-    // 释放键
-    input[1].type = INPUT_KEYBOARD;
-    input[1].ki.wVk = 0;
-    input[1].ki.wScan = key;
-    input[1].ki.dwFlags = KEYEVENTF_UNICODE | KEYEVENTF_KEYUP;
-    input[1].ki.time = 0;
-    input[1].ki.dwExtraInfo = 0;
-    
-    SendInput(2, input, sizeof(INPUT));
-#elif __linux__
-    try {
-        std::lock_guard<std::mutex> lock(m_displayMutex);
-        if (!m_display) {
-            return;
-        }
-        
-        // 对于Linux，使用XTestFakeKeyEvent来模拟按键
-        // 首先尝试将字符转换为KeySym
-        KeySym keysym = NoSymbol;
-        
-        // 对于可打印ASCII字符（32-126），直接使用字符值作为KeySym
-        if (key >= 32 && key <= 126) {
-            keysym = static_cast<KeySym>(key);
-        } else {
-            // 对于特殊字符，尝试查找对应的KeySym
-            // 注意：XStringToKeysym需要字符串名称，对于单个字符可能不适用
-            // 所以对于特殊字符，我们直接使用字符值
-            keysym = static_cast<KeySym>(key);
-        }
-        
-        // 获取键码
-        KeyCode keycode = XKeysymToKeycode(m_display, keysym);
-        
-        if (keycode != 0) {
-            // 按下键
-            XTestFakeKeyEvent(m_display, keycode, True, 0);
-            XFlush(m_display);
-            
-            // 释放键
-            XTestFakeKeyEvent(m_display, keycode, False, 0);
-            XFlush(m_display);
-        }
-    } catch (...) {
-        // 忽略X11操作中的异常，避免程序崩溃
+bool KeyboardSimulator::isFinished() const {
+    return (m_rateProfile || m_replayTrace || m_scenario) && m_control.finishedWorkers >= effectiveWorkerCount();
+}
+
+MetricsSnapshot KeyboardSimulator::metrics() {
+    // 计数器都是relaxed原子变量，只需保证工作线程列表不在创建中
+    std::lock_guard<std::mutex> lock(m_workersMutex);
+    return collectMetrics(DeadlineScheduler::Clock::now());
+}
+
+bool KeyboardSimulator::resume() {
+    if (m_control.transition(RunState::Armed, RunState::Active)) {
+        // 首次激活，启动输入工作线程
+        startWorkers();
+        return true;
     }
-#endif
+    // 暂停中的工作线程阻塞在条件变量上，状态切换时立即醒来
+    return m_control.transition(RunState::Paused, RunState::Active);
+}
+
+bool KeyboardSimulator::pause() {
+    return m_control.transition(RunState::Active, RunState::Paused);
 }
 
-void KeyboardSimulator::simulateStringInput(const std::string& text) {
-    for (char c : text) {
-        simulateKeyInput(c);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10)); // 字符间小延迟
+void KeyboardSimulator::onLeftClick() {
+    // 注入鼠标事件时生成的点击也会被监听到，鼠标不再控制输入
+    if (m_pointerStorm) {
+        return;
+    }
+    bool starting = m_control.current() == RunState::Armed;
+    if (resume()) {
+        std::cout << "检测到鼠标左键点击，" << (starting ? "开始" : "恢复") << "输入..." << std::endl;
     }
 }
 
-void KeyboardSimulator::inputMonitorThread() {
-    while (m_running && !m_shouldExit) {
-        // 检查ESC键
-        if (isEscKeyPressed()) {
-            m_shouldExit = true;
-            m_running = false;
-            std::cout << "\n检测到ESC键，退出程序..." << std::endl;
-            break;
+void KeyboardSimulator::onRightClick() {
+    if (m_pointerStorm) {
+        return;
+    }
+    if (pause()) {
+        std::cout << "检测到鼠标右键点击，暂停输入..." << std::endl;
+    }
+}
+
+void KeyboardSimulator::onPauseKey() {
+    RunState state = m_control.current();
+    if (state == RunState::Active) {
+        if (pause()) {
+            std::cout << "检测到Pause键，暂停输入..." << std::endl;
         }
-        
-        // 检查鼠标左键
-#ifdef _WIN32
-        DWORD currentLeftMouseState = GetAsyncKeyState(VK_LBUTTON);
-        bool leftWasPressed = (m_lastLeftMouseState & 0x8000) != 0;
-        bool leftIsPressed = (currentLeftMouseState & 0x8000) != 0;
-#elif __linux__
-        bool currentLeftMouseState = isMouseLeftButtonClicked();
-        bool leftWasPressed = m_lastLeftMouseState;
-        bool leftIsPressed = currentLeftMouseState;
+    } else if (resume()) {
+        std::cout << "检测到Pause键，" << (state == RunState::Armed ? "开始" : "恢复") << "输入..." << std::endl;
+    }
+}
+
+void KeyboardSimulator::onEscPressed() {
+    // 只进入Exiting，由主线程调用stop()等待工作线程并输出统计
+    m_control.requestExit();
+    std::cout << "\n检测到ESC键，退出程序..." << std::endl;
+}
+
+void KeyboardSimulator::onStopSignal(int signal) {
+    m_control.requestExit();
+    std::cout << "\n收到信号 " << signal << "，退出程序..." << std::endl;
+}
+
+void KeyboardSimulator::wakeEventLoop() {
+#ifdef __linux__
+    m_eventLoop.wake();
 #endif
-        
-        // 如果鼠标左键刚被点击（从按下到释放）
-        if (leftWasPressed && !leftIsPressed) {
-            if (!m_active) {
-                // 首次激活
-                m_active = true;
-                m_paused = false;
-                std::cout << "检测到鼠标左键点击，开始输入..." << std::endl;
-                
-                // 启动输入线程
-                if (!m_inputThread.joinable()) {
-                    m_inputThread = std::thread(&KeyboardSimulator::inputThread, this);
-                }
-            } else if (m_paused) {
-                // 恢复输入
-                m_paused = false;
-                std::cout << "检测到鼠标左键点击，恢复输入..." << std::endl;
+}
+
+void KeyboardSimulator::waitForEvents(std::chrono::milliseconds timeout) {
+#ifdef __linux__
+    m_eventLoop.runOnce(timeout);
+#else
+    // Windows上监听由独立线程轮询，这里只是限时睡眠
+    const std::chrono::milliseconds maxSleep(100);
+    std::this_thread::sleep_for(timeout.count() < 0 || timeout > maxSleep ? maxSleep : timeout);
+#endif
+}
+
+#ifdef __linux__
+bool KeyboardSimulator::isMappingEvent(XEvent& event) {
+    // 输出后端临时绑定Unicode字符只修改保留的空闲键码，这类变化不影响按键计划，不重新编译
+    auto onlyReserved = [this](int firstKey, int keyCount) {
+        if (keyCount <= 0) {
+            return false;
+        }
+        for (int keycode = firstKey; keycode < firstKey + keyCount; keycode++) {
+            if (keycode > 255 || !m_keyMap.isReserved(static_cast<uint8_t>(keycode))) {
+                return false;
             }
         }
-        
-        // 检查鼠标右键
-#ifdef _WIN32
-        DWORD currentRightMouseState = GetAsyncKeyState(VK_RBUTTON);
-        bool rightWasPressed = (m_lastRightMouseState & 0x8000) != 0;
-        bool rightIsPressed = (currentRightMouseState & 0x8000) != 0;
-#elif __linux__
-        bool currentRightMouseState = isMouseRightButtonClicked();
-        bool rightWasPressed = m_lastRightMouseState;
-        bool rightIsPressed = currentRightMouseState;
-#endif
-        
-        // 如果鼠标右键刚被点击（从按下到释放）
-        if (rightWasPressed && !rightIsPressed && m_active && !m_paused) {
-            m_paused = true;
-            std::cout << "检测到鼠标右键点击，暂停输入..." << std::endl;
+        return true;
+    };
+    
+    // MappingNotify会发送给所有客户端，XKB通知需要订阅
+    if (event.type == MappingNotify) {
+        XRefreshKeyboardMapping(&event.xmapping);
+        return !(event.xmapping.request == MappingKeyboard &&
+                 onlyReserved(event.xmapping.first_keycode, event.xmapping.count));
+    }
+    if (m_xkbEventBase >= 0 && event.type == m_xkbEventBase) {
+        const XkbEvent* xkbEvent = reinterpret_cast<const XkbEvent*>(&event);
+        if (xkbEvent->any.xkb_type == XkbMapNotify) {
+            // 服务器修改KeySym时可能一并更新这些键的动作和行为，只要所有变化的范围都在保留键码内即可忽略
+            const XkbMapNotifyEvent& map = xkbEvent->map;
+            const unsigned int keyComponents = XkbKeySymsMask | XkbKeyActionsMask | XkbKeyBehaviorsMask |
+                                               XkbExplicitComponentsMask | XkbVirtualModMapMask;
+            bool reserved = (map.changed & ~keyComponents) == 0 &&
+                            onlyReserved(map.first_key_sym, map.num_key_syms) &&
+                            (!(map.changed & XkbKeyActionsMask) || onlyReserved(map.first_key_act, map.num_key_acts)) &&
+                            (!(map.changed & XkbKeyBehaviorsMask) ||
+                             onlyReserved(map.first_key_behavior, map.num_key_behaviors)) &&
+                            (!(map.changed & XkbExplicitComponentsMask) ||
+                             onlyReserved(map.first_key_explicit, map.num_key_explicit)) &&
+                            (!(map.changed & XkbVirtualModMapMask) ||
+                             onlyReserved(map.first_vmodmap_key, map.num_vmodmap_keys));
+            return !reserved;
         }
-        
-        m_lastLeftMouseState = currentLeftMouseState;
-        m_lastRightMouseState = currentRightMouseState;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10)); // 10ms检查间隔
+        return xkbEvent->any.xkb_type == XkbNewKeyboardNotify;
     }
+    return false;
 }
 
-void KeyboardSimulator::inputThread() {
-    while (m_running && m_active && !m_shouldExit) {
-        // 如果暂停，等待恢复
-        if (m_paused) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-            continue;
-        }
-        
-        if (!m_inputTexts.empty() && m_inputDelayMs > 0) {
-            // 随机选择一个字符组
-            std::string inputText = getRandomInputText();
+void KeyboardSimulator::processMonitorEvents(uint32_t events) {
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        std::cerr << "错误: 与X服务器的监听连接已断开" << std::endl;
+        m_eventLoop.unwatch(ConnectionNumber(m_monitorDisplay));
+        onEscPressed();
+        return;
+    }
+    
+    // 处理Xlib已缓冲的全部事件；重新加载映射时的往返请求可能又读入新事件，
+    // 这些事件不会再让连接变为可读，需要在返回前一并处理
+    bool mappingChanged;
+    do {
+        mappingChanged = false;
+        while (XPending(m_monitorDisplay) > 0) {
+            XEvent event;
+            XNextEvent(m_monitorDisplay, &event);
             
-            if (!inputText.empty()) {
-                size_t textLength = inputText.length();
-                
-                // 计算每个字符之间的间隔时间（毫秒）
-                // 将整个输入周期平均分配给每个字符
-                // 例如：100ms周期，4个字符 -> 每个字符间隔25ms
-                int charInterval = m_inputDelayMs / static_cast<int>(textLength);
-                
-                // 如果字符数大于延迟时间，至少间隔1ms
-                if (charInterval < 1) {
-                    charInterval = 1;
-                }
-                
-                // 记录周期开始时间
-                auto cycleStart = std::chrono::steady_clock::now();
-                
-                // 输入每个字符，字符之间均匀分配时间
-                for (size_t i = 0; i < textLength; i++) {
-                    // 检查是否暂停或退出
-                    if (m_paused || !m_running || m_shouldExit) {
-                        break;
-                    }
-                    
-                    // 输入字符
-                    simulateKeyInput(inputText[i]);
-                    
-                    // 如果不是最后一个字符，等待间隔时间
-                    if (i < textLength - 1) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(charInterval));
+            XGenericEventCookie* cookie = &event.xcookie;
+            if (cookie->type == GenericEvent && cookie->extension == m_xiOpcode &&
+                XGetEventData(m_monitorDisplay, cookie)) {
+                const XIRawEvent* raw = static_cast<const XIRawEvent*>(cookie->data);
+                if (cookie->evtype == XI_RawKeyPress && raw->detail == m_escKeycode) {
+                    onEscPressed();
+                } else if (cookie->evtype == XI_RawKeyPress && raw->detail == m_pauseKeycode && m_pauseKeycode != 0) {
+                    onPauseKey();
+                } else if (cookie->evtype == XI_RawButtonRelease) {
+                    // 与轮询方式一致，在按键释放时触发
+                    if (raw->detail == Button1) {
+                        onLeftClick();
+                    } else if (raw->detail == Button3) {
+                        onRightClick();
                     }
                 }
-                
-                // 计算已用时间
-                auto cycleEnd = std::chrono::steady_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(cycleEnd - cycleStart).count();
-                
-                // 如果还有剩余时间，等待到周期结束
-                int remainingTime = m_inputDelayMs - static_cast<int>(elapsed);
-                if (remainingTime > 0) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(remainingTime));
-                }
-            }
-        } else if (m_inputTexts.empty()) {
-            // 如果没有输入内容，等待一小段时间
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        } else {
-            // 如果延迟为0，直接输入（随机选择一个字符组）
-            std::string inputText = getRandomInputText();
-            if (!inputText.empty()) {
-                simulateStringInput(inputText);
+                XFreeEventData(m_monitorDisplay, cookie);
+            } else if (isMappingEvent(event)) {
+                mappingChanged = true;
             }
         }
+        
+        if (mappingChanged) {
+            std::cout << "检测到键盘映射变化，重新编译按键计划..." << std::endl;
+            m_escKeycode = XKeysymToKeycode(m_monitorDisplay, XK_Escape);
+            m_pauseKeycode = XKeysymToKeycode(m_monitorDisplay, XK_Pause);
+            rebuildKeystrokePlan(true);
+        }
+    } while (mappingChanged && m_control.current() != RunState::Stopped);
+}
+#else
+void KeyboardSimulator::inputMonitorThread() {
+    // Windows没有可等待的输入事件，按10ms间隔轮询鼠标和键盘状态
+    while (m_control.current() != RunState::Exiting && m_control.current() != RunState::Stopped) {
+        pollInputState();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10)); // 10ms检查间隔
     }
 }
+#endif
+
+void KeyboardSimulator::pollInputState() {
+#ifdef __linux__
+    if (m_monitorDisplay) {
+        bool mappingChanged = false;
+        while (XPending(m_monitorDisplay) > 0) {
+            XEvent event;
+            XNextEvent(m_monitorDisplay, &event);
+            mappingChanged = isMappingEvent(event) || mappingChanged;
+        }
+        if (mappingChanged) {
+            std::cout << "检测到键盘映射变化，重新编译按键计划..." << std::endl;
+            rebuildKeystrokePlan(true);
+        }
+    }
+#endif
+    
+    // 检查ESC键
+    if (isEscKeyPressed()) {
+        onEscPressed();
+        return;
+    }
+    
+    // 检查鼠标左键
+#ifdef _WIN32
+    DWORD currentLeftMouseState = GetAsyncKeyState(VK_LBUTTON);
+    bool leftWasPressed = (m_lastLeftMouseState & 0x8000) != 0;
+    bool leftIsPressed = (currentLeftMouseState & 0x8000) != 0;
+#elif __linux__
+    bool currentLeftMouseState = isMouseLeftButtonClicked();
+    bool leftWasPressed = m_lastLeftMouseState;
+    bool leftIsPressed = currentLeftMouseState;
+#endif
+    
+    // 如果鼠标左键刚被点击（从按下到释放）
+    if (leftWasPressed && !leftIsPressed) {
+        onLeftClick();
+    }
+    
+    // 检查鼠标右键
+#ifdef _WIN32
+    DWORD currentRightMouseState = GetAsyncKeyState(VK_RBUTTON);
+    bool rightWasPressed = (m_lastRightMouseState & 0x8000) != 0;
+    bool rightIsPressed = (currentRightMouseState & 0x8000) != 0;
+#elif __linux__
+    bool currentRightMouseState = isMouseRightButtonClicked();
+    bool rightWasPressed = m_lastRightMouseState;
+    bool rightIsPressed = currentRightMouseState;
+#endif
+    
+    // 如果鼠标右键刚被点击（从按下到释放）
+    if (rightWasPressed && !rightIsPressed) {
+        onRightClick();
+    }
+    
+    // 检查Pause键（按下后释放时触发，与鼠标一致）
+#ifdef _WIN32
+    DWORD currentPauseKeyState = GetAsyncKeyState(VK_PAUSE);
+    bool pauseWasPressed = (m_lastPauseKeyState & 0x8000) != 0;
+    bool pauseIsPressed = (currentPauseKeyState & 0x8000) != 0;
+#elif __linux__
+    bool currentPauseKeyState = isPauseKeyPressed();
+    bool pauseWasPressed = m_lastPauseKeyState;
+    bool pauseIsPressed = currentPauseKeyState;
+#endif
+    if (pauseWasPressed && !pauseIsPressed) {
+        onPauseKey();
+    }
+    
+    m_lastLeftMouseState = currentLeftMouseState;
+    m_lastRightMouseState = currentRightMouseState;
+    m_lastPauseKeyState = currentPauseKeyState;
+}
 
 bool KeyboardSimulator::isMouseLeftButtonClicked() {
 #ifdef _WIN32
     return (GetAsyncKeyState(VK_LBUTTON) & 0x8000) != 0;
 #elif __linux__
     try {
-        std::lock_guard<std::mutex> lock(m_displayMutex);
-        if (!m_display) {
+        // 只在事件循环（及启动前）使用监听连接，不需要加锁
+        if (!m_monitorDisplay) {
             return false;
         }
         
@@ -388,7 +1262,7 @@ bool KeyboardSimulator::isMouseLeftButtonClicked() {
         int root_x, root_y, win_x, win_y;
         unsigned int mask;
         
-        if (XQueryPointer(m_display, DefaultRootWindow(m_display), 
+        if (XQueryPointer(m_monitorDisplay, DefaultRootWindow(m_monitorDisplay), 
                           &root, &child, &root_x, &root_y, 
                           &win_x, &win_y, &mask)) {
             return (mask & Button1Mask) != 0;
@@ -405,8 +1279,8 @@ bool KeyboardSimulator::isMouseRightButtonClicked() {
     return (GetAsyncKeyState(VK_RBUTTON) & 0x8000) != 0;
 #elif __linux__
     try {
-        std::lock_guard<std::mutex> lock(m_displayMutex);
-        if (!m_display) {
+        // 只在事件循环（及启动前）使用监听连接，不需要加锁
+        if (!m_monitorDisplay) {
             return false;
         }
         
@@ -414,7 +1288,7 @@ bool KeyboardSimulator::isMouseRightButtonClicked() {
         int root_x, root_y, win_x, win_y;
         unsigned int mask;
         
-        if (XQueryPointer(m_display, DefaultRootWindow(m_display), 
+        if (XQueryPointer(m_monitorDisplay, DefaultRootWindow(m_monitorDisplay), 
                           &root, &child, &root_x, &root_y, 
                           &win_x, &win_y, &mask)) {
             return (mask & Button3Mask) != 0;
@@ -431,18 +1305,43 @@ bool KeyboardSimulator::isEscKeyPressed() {
     return (GetAsyncKeyState(VK_ESCAPE) & 0x8000) != 0;
 #elif __linux__
     try {
-        std::lock_guard<std::mutex> lock(m_displayMutex);
-        if (!m_display) {
+        // 只在事件循环（及启动前）使用监听连接，不需要加锁
+        if (!m_monitorDisplay) {
+            return false;
+        }
+        
+        char keys[32];
+        KeyCode keycode = XKeysymToKeycode(m_monitorDisplay, XK_Escape);
+        if (keycode == 0) {
+            return false;
+        }
+        
+        XQueryKeymap(m_monitorDisplay, keys);
+        return (keys[keycode / 8] & (1 << (keycode % 8))) != 0;
+    } catch (...) {
+        // 忽略X11操作中的异常
+    }
+    return false;
+#endif
+}
+
+bool KeyboardSimulator::isPauseKeyPressed() {
+#ifdef _WIN32
+    return (GetAsyncKeyState(VK_PAUSE) & 0x8000) != 0;
+#elif __linux__
+    try {
+        // 只在事件循环（及启动前）使用监听连接，不需要加锁
+        if (!m_monitorDisplay) {
             return false;
         }
         
         char keys[32];
-        KeyCode keycode = XKeysymToKeycode(m_display, XK_Escape);
+        KeyCode keycode = XKeysymToKeycode(m_monitorDisplay, XK_Pause);
         if (keycode == 0) {
             return false;
         }
         
-        XQueryKeymap(m_display, keys);
+        XQueryKeymap(m_monitorDisplay, keys);
         return (keys[keycode / 8] & (1 << (keycode % 8))) != 0;
     } catch (...) {
         // 忽略X11操作中的异常
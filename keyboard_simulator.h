@@ -7,6 +7,22 @@
 #include <thread>
 #include <random>
 #include <mutex>
+#include <chrono>
+#include <memory>
+#include "deadline_scheduler.h"
+#include "keystroke_plan.h"
+#include "key_event_sink.h"
+#include "input_worker.h"
+#include "latency_probe.h"
+#include "metrics_reporter.h"
+#include "rate_profile.h"
+#include "hold_model.h"
+#include "pointer_storm.h"
+#include "typing_model.h"
+#include "scenario.h"
+#include "window_target.h"
+#include "control_server.h"
+#include "event_loop.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -23,24 +39,119 @@
  */
 class KeyboardSimulator {
 public:
+    // 按键输出后端
+    enum class OutputBackend {
+        Native,     // 平台原生注入（Linux: XTest，Windows: SendInput）
+        Null,       // 空后端：只计数，不注入
+        Memory      // 内存记录：带时间戳写入预分配的环形缓冲区
+    };
+    
     KeyboardSimulator();
+    
+    // 连接到指定的X显示器（如 :1、:2）：第一个显示器用于监听和编译按键计划，
+    // 指定多个显示器时每个显示器一个工作线程，有独立的X连接和调度器，各自执行完整的输入；
+    // 为空时使用DISPLAY环境变量（Windows上忽略）
+    explicit KeyboardSimulator(const std::vector<std::string>& displays);
     ~KeyboardSimulator();
-
-    // 设置要输入的内容（单个文本）
+    
+    // 设置要输入的内容（单个文本），文本会立即被编译为按键计划
     void setInputText(const std::string& text);
     
-    // 添加输入文本组（支持多个字符组）
+    // 添加输入文本组（支持多个字符组），文本会立即被编译为按键计划
     void addInputText(const std::string& text);
     
     // 清空所有输入文本组
     void clearInputTexts();
     
-    // 设置输入频率（每秒输入次数）
+    // 整体替换输入文本组（可在输入运行中调用），返回无法输入而跳过的字符数
+    size_t setInputTexts(const std::vector<std::string>& texts);
+    
+    // 设置语料库（启动前调用）：每个周期从语料库按权重抽取一个字符组，代替文本组
+    void setCorpus(std::shared_ptr<const TextCorpus> corpus);
+    
+    // 设置打字模型（启动前调用）：模型的每个符号编译为一个字符组，按模型逐字符输入，
+    // 返回无法输入而跳过的字符数
+    size_t setTypingModel(std::shared_ptr<const TypingModel> model);
+    
+    // 当前键盘映射的快照（从按键轨迹训练打字模型时还原字符）
+    std::shared_ptr<const KeyMap> keyMap() const;
+    
+    // 设置输入频率（每秒输入次数，支持小数和1000以上的频率）
     void setInputFrequency(double frequency);
     
     // 设置延迟时间（毫秒，每次输入之间的间隔）
     void setInputDelay(int delayMs);
     
+    // 设置自旋阈值（微秒，截止时间前最后一段改为忙等待，0表示不自旋）
+    void setSpinThreshold(int spinUs);
+    
+    // 设置错过周期时的处理策略
+    void setMissPolicy(DeadlineScheduler::MissPolicy policy);
+    
+    // 设置批量发送的事件数（每批只刷新一次，0表示整个周期为一批，默认1即每个字符一批）
+    void setBatchSize(size_t events);
+    
+    // 设置负载曲线（已compile），设置后忽略固定频率，曲线结束后工作线程退出；nullptr表示使用固定频率
+    void setRateProfile(std::shared_ptr<const RateProfile> profile);
+    
+    // 设置回放的按键轨迹（已打开，可已定位），speed为速度倍数；回放只使用一个工作线程，
+    // 轨迹结束后工作线程退出；nullptr表示不回放
+    void setReplayTrace(std::shared_ptr<TraceReader> trace, double speed);
+    
+    // 设置场景脚本，按当前键盘映射编译后代替随机输入字符组；场景只使用一个工作线程，
+    // 执行完后工作线程退出；nullptr表示不使用场景。编译失败时返回false
+    bool setScenario(std::shared_ptr<const Scenario> scenario);
+    
+    // 设置按住模式：每次按下一个键，按住从模型抽样的时长后释放，最多同时按住overlap个键，
+    // 按下的频率仍由频率或负载曲线决定；按住模式只使用一个工作线程（定向注入时每个目标一个）。
+    // seed为抽样的随机种子，nullptr表示普通输入
+    void setHoldModel(std::shared_ptr<const HoldModel> model, size_t overlap, uint32_t seed);
+    
+    // 设置与按键并行注入的鼠标事件，由第一个工作线程注入，与按键共用它的调度器；
+    // 设置后鼠标点击不再控制开始和暂停（生成的点击会被监听到），改用Pause键或控制套接字。nullptr表示不注入
+    void setPointerStorm(std::shared_ptr<const PointerStorm> storm);
+    
+#ifdef __linux__
+    // 设置定向注入的目标窗口：每个目标一个工作线程，有独立的X连接、调度器和频率，
+    // 原生后端改为通过XSendEvent直接发给目标窗口；设置后忽略工作线程数
+    void setTargets(const std::vector<TargetWindow>& targets);
+#endif
+    
+    // 设置实时运行选项（启动前调用）：工作线程使用SCHED_FIFO并绑定CPU，锁定内存，由timerfd唤醒
+    void setRealtime(const RealtimeOptions& options);
+    
+    // 设置工作线程数：每个工作线程有独立的X连接和调度器，总频率平均分配
+    void setWorkerCount(size_t workers);
+    
+    // 设置按键输出后端，ringCapacity为内存记录后端的环形缓冲区容量（事件数）
+    void setOutputBackend(OutputBackend backend, size_t ringCapacity = 0);
+    
+    // 设置是否在启动后立即开始输入（不等待鼠标左键点击）
+    void setAutoStart(bool autoStart);
+    
+#ifdef __linux__
+    // 设置运行时控制套接字（UNIX域套接字路径，空表示不开启），start()时开始监听
+    void setControlSocket(const std::string& path);
+#endif
+    
+    // 处理一条控制命令，返回一行回复（"ok ..."或"error ..."），可在输入运行中从任意线程调用
+    std::string handleControlCommand(const std::string& command);
+    
+    // 开始或恢复输入（与鼠标左键相同），返回false表示已在输入
+    bool resume();
+    
+    // 暂停输入（与鼠标右键相同），返回false表示未在输入或已暂停
+    bool pause();
+    
+    // 当前指标快照（可在输入运行中从任意线程调用，未开始输入时为空快照）
+    MetricsSnapshot metrics();
+    
+    // 设置指标输出：每隔intervalSec秒把指标写入path（.json为JSON，否则为Prometheus文本格式），空路径表示不输出
+    void setMetricsOutput(const std::string& path, double intervalSec);
+    
+    // 设置延迟探针：非空时每个工作线程的输出后端都会登记发送时间（由调用方持有）
+    void setLatencyProbe(LatencyProbe* probe);
+    
     // 开始监听鼠标点击并准备输入
     void start();
     
@@ -55,20 +166,75 @@ public:
     
     // 检查是否应该退出（ESC键）
     bool shouldExit() const;
+    
+    // 检查负载曲线、回放的轨迹或场景是否已全部执行完
+    bool isFinished() const;
+    
+    // 分派监听、控制套接字和信号事件，最多等待timeout（负数表示一直等到有事件）。
+    // Linux上这些事件都由调用线程的事件循环处理，调用方应在主循环中反复调用；
+    // 工作线程执行完时也会唤醒等待
+    void waitForEvents(std::chrono::milliseconds timeout);
 
 private:
-    // 模拟键盘输入
-    void simulateKeyInput(char key);
-    void simulateStringInput(const std::string& text);
+    // 发布新的输入周期（所有工作线程合计），运行中的工作线程在下一个截止时间生效
+    void setInputPeriod(std::chrono::nanoseconds period);
+    
+    // 当前输入周期
+    std::chrono::nanoseconds inputPeriod() const;
+    
+    // 为第workerIndex个工作线程创建输出后端
+    std::unique_ptr<KeyEventSink> createSink(size_t workerIndex);
+    
+    // 实际使用的工作线程数（定向注入时为目标数，驱动多个显示器时为显示器数，否则回放、执行场景和按住模式时为1）
+    size_t effectiveWorkerCount() const;
+    
+    // 各工作线程是否互不分摊频率、各自执行完整的输入（定向注入或驱动多个显示器）
+    bool independentWorkers() const;
+    
+    // 第workerIndex个工作线程的请求频率（次/秒）
+    double workerRate(size_t workerIndex) const;
     
-    // 鼠标和键盘监听线程
+    // 键盘自动重复的延迟和间隔（毫秒），取自系统设置，取不到时使用X服务器的默认值
+    void autoRepeatTiming(double& delayMs, double& intervalMs);
+    
+    // 创建并启动所有输入工作线程
+    void startWorkers();
+    
+    // 采集所有工作线程的指标快照，end为计算时长的截止时刻（可在输入运行中调用）
+    MetricsSnapshot collectMetrics(DeadlineScheduler::TimePoint end) const;
+    
+    // 输出所有工作线程合并后的统计信息
+    void printStatistics() const;
+    
+    // 按当前键盘映射重新编译所有字符组和场景
+    void rebuildKeystrokePlan(bool reloadKeyMap);
+    
+    // 按当前键盘映射编译场景并发布给工作线程（调用方需持有m_planMutex）
+    bool compileScenario();
+    
+#ifdef __linux__
+    // 判断是否为键盘映射变化事件（MappingNotify/XKB映射通知），是则刷新Xlib缓存
+    bool isMappingEvent(XEvent& event);
+    
+    // 监听连接可读时处理服务器推送的XInput2原始事件和映射变化
+    void processMonitorEvents(uint32_t events);
+#else
+    // 鼠标和键盘监听线程（按10ms间隔轮询）
     void inputMonitorThread();
+#endif
+    
+    // 轮询一次鼠标、ESC和映射变化（XInput2不可用时使用）
+    void pollInputState();
     
-    // 输入线程
-    void inputThread();
+    // 监听到的控制操作：左键开始/恢复，右键暂停，Pause键开始/暂停/恢复，ESC和SIGINT/SIGTERM退出
+    void onLeftClick();
+    void onRightClick();
+    void onPauseKey();
+    void onEscPressed();
+    void onStopSignal(int signal);
     
-    // 随机选择一个输入文本组
-    std::string getRandomInputText();
+    // 唤醒阻塞中的waitForEvents
+    void wakeEventLoop();
     
     // 检查鼠标左键是否被点击
     bool isMouseLeftButtonClicked();
@@ -78,26 +244,62 @@ private:
     
     // 检查ESC键是否被按下
     bool isEscKeyPressed();
+    
+    // 检查Pause键是否被按下
+    bool isPauseKeyPressed();
 
 private:
     std::vector<std::string> m_inputTexts;    // 输入文本组列表（支持多个字符组）
-    int m_inputDelayMs;                       // 输入延迟（毫秒）
-    std::atomic<bool> m_running;              // 是否正在运行
-    std::atomic<bool> m_active;               // 是否已激活（鼠标点击后）
-    std::atomic<bool> m_paused;               // 是否暂停（右键暂停）
-    std::atomic<bool> m_shouldExit;           // 是否应该退出（ESC键）
-    std::thread m_monitorThread;              // 鼠标和键盘监听线程
-    std::thread m_inputThread;                // 输入线程
+    KeyMap m_keyMap;                          // 键盘映射缓存
+    std::mutex m_planMutex;                   // 保护文本组列表和键盘映射缓存
+    InputControl m_control;                   // 运行状态、按键计划和输入配置（工作线程共享）
+    std::chrono::nanoseconds m_spinThreshold; // 自旋阈值
+    DeadlineScheduler::MissPolicy m_missPolicy;   // 错过周期的处理策略
+    size_t m_batchSize;                       // 每批事件数（0表示整个周期）
+    size_t m_workerCount;                     // 工作线程数
+    RealtimeOptions m_realtime;               // 实时运行选项
+    std::shared_ptr<const RateProfile> m_rateProfile; // 负载曲线（可为空）
+    std::shared_ptr<TraceReader> m_replayTrace;   // 回放的按键轨迹（可为空）
+    double m_replaySpeed;                     // 回放速度倍数
+    std::shared_ptr<const Scenario> m_scenario;   // 场景脚本（可为空）
+    std::shared_ptr<const HoldModel> m_holdModel; // 按住时长模型（为空时不启用按住模式）
+    size_t m_holdOverlap;                     // 按住模式下最多同时按住的键数
+    uint32_t m_holdSeed;                      // 按住时长抽样的随机种子
+    std::shared_ptr<const PointerStorm> m_pointerStorm;   // 鼠标事件风暴（可为空）
+    OutputBackend m_outputBackend;            // 当前输出后端类型
+    size_t m_ringCapacity;                    // 内存记录后端的环形缓冲区容量
+    bool m_autoStart;                         // 启动后是否立即开始输入
+    LatencyProbe* m_latencyProbe;             // 延迟探针（可为空）
+    std::string m_metricsPath;                // 指标输出文件（空表示不输出）
+    std::chrono::milliseconds m_metricsInterval;  // 指标输出间隔
+    MetricsReporter m_metricsReporter;        // 指标输出线程
+    DeadlineScheduler::TimePoint m_inputStartTime;    // 工作线程的公共起点
+    std::vector<std::unique_ptr<InputWorker>> m_workers;  // 输入工作线程
+    std::mutex m_workersMutex;                // 保护工作线程的创建（事件循环和主线程都可能启动或停止输入）
 #ifdef _WIN32
+    std::thread m_monitorThread;              // 鼠标和键盘监听线程
     DWORD m_lastLeftMouseState;               // 上次左键鼠标状态
     DWORD m_lastRightMouseState;              // 上次右键鼠标状态
+    DWORD m_lastPauseKeyState;                // 上次Pause键状态
 #elif __linux__
     bool m_lastLeftMouseState;                // 上次左键鼠标状态
     bool m_lastRightMouseState;                // 上次右键鼠标状态
-    Display* m_display;                        // X11显示连接
+    bool m_lastPauseKeyState;                  // 上次Pause键状态
+    Display* m_display;                        // X11显示连接（用于注入）
+    std::vector<std::string> m_displayNames;   // 驱动的X显示器（为空时使用DISPLAY环境变量）
+    std::vector<TargetWindow> m_targets;       // 定向注入的目标窗口（为空时注入到焦点窗口）
+    std::vector<uint8_t> m_spareKeycodes;      // 启动时没有任何KeySym的键码，按工作线程分给输出后端输入Unicode字符
     std::mutex m_displayMutex;                 // X11显示连接互斥锁（X11不是线程安全的）
+    Display* m_monitorDisplay;                 // 监听专用的X11显示连接（仅事件循环使用）
+    int m_xkbEventBase;                        // XKB扩展事件基值，-1表示不可用
+    int m_xiOpcode;                            // XInput2扩展操作码，-1表示不可用
+    KeyCode m_escKeycode;                      // 监听连接上ESC的键码
+    KeyCode m_pauseKeycode;                    // 监听连接上Pause的键码
+    EventLoop m_eventLoop;                     // 事件循环：监听连接、控制套接字、信号和轮询定时器
+    int m_pollTimerFd;                         // XInput2不可用时的轮询定时器（-1表示未使用）
+    std::string m_controlPath;                 // 控制套接字路径（空表示不开启）
+    ControlServer m_controlServer;             // 运行时控制套接字（注册在事件循环中）
 #endif
-    std::mt19937 m_randomGenerator;           // 随机数生成器
 };
 
 #endif // KEYBOARD_SIMULATOR_H
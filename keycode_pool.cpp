@@ -0,0 +1,129 @@
+#include "keycode_pool.h"
+
+#ifdef __linux__
+#include <X11/keysym.h>
+
+KeycodePool::KeycodePool()
+    : m_useCounter(0)
+    , m_remaps(0)
+{
+}
+
+void KeycodePool::assign(const std::vector<uint8_t>& keycodes) {
+    m_slots.clear();
+    m_bound.clear();
+    for (uint8_t keycode : keycodes) {
+        m_slots.push_back(Slot{keycode, 0, 0});
+    }
+    m_bound.reserve(m_slots.size());
+}
+
+bool KeycodePool::empty() const {
+    return m_slots.empty();
+}
+
+uint8_t KeycodePool::bind(Display* display, uint32_t codePoint) {
+    if (m_slots.empty()) {
+        return 0;
+    }
+    m_useCounter++;
+    auto it = m_bound.find(codePoint);
+    if (it != m_bound.end()) {
+        Slot& slot = m_slots[it->second];
+        slot.lastUsed = m_useCounter;
+        return slot.keycode;
+    }
+    
+    // 未绑定时淘汰最久未使用的键码；只有修改映射时才扫描，池很小，线性查找即可
+    size_t victim = 0;
+    for (size_t i = 1; i < m_slots.size(); i++) {
+        if (m_slots[i].lastUsed < m_slots[victim].lastUsed) {
+            victim = i;
+        }
+    }
+    Slot& slot = m_slots[victim];
+    if (slot.codePoint != 0) {
+        m_bound.erase(slot.codePoint);
+    }
+    
+    // 两列都设为同一个KeySym，避免客户端按大小写规则把它换成另一个字符
+    KeySym keysyms[2];
+    keysyms[0] = keysyms[1] = codePointToKeysym(codePoint);
+    XChangeKeyboardMapping(display, slot.keycode, 2, keysyms, 1);
+    slot.codePoint = codePoint;
+    slot.lastUsed = m_useCounter;
+    m_bound[codePoint] = victim;
+    m_remaps++;
+    return slot.keycode;
+}
+
+uint64_t KeycodePool::remaps() const {
+    return m_remaps;
+}
+
+std::vector<uint8_t> KeycodePool::findSpareKeycodes(Display* display) {
+    std::vector<uint8_t> spare;
+    int minKeycode = 0;
+    int maxKeycode = 0;
+    XDisplayKeycodes(display, &minKeycode, &maxKeycode);
+    if (maxKeycode > 255) {
+        maxKeycode = 255;
+    }
+    if (maxKeycode < minKeycode) {
+        return spare;
+    }
+    
+    int keysymsPerKeycode = 0;
+    KeySym* keysyms = XGetKeyboardMapping(display, static_cast<KeyCode>(minKeycode),
+                                          maxKeycode - minKeycode + 1, &keysymsPerKeycode);
+    if (!keysyms) {
+        return spare;
+    }
+    for (int keycode = minKeycode; keycode <= maxKeycode; keycode++) {
+        const KeySym* row = keysyms + (keycode - minKeycode) * keysymsPerKeycode;
+        bool unused = true;
+        for (int i = 0; i < keysymsPerKeycode && unused; i++) {
+            unused = (row[i] == NoSymbol);
+        }
+        if (unused) {
+            spare.push_back(static_cast<uint8_t>(keycode));
+        }
+    }
+    XFree(keysyms);
+    return spare;
+}
+
+std::vector<uint8_t> KeycodePool::partition(const std::vector<uint8_t>& keycodes, size_t index, size_t count) {
+    if (count == 0 || index >= count) {
+        return std::vector<uint8_t>();
+    }
+    size_t begin = keycodes.size() * index / count;
+    size_t end = keycodes.size() * (index + 1) / count;
+    return std::vector<uint8_t>(keycodes.begin() + begin, keycodes.begin() + end);
+}
+
+void KeycodePool::clear(Display* display, const std::vector<uint8_t>& keycodes) {
+    KeySym none[2] = {NoSymbol, NoSymbol};
+    for (uint8_t keycode : keycodes) {
+        XChangeKeyboardMapping(display, keycode, 2, none, 1);
+    }
+}
+
+KeySym KeycodePool::codePointToKeysym(uint32_t codePoint) {
+    // Latin-1的可打印字符KeySym与码位相同
+    if ((codePoint >= 0x20 && codePoint <= 0x7e) || (codePoint >= 0xa0 && codePoint <= 0xff)) {
+        return static_cast<KeySym>(codePoint);
+    }
+    return static_cast<KeySym>(0x01000000 | codePoint);
+}
+
+uint32_t KeycodePool::keysymToCodePoint(KeySym keysym) {
+    if ((keysym >= 0x20 && keysym <= 0x7e) || (keysym >= 0xa0 && keysym <= 0xff)) {
+        return static_cast<uint32_t>(keysym);
+    }
+    if ((keysym & 0xff000000) == 0x01000000) {
+        return static_cast<uint32_t>(keysym & 0x00ffffff);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,64 @@
+#ifndef KEYCODE_POOL_H
+#define KEYCODE_POOL_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef __linux__
+#include <X11/Xlib.h>
+
+/**
+ * 空闲键码池
+ * 当前映射中找不到的字符（中日韩文字、emoji、带重音的字母等）临时绑定到没有任何KeySym的空闲键码上输入：
+ * 用XChangeKeyboardMapping把键码改为该字符的Unicode KeySym，再按下并释放这个键码。
+ * 绑定按最近最少使用淘汰，重复出现的字符直接复用已有的绑定，不再修改映射。
+ * 映射修改对整个X服务器生效，每个输出后端使用互不重叠的一部分键码，不会改写其他后端正在使用的键码
+ */
+class KeycodePool {
+public:
+    KeycodePool();
+    
+    // 使用指定的键码（清除已有的绑定记录，不修改映射）
+    void assign(const std::vector<uint8_t>& keycodes);
+    
+    bool empty() const;
+    
+    // 返回绑定到码位的键码，没有绑定时淘汰最久未使用的键码并在display上排队映射修改请求，
+    // 随后在同一连接上发送的按键事件会在修改之后处理；池为空时返回0
+    uint8_t bind(Display* display, uint32_t codePoint);
+    
+    // 修改映射的次数
+    uint64_t remaps() const;
+    
+    // 当前映射中没有任何KeySym的键码
+    static std::vector<uint8_t> findSpareKeycodes(Display* display);
+    
+    // 把keycodes平均分成count份，返回第index份
+    static std::vector<uint8_t> partition(const std::vector<uint8_t>& keycodes, size_t index, size_t count);
+    
+    // 把keycodes恢复为空映射（停止时调用，之后需要XSync或XFlush）
+    static void clear(Display* display, const std::vector<uint8_t>& keycodes);
+    
+    // 码位对应的KeySym：Latin-1字符与码位相同，其他字符为Unicode KeySym（0x1000000 + 码位）
+    static KeySym codePointToKeysym(uint32_t codePoint);
+    
+    // codePointToKeysym的逆映射：Latin-1和Unicode KeySym对应的码位，其他KeySym返回0
+    static uint32_t keysymToCodePoint(KeySym keysym);
+
+private:
+    struct Slot {
+        uint8_t keycode;        // 键码
+        uint32_t codePoint;     // 绑定的码位（0表示未绑定）
+        uint64_t lastUsed;      // 最近一次使用的序号
+    };
+    
+    std::vector<Slot> m_slots;                      // 所有键码
+    std::unordered_map<uint32_t, size_t> m_bound;   // 码位 -> 槽位
+    uint64_t m_useCounter;                          // 使用序号
+    uint64_t m_remaps;                              // 修改映射的次数
+};
+#endif
+
+#endif // KEYCODE_POOL_H
@@ -0,0 +1,365 @@
+#include "keystroke_plan.h"
+
+#ifdef __linux__
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include "keycode_pool.h"
+#endif
+
+KeyMap::KeyMap()
+    : m_loaded(false)
+{
+    m_latin1.fill(Binding{0, 0});
+    m_modifierKeycodes.fill(0);
+    m_reserved.fill(false);
+}
+
+bool KeyMap::isLoaded() const {
+    return m_loaded;
+}
+
+#ifdef __linux__
+bool KeyMap::load(Display* display) {
+    m_loaded = false;
+    m_latin1.fill(Binding{0, 0});
+    m_others.clear();
+    m_modifierKeycodes.fill(0);
+    
+    if (!display) {
+        return false;
+    }
+    
+    XkbDescPtr xkb = XkbGetMap(display, XkbKeyTypesMask | XkbKeySymsMask, XkbUseCoreKbd);
+    if (!xkb) {
+        return false;
+    }
+    
+    // 按当前锁定的布局组解析，按键不包含该组时退回第一组
+    XkbStateRec state;
+    int currentGroup = 0;
+    if (XkbGetState(display, XkbUseCoreKbd, &state) == Success) {
+        currentGroup = state.group;
+    }
+    
+    for (int keycode = xkb->min_key_code; keycode <= xkb->max_key_code; keycode++) {
+        int groups = XkbKeyNumGroups(xkb, keycode);
+        if (groups == 0 || keycode > 255 || m_reserved[keycode]) {
+            continue;
+        }
+        int group = currentGroup < groups ? currentGroup : 0;
+        XkbKeyTypePtr type = XkbKeyKeyType(xkb, keycode, group);
+        
+        for (int level = 0; level < type->num_levels; level++) {
+            KeySym keysym = XkbKeySymEntry(xkb, keycode, level, group);
+            if (keysym == NoSymbol) {
+                continue;
+            }
+            
+            // 查找产生该层级所需的修饰键，第0层不需要修饰键；
+            // CapsLock是锁定键，按下会改变状态，不使用需要它的组合
+            bool reachable = (level == 0);
+            uint16_t modifiers = 0;
+            for (int i = 0; i < type->map_count && level != 0; i++) {
+                const XkbKTMapEntryRec& entry = type->map[i];
+                if (!entry.active || entry.level != level || (entry.mods.mask & LockMask)) {
+                    continue;
+                }
+                uint16_t mask = static_cast<uint16_t>(entry.mods.mask);
+                if (!reachable || __builtin_popcount(mask) < __builtin_popcount(modifiers)) {
+                    modifiers = mask;
+                    reachable = true;
+                }
+            }
+            if (reachable) {
+                insert(keysym, static_cast<uint8_t>(keycode), modifiers);
+            }
+        }
+    }
+    XkbFreeKeyboard(xkb, 0, True);
+    
+    // 记录每个修饰键对应的第一个键码
+    XModifierKeymap* modmap = XGetModifierMapping(display);
+    if (modmap) {
+        for (int mod = 0; mod < 8; mod++) {
+            for (int i = 0; i < modmap->max_keypermod; i++) {
+                KeyCode keycode = modmap->modifiermap[mod * modmap->max_keypermod + i];
+                if (keycode != 0) {
+                    m_modifierKeycodes[mod] = keycode;
+                    break;
+                }
+            }
+        }
+        XFreeModifiermap(modmap);
+    }
+    
+    m_loaded = true;
+    return true;
+}
+
+void KeyMap::setReservedKeycodes(const std::vector<uint8_t>& keycodes) {
+    m_reserved.fill(false);
+    for (uint8_t keycode : keycodes) {
+        m_reserved[keycode] = true;
+    }
+}
+
+bool KeyMap::isReserved(uint8_t keycode) const {
+    return m_reserved[keycode];
+}
+
+void KeyMap::loadFallback() {
+    m_latin1.fill(Binding{0, 0});
+    m_others.clear();
+    m_modifierKeycodes.fill(0);
+    
+    for (unsigned int c = 32; c <= 126; c++) {
+        m_latin1[c] = Binding{static_cast<uint8_t>(c), 0};
+    }
+    m_others[XK_Return] = Binding{13, 0};
+    m_others[XK_Tab] = Binding{9, 0};
+    m_others[XK_BackSpace] = Binding{8, 0};
+    m_loaded = true;
+}
+
+void KeyMap::insert(KeySym keysym, uint8_t keycode, uint16_t modifiers) {
+    Binding* existing = nullptr;
+    if (keysym < m_latin1.size()) {
+        existing = &m_latin1[keysym];
+    } else {
+        auto it = m_others.find(keysym);
+        if (it == m_others.end()) {
+            m_others[keysym] = Binding{keycode, modifiers};
+            return;
+        }
+        existing = &it->second;
+    }
+    
+    // 同一个KeySym出现在多个按键上时，优先选择需要修饰键最少的按键
+    if (existing->keycode == 0 ||
+        __builtin_popcount(modifiers) < __builtin_popcount(existing->modifiers)) {
+        *existing = Binding{keycode, modifiers};
+    }
+}
+
+bool KeyMap::lookup(KeySym keysym, Binding& binding) const {
+    if (keysym < m_latin1.size()) {
+        binding = m_latin1[keysym];
+        return binding.keycode != 0;
+    }
+    auto it = m_others.find(keysym);
+    if (it == m_others.end()) {
+        return false;
+    }
+    binding = it->second;
+    return true;
+}
+
+uint8_t KeyMap::modifierKeycode(int modIndex) const {
+    if (modIndex < 0 || modIndex >= static_cast<int>(m_modifierKeycodes.size())) {
+        return 0;
+    }
+    return m_modifierKeycodes[modIndex];
+}
+
+std::vector<std::pair<KeySym, KeyMap::Binding>> KeyMap::bindings() const {
+    std::vector<std::pair<KeySym, Binding>> result;
+    for (size_t keysym = 0; keysym < m_latin1.size(); keysym++) {
+        if (m_latin1[keysym].keycode != 0) {
+            result.emplace_back(static_cast<KeySym>(keysym), m_latin1[keysym]);
+        }
+    }
+    for (const auto& entry : m_others) {
+        result.emplace_back(entry.first, entry.second);
+    }
+    return result;
+}
+
+bool KeystrokePlan::hasModifierKeys(const KeyMap::Binding& binding, const KeyMap& keymap) {
+    for (int mod = 0; mod < 8; mod++) {
+        if ((binding.modifiers & (1u << mod)) && keymap.modifierKeycode(mod) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+KeySym KeystrokePlan::codePointToKeysym(uint32_t codePoint) {
+    switch (codePoint) {
+        case '\n':
+        case '\r':
+            return XK_Return;
+        case '\t':
+            return XK_Tab;
+        case '\b':
+            return XK_BackSpace;
+        default:
+            break;
+    }
+    // 其他控制字符（C0、DEL、C1）无法输入
+    if (codePoint < 0x20 || (codePoint >= 0x7F && codePoint <= 0x9F) || codePoint == InvalidCodePoint) {
+        return NoSymbol;
+    }
+    return KeycodePool::codePointToKeysym(codePoint);
+}
+
+uint32_t KeystrokePlan::keysymToCodePoint(KeySym keysym) {
+    switch (keysym) {
+        case XK_Return:
+            return '\n';
+        case XK_Tab:
+            return '\t';
+        case XK_BackSpace:
+            return '\b';
+        default:
+            break;
+    }
+    return KeycodePool::keysymToCodePoint(keysym);
+}
+#endif
+
+uint32_t KeystrokePlan::decodeUtf8(std::string_view text, size_t& pos) {
+    unsigned char lead = static_cast<unsigned char>(text[pos++]);
+    if (lead < 0x80) {
+        return lead;
+    }
+    size_t length;
+    uint32_t codePoint;
+    uint32_t minimum;
+    if ((lead & 0xE0) == 0xC0) {
+        length = 1;
+        codePoint = lead & 0x1F;
+        minimum = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 2;
+        codePoint = lead & 0x0F;
+        minimum = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 3;
+        codePoint = lead & 0x07;
+        minimum = 0x10000;
+    } else {
+        return InvalidCodePoint;
+    }
+    
+    // 后续字节不完整时只跳过首字节，下一个字符从第一个不合法的字节重新开始
+    if (pos + length > text.size()) {
+        return InvalidCodePoint;
+    }
+    for (size_t i = 0; i < length; i++) {
+        unsigned char next = static_cast<unsigned char>(text[pos + i]);
+        if ((next & 0xC0) != 0x80) {
+            return InvalidCodePoint;
+        }
+        codePoint = (codePoint << 6) | (next & 0x3F);
+    }
+    // 拒绝过长编码、代理项和超出Unicode范围的码位
+    if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+        return InvalidCodePoint;
+    }
+    pos += length;
+    return codePoint;
+}
+
+size_t KeystrokePlan::addGroup(std::string_view text, const KeyMap& keymap) {
+    Group group;
+    group.firstEvent = static_cast<uint32_t>(m_events.size());
+    group.eventCount = 0;
+    group.charCount = 0;
+    size_t skipped = 0;
+    
+#ifdef _WIN32
+    (void)keymap;
+    
+    // Windows使用KEYEVENTF_UNICODE输入，按UTF-16码元编译
+    int length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    std::wstring wide(length > 0 ? length : 0, L'\0');
+    if (length > 0) {
+        MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), &wide[0], length);
+    }
+    for (wchar_t unit : wide) {
+        uint16_t code = static_cast<uint16_t>(unit);
+        m_events.push_back(KeyEvent{code, 0, KeyEvent::Press});
+        m_events.push_back(KeyEvent{code, 0, KeyEvent::CharEnd});
+        group.charCount++;
+    }
+#elif __linux__
+    size_t pos = 0;
+    while (pos < text.size()) {
+        uint32_t codePoint = decodeUtf8(text, pos);
+        KeySym keysym = codePointToKeysym(codePoint);
+        if (keysym == NoSymbol) {
+            skipped++;
+            continue;
+        }
+        KeyMap::Binding binding;
+        if (!keymap.lookup(keysym, binding) || !hasModifierKeys(binding, keymap)) {
+            if (codePoint < 0x20) {
+                skipped++;
+                continue;
+            }
+            // 映射中没有的字符由输出后端临时绑定一个空闲键码输入，不需要修饰键
+            uint16_t low = static_cast<uint16_t>(codePoint & 0xFFFF);
+            uint16_t high = static_cast<uint16_t>(codePoint >> 16);
+            m_events.push_back(KeyEvent{low, high, static_cast<uint8_t>(KeyEvent::Press | KeyEvent::Unicode)});
+            m_events.push_back(KeyEvent{low, high, static_cast<uint8_t>(KeyEvent::Unicode | KeyEvent::CharEnd)});
+            group.charCount++;
+            continue;
+        }
+        
+        // 先按下所需的修饰键，再按下并释放目标键，最后逆序释放修饰键
+        uint16_t held = 0;
+        for (int mod = 0; mod < 8; mod++) {
+            uint16_t bit = static_cast<uint16_t>(1u << mod);
+            uint8_t modKeycode = keymap.modifierKeycode(mod);
+            if (binding.modifiers & bit) {
+                held |= bit;
+                m_events.push_back(KeyEvent{modKeycode, held, KeyEvent::Press});
+            }
+        }
+        m_events.push_back(KeyEvent{binding.keycode, held, KeyEvent::Press});
+        m_events.push_back(KeyEvent{binding.keycode, held, 0});
+        for (int mod = 7; mod >= 0; mod--) {
+            uint16_t bit = static_cast<uint16_t>(1u << mod);
+            if (held & bit) {
+                held &= static_cast<uint16_t>(~bit);
+                m_events.push_back(KeyEvent{keymap.modifierKeycode(mod), held, 0});
+            }
+        }
+        m_events.back().flags |= KeyEvent::CharEnd;
+        group.charCount++;
+    }
+#endif
+    
+    group.eventCount = static_cast<uint32_t>(m_events.size()) - group.firstEvent;
+    m_groups.push_back(group);
+    return skipped;
+}
+
+void KeystrokePlan::clear() {
+    m_events.clear();
+    m_groups.clear();
+}
+
+size_t KeystrokePlan::groupCount() const {
+    return m_groups.size();
+}
+
+const KeystrokePlan::Group& KeystrokePlan::group(size_t index) const {
+    return m_groups[index];
+}
+
+const KeyEvent* KeystrokePlan::events() const {
+    return m_events.data();
+}
+
+bool KeystrokePlan::empty() const {
+    return m_groups.empty();
+}
+
+size_t KeystrokePlan::charEventCount(const KeyEvent* event, const KeyEvent* end) {
+    const KeyEvent* charEnd = event;
+    while (charEnd < end && !charEnd->isCharEnd()) {
+        charEnd++;
+    }
+    return static_cast<size_t>(charEnd - event) + (charEnd < end ? 1 : 0);
+}
@@ -0,0 +1,158 @@
+#ifndef KEYSTROKE_PLAN_H
+#define KEYSTROKE_PLAN_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif __linux__
+#include <X11/Xlib.h>
+#endif
+
+/**
+ * 单个按键事件
+ * Linux下code为X11键码，Windows下code为UTF-16码元（KEYEVENTF_UNICODE）。
+ * Linux下当前映射中没有的字符带Unicode标志，code和modifiers合起来是码位（低16位和高16位），
+ * 由输出后端在发送时临时绑定一个空闲键码
+ */
+struct KeyEvent {
+    enum Flags : uint8_t {
+        Press = 0x01,       // 按下（否则为释放）
+        CharEnd = 0x02,     // 一个字符的最后一个事件
+        Unicode = 0x04,     // code/modifiers为Unicode码位，而不是键码和修饰键
+        Pointer = 0x08      // 鼠标事件：code为按钮编号（0表示相对移动），移动的位移在modifiers中
+    };
+    
+    uint16_t code;          // 键码或UTF-16码元
+    uint16_t modifiers;     // 该事件生效时的修饰键掩码（ShiftMask等）
+    uint8_t flags;          // 事件标志
+    
+    bool isPress() const { return (flags & Press) != 0; }
+    bool isCharEnd() const { return (flags & CharEnd) != 0; }
+    bool isUnicode() const { return (flags & Unicode) != 0; }
+    uint32_t codePoint() const { return static_cast<uint32_t>(code) | (static_cast<uint32_t>(modifiers) << 16); }
+    bool isPointer() const { return (flags & Pointer) != 0; }
+    int pointerDx() const { return static_cast<int8_t>(modifiers & 0xFF); }
+    int pointerDy() const { return static_cast<int8_t>(modifiers >> 8); }
+};
+
+/**
+ * 带延迟的按键事件（批量发送时使用）
+ * delayMs为相对上一个事件的延迟，由XTest在服务器端计时
+ */
+struct TimedKeyEvent {
+    KeyEvent event;
+    uint32_t delayMs;
+};
+
+/**
+ * 键盘映射缓存
+ * 将KeySym解析为（键码，修饰键掩码），并记录每个修饰键对应的键码，
+ * 解析结果来自当前XKB映射，映射变化（MappingNotify）后需要重新加载
+ */
+class KeyMap {
+public:
+    struct Binding {
+        uint8_t keycode;        // 键码，0表示无法输入
+        uint16_t modifiers;     // 需要同时按下的修饰键掩码
+    };
+    
+    KeyMap();
+    
+#ifdef __linux__
+    // 从X服务器加载当前键盘映射（调用方需持有该Display的锁），保留的键码不参与解析
+    bool load(Display* display);
+    
+    // 保留键码：这些键码由输出后端临时绑定Unicode字符，重新加载映射时跳过（设置后一直有效）
+    void setReservedKeycodes(const std::vector<uint8_t>& keycodes);
+    bool isReserved(uint8_t keycode) const;
+    
+    // 没有X服务器时使用的合成映射：可打印ASCII字符直接以字符值作为键码，
+    // 仅用于空后端/内存后端测量按键计划和调度本身的开销
+    void loadFallback();
+    
+    // 查找KeySym对应的按键，找不到时返回false
+    bool lookup(KeySym keysym, Binding& binding) const;
+    
+    // 获取修饰键（0-7，对应ShiftMapIndex到Mod5MapIndex）对应的键码，没有时返回0
+    uint8_t modifierKeycode(int modIndex) const;
+    
+    // 当前映射中所有可输入的KeySym及其按键（从按键轨迹还原字符时使用）
+    std::vector<std::pair<KeySym, Binding>> bindings() const;
+#endif
+    
+    bool isLoaded() const;
+
+private:
+#ifdef __linux__
+    void insert(KeySym keysym, uint8_t keycode, uint16_t modifiers);
+#endif
+    
+    bool m_loaded;                                      // 是否已加载
+    std::array<Binding, 256> m_latin1;                  // Latin-1 KeySym快速查找表
+    std::unordered_map<unsigned long, Binding> m_others;    // 其他KeySym
+    std::array<uint8_t, 8> m_modifierKeycodes;          // 修饰键键码
+    std::array<bool, 256> m_reserved;                   // 保留的键码
+};
+
+/**
+ * 预编译的按键计划
+ * 每个字符组在设置时被编译为一段连续的按键事件（包含修饰键的按下和释放），
+ * 所有字符组的事件存放在同一个连续数组中，输入线程只需顺序遍历
+ */
+class KeystrokePlan {
+public:
+    struct Group {
+        uint32_t firstEvent;    // 第一个事件在事件数组中的位置
+        uint32_t eventCount;    // 事件数量
+        uint32_t charCount;     // 可输入的字符数量
+    };
+    
+    // 编译一个字符组（UTF-8）并追加到计划中，返回无法输入而被跳过的字符数；
+    // Linux下映射中没有的可打印字符编译为Unicode事件，不计入跳过
+    size_t addGroup(std::string_view text, const KeyMap& keymap);
+    
+    // 清空计划，保留已分配的容量（工作线程复用同一个计划编译语料库中的字符组）
+    void clear();
+    
+    size_t groupCount() const;
+    const Group& group(size_t index) const;
+    const KeyEvent* events() const;
+    bool empty() const;
+    
+    // 从event开始到下一个字符结束标志（含）的事件数量
+    static size_t charEventCount(const KeyEvent* event, const KeyEvent* end);
+    
+    // decodeUtf8解码失败时返回的码位
+    static const uint32_t InvalidCodePoint = 0xFFFFFFFF;
+    
+    // 解码一个UTF-8字符并前移pos，无效的字节序列（包括过长编码、代理项和超出Unicode范围的码位）
+    // 返回InvalidCodePoint（只前移一个字节）
+    static uint32_t decodeUtf8(std::string_view text, size_t& pos);
+    
+#ifdef __linux__
+    // codePointToKeysym的逆映射：回车、制表符和退格为\n、\t、\b，其他KeySym按KeycodePool换算，无法转换时返回0
+    static uint32_t keysymToCodePoint(KeySym keysym);
+#endif
+
+private:
+#ifdef __linux__
+    // 将码位转换为KeySym，控制字符中只支持回车、制表符和退格，无法转换时返回NoSymbol
+    static KeySym codePointToKeysym(uint32_t codePoint);
+    
+    // 检查按键所需的修饰键是否都有对应的键码
+    static bool hasModifierKeys(const KeyMap::Binding& binding, const KeyMap& keymap);
+#endif
+    
+    std::vector<KeyEvent> m_events;     // 所有字符组的事件
+    std::vector<Group> m_groups;        // 字符组在事件数组中的范围
+};
+
+#endif // KEYSTROKE_PLAN_H
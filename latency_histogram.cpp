@@ -0,0 +1,162 @@
+#include "latency_histogram.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+
+namespace {
+    // 低于256的值每个值一个桶，之后每个2的幂区间分为128个子桶
+    const int SubBucketBits = 7;
+    const int64_t LinearLimit = int64_t(1) << (SubBucketBits + 1);
+    const int64_t SubBucketCount = int64_t(1) << SubBucketBits;
+    const int MaxShift = 34;
+    
+    int floorLog2(uint64_t value) {
+        int log = 0;
+        while (value >>= 1) {
+            log++;
+        }
+        return log;
+    }
+}
+
+const size_t LatencyHistogram::BucketCount =
+    static_cast<size_t>(LinearLimit + MaxShift * SubBucketCount);
+
+LatencyHistogram::LatencyHistogram()
+    : m_counts(BucketCount, 0)
+    , m_count(0)
+    , m_min(std::numeric_limits<int64_t>::max())
+    , m_max(0)
+    , m_sum(0)
+{
+}
+
+size_t LatencyHistogram::bucketIndex(int64_t value) {
+    if (value < LinearLimit) {
+        return value < 0 ? 0 : static_cast<size_t>(value);
+    }
+    int shift = floorLog2(static_cast<uint64_t>(value)) - SubBucketBits;
+    if (shift > MaxShift) {
+        return BucketCount - 1;
+    }
+    int64_t sub = (value >> shift) - SubBucketCount;
+    return static_cast<size_t>(LinearLimit + (shift - 1) * SubBucketCount + sub);
+}
+
+int64_t LatencyHistogram::bucketValue(size_t index) {
+    if (static_cast<int64_t>(index) < LinearLimit) {
+        return static_cast<int64_t>(index);
+    }
+    int64_t offset = static_cast<int64_t>(index) - LinearLimit;
+    int shift = static_cast<int>(offset / SubBucketCount) + 1;
+    int64_t sub = offset % SubBucketCount + SubBucketCount;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t valueNs) {
+    if (valueNs < 0) {
+        valueNs = 0;
+    }
+    m_counts[bucketIndex(valueNs)]++;
+    m_count++;
+    m_min = std::min(m_min, valueNs);
+    m_max = std::max(m_max, valueNs);
+    m_sum += static_cast<double>(valueNs);
+}
+
+void LatencyHistogram::reset() {
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    m_count = 0;
+    m_min = std::numeric_limits<int64_t>::max();
+    m_max = 0;
+    m_sum = 0;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BucketCount; i++) {
+        m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+    m_sum += other.m_sum;
+}
+
+void LatencyHistogram::recordBucket(size_t index, uint64_t count) {
+    if (count == 0 || index >= BucketCount) {
+        return;
+    }
+    int64_t value = bucketValue(index);
+    m_counts[index] += count;
+    m_count += count;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+    m_sum += static_cast<double>(value) * static_cast<double>(count);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return m_count;
+}
+
+int64_t LatencyHistogram::min() const {
+    return m_count > 0 ? m_min : 0;
+}
+
+int64_t LatencyHistogram::max() const {
+    return m_max;
+}
+
+double LatencyHistogram::mean() const {
+    return m_count > 0 ? m_sum / static_cast<double>(m_count) : 0.0;
+}
+
+int64_t LatencyHistogram::percentile(double p) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    // 目标样本序号向上取整，至少为1
+    uint64_t target = static_cast<uint64_t>(p / 100.0 * static_cast<double>(m_count) + 0.999999);
+    target = std::max<uint64_t>(1, std::min(target, m_count));
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BucketCount; i++) {
+        seen += m_counts[i];
+        if (seen >= target) {
+            return std::min(bucketValue(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+std::string LatencyHistogram::summary() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "p50 " << percentile(50.0) / 1000.0 << "µs"
+        << "  p99 " << percentile(99.0) / 1000.0 << "µs"
+        << "  p99.9 " << percentile(99.9) / 1000.0 << "µs"
+        << "  max " << max() / 1000.0 << "µs";
+    return out.str();
+}
+
+AtomicHistogram::AtomicHistogram()
+    : m_counts(new std::atomic<uint64_t>[LatencyHistogram::BucketCount])
+{
+    for (size_t i = 0; i < LatencyHistogram::BucketCount; i++) {
+        m_counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void AtomicHistogram::record(int64_t valueNs) {
+    // 单写者：读改写不需要原子指令，只要求读者看到完整的值
+    std::atomic<uint64_t>& counter = m_counts[LatencyHistogram::bucketIndex(valueNs)];
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+LatencyHistogram AtomicHistogram::snapshot() const {
+    LatencyHistogram histogram;
+    for (size_t i = 0; i < LatencyHistogram::BucketCount; i++) {
+        histogram.recordBucket(i, m_counts[i].load(std::memory_order_relaxed));
+    }
+    return histogram;
+}
@@ -0,0 +1,75 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * 延迟直方图（HDR风格）
+ * 按2的幂分段，每段再均分为128个子桶，任意值的相对误差小于1%，
+ * 记录为O(1)且不分配内存，可覆盖1纳秒到约36分钟的范围
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+    
+    // 记录一个值（纳秒），负值按0记录
+    void record(int64_t valueNs);
+    
+    // 清空所有记录
+    void reset();
+    
+    // 合并另一个直方图
+    void merge(const LatencyHistogram& other);
+    
+    // 按桶导入count个样本，样本值取桶的上界（用于从AtomicHistogram生成快照）
+    void recordBucket(size_t index, uint64_t count);
+    
+    uint64_t count() const;
+    int64_t min() const;
+    int64_t max() const;
+    double mean() const;
+    
+    // 百分位数（0-100），返回所在桶的上界
+    int64_t percentile(double p) const;
+    
+    // 格式化为一行摘要：p50/p99/p99.9/max（微秒）
+    std::string summary() const;
+    
+    // 桶布局（供其他直方图实现复用）
+    static size_t bucketIndex(int64_t value);
+    static int64_t bucketValue(size_t index);
+    static const size_t BucketCount;
+
+private:
+    std::vector<uint64_t> m_counts;     // 各桶计数
+    uint64_t m_count;                   // 样本数
+    int64_t m_min;                      // 最小值
+    int64_t m_max;                      // 最大值
+    double m_sum;                       // 样本和（用于平均值）
+};
+
+/**
+ * 可并发读取的延迟直方图
+ * 与LatencyHistogram使用相同的桶布局，只允许一个线程写入，
+ * 所有计数都是relaxed原子操作，其他线程可以随时生成快照
+ */
+class AtomicHistogram {
+public:
+    AtomicHistogram();
+    
+    // 记录一个值（纳秒），只能由一个线程调用
+    void record(int64_t valueNs);
+    
+    // 生成当前分布的快照（可在任意线程调用）
+    LatencyHistogram snapshot() const;
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts;  // 各桶计数
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,217 @@
+#include "latency_probe.h"
+#include <iostream>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+    int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+LatencyProbe::LatencyProbe()
+    : m_lost(0)
+    , m_unexpected(0)
+    , m_socket(-1)
+    , m_running(false)
+{
+}
+
+LatencyProbe::~LatencyProbe() {
+    disconnect();
+}
+
+bool LatencyProbe::connect(const std::string& socketPath) {
+#ifdef __linux__
+    disconnect();
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "无法创建套接字: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "套接字路径过长: " << socketPath << std::endl;
+        close(fd);
+        return false;
+    }
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "无法连接接收端 " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    
+    m_socket = fd;
+    m_running = true;
+    m_readerThread = std::thread(&LatencyProbe::readerLoop, this);
+    return true;
+#else
+    (void)socketPath;
+    std::cerr << "延迟测量仅支持Linux" << std::endl;
+    return false;
+#endif
+}
+
+void LatencyProbe::disconnect() {
+#ifdef __linux__
+    m_running = false;
+    if (m_socket >= 0) {
+        // 关闭读方向使阻塞中的read返回
+        shutdown(m_socket, SHUT_RDWR);
+    }
+    if (m_readerThread.joinable()) {
+        try {
+            m_readerThread.join();
+        } catch (...) {
+            // 忽略join异常
+        }
+    }
+    if (m_socket >= 0) {
+        close(m_socket);
+        m_socket = -1;
+    }
+#endif
+}
+
+void LatencyProbe::onKeysSent(const TimedKeyEvent* events, size_t count, int64_t sendTimeNs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int64_t timestamp = sendTimeNs;
+    for (size_t i = 0; i < count; i++) {
+        timestamp += static_cast<int64_t>(events[i].delayMs) * 1000000;
+        // 接收窗口只报告KeyPress，释放事件和鼠标事件不参与匹配
+        if (events[i].event.isPress() && !events[i].event.isPointer()) {
+            m_sent.push_back(SentKey{timestamp, events[i].event.code});
+        }
+    }
+}
+
+void LatencyProbe::drain(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_sent.empty()) {
+                return;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void LatencyProbe::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sent.clear();
+    m_histogram.reset();
+    m_lost = 0;
+    m_unexpected = 0;
+}
+
+LatencyHistogram LatencyProbe::histogram() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_histogram;
+}
+
+uint64_t LatencyProbe::lost() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lost;
+}
+
+uint64_t LatencyProbe::unexpected() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_unexpected;
+}
+
+uint64_t LatencyProbe::pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sent.size();
+}
+
+void LatencyProbe::match(const LatencyRecord& record) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    // 先确认队列中存在该键码，否则视为外部按键（例如用户手动输入），不消耗发送记录
+    bool found = false;
+    for (const SentKey& key : m_sent) {
+        if (key.keycode == record.keycode) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        m_unexpected++;
+        return;
+    }
+    
+    // 队首之前未匹配上的发送记录都视为丢失
+    while (m_sent.front().keycode != record.keycode) {
+        m_sent.pop_front();
+        m_lost++;
+    }
+    m_histogram.record(record.timestampNs - m_sent.front().timestampNs);
+    m_sent.pop_front();
+}
+
+void LatencyProbe::readerLoop() {
+#ifdef __linux__
+    char buffer[sizeof(LatencyRecord) * 256];
+    size_t buffered = 0;
+    
+    while (m_running) {
+        ssize_t bytes = read(m_socket, buffer + buffered, sizeof(buffer) - buffered);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            if (m_running) {
+                std::cerr << "接收端已断开连接" << std::endl;
+            }
+            break;
+        }
+        buffered += static_cast<size_t>(bytes);
+        
+        // 处理完整的记录，剩余的不完整部分移到缓冲区开头
+        size_t offset = 0;
+        while (buffered - offset >= sizeof(LatencyRecord)) {
+            LatencyRecord record;
+            std::memcpy(&record, buffer + offset, sizeof(record));
+            match(record);
+            offset += sizeof(LatencyRecord);
+        }
+        std::memmove(buffer, buffer + offset, buffered - offset);
+        buffered -= offset;
+    }
+#endif
+}
+
+ProbeSink::ProbeSink(std::unique_ptr<KeyEventSink> inner, LatencyProbe& probe)
+    : m_inner(std::move(inner))
+    , m_probe(probe)
+{
+}
+
+void ProbeSink::send(const TimedKeyEvent* events, size_t count) {
+    // 先登记再发送，保证接收端的记录到达时发送记录已在队列中
+    m_probe.onKeysSent(events, count, nowNs());
+    m_inner->send(events, count);
+    m_eventsSent.store(m_inner->eventsSent(), std::memory_order_relaxed);
+    m_requestsSent.store(m_inner->requestsSent(), std::memory_order_relaxed);
+    m_flushCount.store(m_inner->flushCount(), std::memory_order_relaxed);
+    m_lockWaitNs.store(m_inner->lockWaitNs(), std::memory_order_relaxed);
+    m_lockHoldNs.store(m_inner->lockHoldNs(), std::memory_order_relaxed);
+    m_keycodeRemaps.store(m_inner->keycodeRemaps(), std::memory_order_relaxed);
+}
+
+const char* ProbeSink::name() const {
+    return m_inner->name();
+}
@@ -0,0 +1,99 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include "key_event_sink.h"
+#include "latency_histogram.h"
+
+/**
+ * 接收端发回的按键记录
+ * 接收窗口每收到一个KeyPress就通过UNIX套接字发送一条，
+ * 时间戳为CLOCK_MONOTONIC纳秒，与模拟器的steady_clock同源
+ */
+struct LatencyRecord {
+    int64_t timestampNs;    // 接收端从事件队列取出事件的时间
+    uint32_t keycode;       // 按键键码
+    uint32_t sequence;      // 接收端序号（从0开始）
+};
+
+/**
+ * 端到端延迟探针
+ * 记录每个注入的按下事件的发送时间，并与接收端回传的时间戳按顺序匹配。
+ * 同一X连接上的事件保持顺序，所以按键码做先进先出匹配即可；
+ * 键码不一致时丢弃较早的发送记录并计为丢失
+ */
+class LatencyProbe {
+public:
+    LatencyProbe();
+    ~LatencyProbe();
+    
+    // 连接接收端的UNIX套接字并启动读取线程
+    bool connect(const std::string& socketPath);
+    
+    // 断开连接并停止读取线程
+    void disconnect();
+    
+    // 由ProbeSink在发送后调用，sendTimeNs为该批提交前的时间
+    void onKeysSent(const TimedKeyEvent* events, size_t count, int64_t sendTimeNs);
+    
+    // 等待所有已发送的按键被接收端确认，最多等待timeout
+    void drain(std::chrono::milliseconds timeout);
+    
+    // 清空直方图、计数和待匹配队列（开始下一个速率前调用）
+    void reset();
+    
+    // 当前统计（拷贝，线程安全）
+    LatencyHistogram histogram() const;
+    uint64_t lost() const;          // 发送了但未被接收的按键
+    uint64_t unexpected() const;    // 接收到但没有对应发送记录的按键
+    uint64_t pending() const;       // 仍在等待接收的按键
+
+private:
+    // 读取接收端记录的线程
+    void readerLoop();
+    
+    // 匹配一条接收记录
+    void match(const LatencyRecord& record);
+
+private:
+    struct SentKey {
+        int64_t timestampNs;
+        uint32_t keycode;
+    };
+    
+    mutable std::mutex m_mutex;         // 保护以下状态
+    std::deque<SentKey> m_sent;         // 待匹配的发送记录
+    LatencyHistogram m_histogram;       // 延迟直方图
+    uint64_t m_lost;                    // 丢失计数
+    uint64_t m_unexpected;              // 意外按键计数
+    
+    int m_socket;                       // 与接收端的连接
+    std::atomic<bool> m_running;        // 读取线程是否运行
+    std::thread m_readerThread;         // 读取线程
+};
+
+/**
+ * 延迟探针后端：包装实际后端，在每批发送前取时间戳并交给探针
+ * 批内事件的发送时间按delay参数推算，测量延迟时应使用--batch 1
+ */
+class ProbeSink : public KeyEventSink {
+public:
+    ProbeSink(std::unique_ptr<KeyEventSink> inner, LatencyProbe& probe);
+    
+    void send(const TimedKeyEvent* events, size_t count) override;
+    const char* name() const override;
+
+private:
+    std::unique_ptr<KeyEventSink> m_inner;  // 实际后端
+    LatencyProbe& m_probe;                  // 延迟探针
+};
+
+#endif // LATENCY_PROBE_H
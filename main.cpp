@@ -1,4 +1,6 @@
 #include "keyboard_simulator.h"
+#include "key_recorder.h"
+#include "rate_tuner.h"
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -6,10 +8,58 @@
 #include <thread>
 #include <chrono>
 #include <locale>
+#include <random>
+#include <memory>
+#include <csignal>
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
+/**
+ * 命令行选项
+ */
+struct CommandLineOptions {
+    std::vector<std::string> texts;     // 字符组列表（初始为空）
+    double frequency = 10.0;            // 每秒10次（默认值）
+    int delay = 100;                    // 100毫秒（默认值）
+    bool frequencySet = false;          // 是否显式设置了频率
+    bool delaySet = false;              // 是否显式设置了延迟
+    bool textSet = false;               // 是否显式设置了字符组
+    int spinUs = 0;                     // 自旋阈值（微秒）
+    RealtimeOptions realtime;           // 实时运行选项
+    DeadlineScheduler::MissPolicy missPolicy = DeadlineScheduler::MissPolicy::CatchUp;
+    size_t batchSize = 1;               // 每批事件数（0表示整个周期）
+    KeyboardSimulator::OutputBackend backend = KeyboardSimulator::OutputBackend::Native;
+    size_t ringCapacity = 1 << 20;      // 内存后端环形缓冲区容量（事件数）
+    bool autoStart = false;             // 是否立即开始输入
+    double durationSec = 0;             // 运行时长（秒，0表示不限制）
+    size_t workers = 1;                 // 工作线程数
+    std::string corpusPath;             // 语料库文件（每行一个字符组，可带权重）
+    std::vector<std::string> typingSources; // 打字模型的训练文件（文本或按键轨迹，为空时不使用打字模型）
+    size_t ngramOrder = TypingModel::DefaultOrder;  // 打字模型的阶数
+    std::string profileSpec;            // 负载曲线（逗号分隔的阶段）
+    std::string profileFile;            // 负载曲线文件
+    uint32_t seed = 0;                  // 泊松阶段和按住时长的随机种子（0表示随机）
+    std::string replayPath;             // 回放的按键轨迹文件（空表示不回放）
+    double replaySpeed = 1.0;           // 回放速度倍数
+    double replayFromSec = 0;           // 从轨迹的第几秒开始回放
+    std::string scenarioPath;           // 场景脚本文件（空表示随机输入字符组）
+    std::string holdSpec;               // 按住时长（逗号分隔的分量，空表示不启用按住模式）
+    size_t overlap = 1;                 // 按住模式下最多同时按住的键数
+    std::string mouseSpec;              // 鼠标事件的类别和频率（空表示不注入鼠标事件）
+    std::vector<TargetSpec> targets;    // 定向注入的目标（为空时注入到焦点窗口）
+    std::vector<std::string> displays;  // 驱动的X显示器（为空时使用DISPLAY环境变量）
+    std::string recordPath;             // 录制模式：输出的按键轨迹文件（空表示不录制）
+    std::string controlPath;            // 运行时控制套接字（空表示不开启）
+    std::string metricsPath;            // 指标输出文件（空表示不输出）
+    double metricsInterval = 5.0;       // 指标输出间隔（秒）
+    std::string latencySocket;          // 延迟测量：接收端套接字路径（空表示不测量）
+    std::vector<double> latencyRates;   // 延迟测量：依次测量的频率
+    bool autotune = false;              // 自动搜索最大可持续频率
+    TuneLimits tuneLimits;              // 自动调优的判定条件
+    double tuneMaxRate = 1000000.0;     // 自动调优的频率上限
+};
+
 void printUsage(const char* programName) {
     std::cout << "键盘输入压力测试工具" << std::endl;
     std::cout << "用法: " << programName << " [选项]" << std::endl;
@@ -18,52 +68,383 @@ void printUsage(const char* programName) {
     std::cout << "  -t, --text <文本>        要输入的文本内容（默认: \"test\"）" << std::endl;
     std::cout << "                           可以多次使用此选项添加多个字符组" << std::endl;
     std::cout << "                           每个周期会随机选择一个字符组输入" << std::endl;
+    std::cout << "      --corpus <文件>      从语料库文件读取字符组（每行一个，行尾可用制表符分隔权重），代替 -t" << std::endl;
+    std::cout << "      --typing-model <文件> 从样本文本或按键轨迹训练打字模型，按字符n-gram逐字符生成输入，" << std::endl;
+    std::cout << "                           按键间隔按双字母的分布抽取，可多次使用（代替 -t/--corpus）；" << std::endl;
+    std::cout << "                           训练了按键轨迹且未指定 -f/-d 时按轨迹的平均节奏输入" << std::endl;
+    std::cout << "      --ngram <阶数>       打字模型的阶数，即根据前 阶数-1 个字符选择下一个字符（2到8，默认: 3）" << std::endl;
     std::cout << "  -f, --frequency <频率>   输入频率（每秒输入次数，默认: 10）" << std::endl;
     std::cout << "  -d, --delay <延迟>       输入延迟（毫秒，默认: 100）" << std::endl;
+    std::cout << "      --spin <微秒>        截止时间前忙等待的时长（默认: 0，不自旋）" << std::endl;
+    std::cout << "      --realtime           实时模式：工作线程使用SCHED_FIFO并绑定CPU，锁定内存，由timerfd唤醒，" << std::endl;
+    std::cout << "                           权限不足的部分退回默认行为，结束时报告唤醒抖动（仅Linux）" << std::endl;
+    std::cout << "      --rt-priority <1-99> 实时模式的SCHED_FIFO优先级（默认: 80）" << std::endl;
+    std::cout << "      --cpus <CPU列表>     实时模式绑定的CPU，如 2,3 或 4-7（默认: 隔离的CPU，没有时用编号最大的CPU）" << std::endl;
+    std::cout << "      --miss-policy <策略> 错过周期时的策略: catchup（追赶，默认）或 drop（丢弃）" << std::endl;
+    std::cout << "      --batch <事件数>     每批发送的按键事件数，每批只刷新一次（默认: 1，即每个字符一批）" << std::endl;
+    std::cout << "                           指定 cycle 时整个周期为一批，批内间隔由XTest延迟参数控制" << std::endl;
+    std::cout << "      --backend <后端>     按键输出后端: native（默认）、null（只计数）、memory（内存记录）" << std::endl;
+    std::cout << "                           null 和 memory 不需要X服务器，并会立即开始输入" << std::endl;
+    std::cout << "      --ring <事件数>      memory 后端的环形缓冲区容量（默认: 1048576）" << std::endl;
+    std::cout << "      --workers <数量>     并行工作线程数，每个线程使用独立的X连接和调度器（默认: 1）" << std::endl;
+    std::cout << "                           总频率平均分配给各工作线程，结束时合并统计" << std::endl;
+    std::cout << "      --autostart          启动后立即开始输入，不等待鼠标左键点击" << std::endl;
+    std::cout << "      --duration <秒>      运行指定时长后自动退出（延迟测量时为每个频率的时长）" << std::endl;
+    std::cout << "      --profile <阶段列表> 负载曲线，逗号分隔的阶段（形状:时长:参数），设置后忽略 -f/-d：" << std::endl;
+    std::cout << "                           const:10s:200  ramp:60s:100-2000  step:60s:100-2000/5" << std::endl;
+    std::cout << "                           burst:30s:2000/0.5/1.5  poisson:60s:500  sine:60s:500/300/10" << std::endl;
+    std::cout << "      --profile-file <文件> 从文件读取负载曲线，每行一个阶段，#开头为注释" << std::endl;
+    std::cout << "      --seed <种子>        泊松阶段和按住时长的随机种子（默认随机）" << std::endl;
+    std::cout << "      --replay <文件>      按原始时间回放按键轨迹文件，代替 -t/--corpus，回放完后退出" << std::endl;
+    std::cout << "      --replay-speed <倍数> 回放速度倍数，如 10 或 10x（默认: 1）" << std::endl;
+    std::cout << "      --replay-from <秒>   从轨迹的第几秒开始回放（默认: 0）" << std::endl;
+    std::cout << "      --scenario <文件>    按场景脚本输入（type/press/down/up/chord/wait/group/repeat/loop），" << std::endl;
+    std::cout << "                           代替每个周期随机选择字符组，执行完后退出" << std::endl;
+    std::cout << "      --hold <分量列表>    按住模式：每个周期按下一个键，按住一段时间后释放，逗号分隔的分量等概率抽取：" << std::endl;
+    std::cout << "                           50  uniform:20-200  exp:80  normal:120/30（毫秒）  repeat:3（自动重复3次）" << std::endl;
+    std::cout << "      --overlap <数量>     按住模式下最多同时按住的键数，超出时提前释放最早到期的键（默认: 1）" << std::endl;
+    std::cout << "      --mouse <类别列表>   与按键并行注入鼠标事件，逗号分隔的 类别:频率（次/秒）：" << std::endl;
+    std::cout << "                           move:500（小圆周移动）  click:20（左键点击）  scroll:50（滚轮）；" << std::endl;
+    std::cout << "                           设置后鼠标不再控制开始和暂停，改用 Pause 键或 --control" << std::endl;
+    std::cout << "      --target <目标>      定向注入：通过XSendEvent直接发给窗口，不依赖焦点，可多次使用（仅Linux）" << std::endl;
+    std::cout << "                           id:窗口ID、name:标题子串 或 pid:进程号，可带 @频率；" << std::endl;
+    std::cout << "                           每个匹配的窗口一个工作线程，按各自的频率输入" << std::endl;
+    std::cout << "      --display <显示器列表> 注入到指定的X显示器，逗号分隔或多次使用，如 :1,:2,:3（仅Linux）；" << std::endl;
+    std::cout << "                           多个显示器时每个显示器一个工作线程，各自按完整的频率输入，" << std::endl;
+    std::cout << "                           各显示器的键盘映射应当相同，鼠标和ESC只在第一个显示器上监听" << std::endl;
+    std::cout << "      --record <文件>      录制模式：通过XRecord捕获显示器上的真实键盘输入，写入按键轨迹文件，" << std::endl;
+    std::cout << "                           不注入任何按键，按 Ctrl+C 或到达 --duration 后停止（仅Linux）" << std::endl;
+    std::cout << "      --control <套接字>   在UNIX套接字上接受运行时命令（set-rate/set-delay/set-groups/pause/resume/stats），" << std::endl;
+    std::cout << "                           修改在下一个截止时间生效，不需要重启（仅Linux）" << std::endl;
+    std::cout << "      --metrics <文件>     定期把输入路径指标写入文件（.json为JSON，否则为Prometheus文本格式）" << std::endl;
+    std::cout << "      --metrics-interval <秒> 指标输出间隔（默认: 5）" << std::endl;
+    std::cout << "      --latency <套接字>   端到端延迟测量：连接 KeyboardReceiver 接收窗口，" << std::endl;
+    std::cout << "                           依次以各个频率输入并输出延迟直方图（p50/p99/p99.9/max）" << std::endl;
+    std::cout << "      --rates <频率列表>   延迟测量的频率，逗号分隔（默认: 100,1000,5000）" << std::endl;
+    std::cout << "      --autotune           自动搜索最大可持续频率：从 -f 开始翻倍，超出限制后二分，" << std::endl;
+    std::cout << "                           每个频率运行 --duration 秒（默认: 2）；有 --latency 时按接收端确认判定，" << std::endl;
+    std::cout << "                           否则按XSync往返时间判定（仅Linux原生后端）" << std::endl;
+    std::cout << "      --max-latency <毫秒> 自动调优的p99延迟上限（默认: 10）" << std::endl;
+    std::cout << "      --max-loss <百分比>  自动调优的丢失比例上限（默认: 0.1）" << std::endl;
+    std::cout << "      --max-rate <频率>    自动调优的频率上限（默认: 1000000）" << std::endl;
     std::cout << "  -h, --help               显示此帮助信息" << std::endl;
     std::cout << std::endl;
     std::cout << "示例:" << std::endl;
     std::cout << "  " << programName << " -t \"Hello World\" -f 20" << std::endl;
     std::cout << "  " << programName << " --text \"test123\" --delay 50" << std::endl;
     std::cout << "  " << programName << " -t \"test1\" -t \"test2\" -t \"test3\"" << std::endl;
+    std::cout << "  " << programName << " -t \"a\" -f 5000 --spin 50 --miss-policy drop" << std::endl;
+    std::cout << "  " << programName << " -t \"a\" -f 5000 --autostart --realtime --cpus 3" << std::endl;
+    std::cout << "  " << programName << " -t \"test\" -f 20000 --backend null --duration 10" << std::endl;
+    std::cout << "  " << programName << " -t \"test\" -f 40000 --workers 8 --batch cycle" << std::endl;
+    std::cout << "  " << programName << " -t \"a\" --autostart --profile \"ramp:60s:100-5000,poisson:60s:2000\"" << std::endl;
+    std::cout << "  " << programName << " -t \"hello\" -t \"world\" --scenario login.scn --autostart" << std::endl;
+    std::cout << "  " << programName << " -t \"hello\" -f 2000 --mouse move:1000,click:20,scroll:100 --autostart" << std::endl;
+    std::cout << "  " << programName << " -t \"asdfjkl\" -f 2000 --hold \"uniform:20-200,repeat:2\" --overlap 6 --autostart" << std::endl;
+    std::cout << "  " << programName << " -t \"test\" --autostart --target name:gedit@200 --target pid:4242@50" << std::endl;
+    std::cout << "  " << programName << " -t \"test\" -f 500 --autostart --display :1,:2,:3 --metrics keyboard.prom" << std::endl;
+    std::cout << "  " << programName << " --record session.kst" << std::endl;
+    std::cout << "  " << programName << " --typing-model session.kst --typing-model novel.txt --ngram 4 --autostart" << std::endl;
+    std::cout << "  " << programName << " --replay session.kst --replay-speed 10x --autostart" << std::endl;
+    std::cout << "  " << programName << " -t \"test\" -f 1000 --autostart --control /tmp/keyboard.ctl" << std::endl;
+    std::cout << "  " << programName << " -t \"test\" -f 1000 --autostart --metrics /var/lib/node_exporter/keyboard.prom" << std::endl;
+    std::cout << "  " << programName << " -t \"a\" --latency /tmp/keyboard_receiver.sock --rates 100,1000 --duration 5" << std::endl;
+    std::cout << "  " << programName << " -t \"a\" -f 500 --autotune --latency /tmp/keyboard_receiver.sock --max-latency 5" << std::endl;
     std::cout << std::endl;
     std::cout << "操作说明:" << std::endl;
     std::cout << "  1. 运行程序后，程序会等待鼠标左键点击" << std::endl;
     std::cout << "  2. 在目标输入框中点击鼠标左键开始输入" << std::endl;
     std::cout << "  3. 点击鼠标右键暂停输入，再次点击左键继续" << std::endl;
-    std::cout << "  4. 按 ESC 键退出程序" << std::endl;
+    std::cout << "  4. 也可以按 Pause 键开始、暂停和继续（使用 --mouse 时只能用 Pause 键）" << std::endl;
+    std::cout << "  5. 按 ESC 键退出程序" << std::endl;
 }
 
-bool parseArguments(int argc, char* argv[], std::vector<std::string>& texts, double& frequency, int& delay, bool& frequencySet, bool& delaySet, bool& textSet) {
+// 取选项的参数，缺少参数时输出错误并返回nullptr
+const char* optionValue(int argc, char* argv[], int& i, const std::string& name) {
+    if (i + 1 < argc) {
+        return argv[++i];
+    }
+    std::cerr << "错误: " << name << " 选项需要参数" << std::endl;
+    return nullptr;
+}
+
+bool parseArguments(int argc, char* argv[], CommandLineOptions& options) {
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
+        const char* value = nullptr;
         
         if (arg == "-h" || arg == "--help") {
             return false;
         } else if (arg == "-t" || arg == "--text") {
-            if (i + 1 < argc) {
-                texts.push_back(argv[++i]);
-                textSet = true;  // 标记已设置字符组
-            } else {
-                std::cerr << "错误: -t 选项需要参数" << std::endl;
+            if (!(value = optionValue(argc, argv, i, "-t"))) {
+                return false;
+            }
+            options.texts.push_back(value);
+            options.textSet = true;  // 标记已设置字符组
+        } else if (arg == "--corpus") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.corpusPath = value;
+        } else if (arg == "--typing-model") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.typingSources.push_back(value);
+        } else if (arg == "--ngram") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.ngramOrder = static_cast<size_t>(std::stoul(value));
+            if (options.ngramOrder < 2 || options.ngramOrder > TypingModel::MaxOrder) {
+                std::cerr << "错误: --ngram 必须在2到" << TypingModel::MaxOrder << "之间" << std::endl;
                 return false;
             }
         } else if (arg == "-f" || arg == "--frequency") {
-            if (i + 1 < argc) {
-                frequency = std::stod(argv[++i]);
-                frequencySet = true;
-            } else {
-                std::cerr << "错误: -f 选项需要参数" << std::endl;
+            if (!(value = optionValue(argc, argv, i, "-f"))) {
                 return false;
             }
+            options.frequency = std::stod(value);
+            options.frequencySet = true;
         } else if (arg == "-d" || arg == "--delay") {
-            if (i + 1 < argc) {
-                delay = std::stoi(argv[++i]);
-                delaySet = true;
+            if (!(value = optionValue(argc, argv, i, "-d"))) {
+                return false;
+            }
+            options.delay = std::stoi(value);
+            options.delaySet = true;
+        } else if (arg == "--spin") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.spinUs = std::stoi(value);
+        } else if (arg == "--realtime") {
+            options.realtime.enabled = true;
+        } else if (arg == "--rt-priority") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.realtime.priority = std::stoi(value);
+            if (options.realtime.priority < 1 || options.realtime.priority > 99) {
+                std::cerr << "错误: --rt-priority 必须在1到99之间" << std::endl;
+                return false;
+            }
+        } else if (arg == "--cpus") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            if (!options.realtime.parseCpus(value)) {
+                return false;
+            }
+        } else if (arg == "--miss-policy") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            if (!DeadlineScheduler::parseMissPolicy(value, options.missPolicy)) {
+                std::cerr << "错误: 未知的策略: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--batch") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            std::string batch = value;
+            options.batchSize = (batch == "cycle") ? 0 : static_cast<size_t>(std::stoul(batch));
+            if (batch != "cycle" && options.batchSize == 0) {
+                std::cerr << "错误: --batch 必须大于0或为 cycle" << std::endl;
+                return false;
+            }
+        } else if (arg == "--backend") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            std::string backend = value;
+            if (backend == "native" || backend == "xtest" || backend == "sendinput") {
+                options.backend = KeyboardSimulator::OutputBackend::Native;
+            } else if (backend == "null") {
+                options.backend = KeyboardSimulator::OutputBackend::Null;
+            } else if (backend == "memory") {
+                options.backend = KeyboardSimulator::OutputBackend::Memory;
             } else {
-                std::cerr << "错误: -d 选项需要参数" << std::endl;
+                std::cerr << "错误: 未知的后端: " << backend << std::endl;
+                return false;
+            }
+        } else if (arg == "--ring") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.ringCapacity = static_cast<size_t>(std::stoul(value));
+        } else if (arg == "--workers") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.workers = static_cast<size_t>(std::stoul(value));
+            if (options.workers == 0) {
+                std::cerr << "错误: --workers 必须大于0" << std::endl;
+                return false;
+            }
+        } else if (arg == "--profile") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.profileSpec = value;
+        } else if (arg == "--profile-file") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.profileFile = value;
+        } else if (arg == "--seed") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.seed = static_cast<uint32_t>(std::stoul(value));
+        } else if (arg == "--replay") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.replayPath = value;
+        } else if (arg == "--replay-speed") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            // 允许写成 10x
+            std::string speed = value;
+            if (!speed.empty() && (speed.back() == 'x' || speed.back() == 'X')) {
+                speed.pop_back();
+            }
+            options.replaySpeed = std::stod(speed);
+            if (options.replaySpeed <= 0) {
+                std::cerr << "错误: --replay-speed 必须大于0" << std::endl;
+                return false;
+            }
+        } else if (arg == "--replay-from") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.replayFromSec = std::stod(value);
+        } else if (arg == "--scenario") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.scenarioPath = value;
+        } else if (arg == "--hold") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.holdSpec = value;
+        } else if (arg == "--overlap") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.overlap = static_cast<size_t>(std::stoul(value));
+            if (options.overlap == 0) {
+                std::cerr << "错误: --overlap 必须大于0" << std::endl;
+                return false;
+            }
+        } else if (arg == "--mouse") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.mouseSpec = value;
+        } else if (arg == "--target") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            TargetSpec target;
+            if (!target.parse(value)) {
+                return false;
+            }
+            options.targets.push_back(target);
+        } else if (arg == "--display") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            std::stringstream displays(value);
+            std::string display;
+            while (std::getline(displays, display, ',')) {
+                if (!display.empty()) {
+                    options.displays.push_back(display);
+                }
+            }
+        } else if (arg == "--record") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
                 return false;
             }
+            options.recordPath = value;
+        } else if (arg == "--control") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.controlPath = value;
+        } else if (arg == "--metrics") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.metricsPath = value;
+        } else if (arg == "--metrics-interval") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.metricsInterval = std::stod(value);
+            if (options.metricsInterval <= 0) {
+                std::cerr << "错误: --metrics-interval 必须大于0" << std::endl;
+                return false;
+            }
+        } else if (arg == "--latency") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.latencySocket = value;
+        } else if (arg == "--rates") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.latencyRates.clear();
+            std::stringstream rates(value);
+            std::string rate;
+            while (std::getline(rates, rate, ',')) {
+                double frequency = std::stod(rate);
+                if (frequency <= 0) {
+                    std::cerr << "错误: 频率必须大于0: " << rate << std::endl;
+                    return false;
+                }
+                options.latencyRates.push_back(frequency);
+            }
+        } else if (arg == "--autotune") {
+            options.autotune = true;
+        } else if (arg == "--max-latency") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.tuneLimits.maxLatencyMs = std::stod(value);
+            if (options.tuneLimits.maxLatencyMs <= 0) {
+                std::cerr << "错误: --max-latency 必须大于0" << std::endl;
+                return false;
+            }
+        } else if (arg == "--max-loss") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.tuneLimits.maxLossPercent = std::stod(value);
+            if (options.tuneLimits.maxLossPercent < 0) {
+                std::cerr << "错误: --max-loss 不能为负数" << std::endl;
+                return false;
+            }
+        } else if (arg == "--max-rate") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.tuneMaxRate = std::stod(value);
+            if (options.tuneMaxRate <= 0) {
+                std::cerr << "错误: --max-rate 必须大于0" << std::endl;
+                return false;
+            }
+        } else if (arg == "--autostart") {
+            options.autoStart = true;
+        } else if (arg == "--duration") {
+            if (!(value = optionValue(argc, argv, i, arg))) {
+                return false;
+            }
+            options.durationSec = std::stod(value);
         } else {
             std::cerr << "未知选项: " << arg << std::endl;
             return false;
@@ -97,66 +478,710 @@ void setupConsoleUTF8() {
 #endif
 }
 
+namespace {
+    volatile std::sig_atomic_t g_stopRecording = 0;
+    
+    void onStopSignal(int) {
+        g_stopRecording = 1;
+    }
+    
+    // 距离end的剩余时间，向上取整到毫秒，用作事件循环的等待超时
+    template <typename TimePoint>
+    std::chrono::milliseconds remainingUntil(TimePoint end) {
+        auto remaining = end - std::chrono::steady_clock::now();
+        if (remaining <= decltype(remaining)::zero()) {
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::duration_cast<std::chrono::milliseconds>(remaining) + std::chrono::milliseconds(1);
+    }
+}
+
+// 录制模式：捕获显示器上的键盘输入写入轨迹文件，直到Ctrl+C或到达运行时长
+int runRecorder(const CommandLineOptions& options) {
+#ifdef __linux__
+    KeyRecorder recorder;
+    if (!recorder.start(options.recordPath, options.displays.empty() ? nullptr : options.displays.front().c_str())) {
+        return 1;
+    }
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    
+    std::cout << "正在录制键盘输入到 " << options.recordPath << "，按 Ctrl+C 停止..." << std::endl;
+    auto startTime = std::chrono::steady_clock::now();
+    while (!g_stopRecording && recorder.isRecording()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (options.durationSec > 0 &&
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() >= options.durationSec) {
+            break;
+        }
+    }
+    recorder.stop();
+    
+    std::cout << "录制完成: " << recorder.eventsWritten() << " 个按键事件";
+    if (recorder.eventsDropped() > 0) {
+        std::cout << "，队列满丢弃 " << recorder.eventsDropped() << " 个";
+    }
+    std::cout << std::endl;
+    return 0;
+#else
+    (void)options;
+    std::cerr << "错误: 录制模式仅支持Linux（需要XRecord扩展）" << std::endl;
+    return 1;
+#endif
+}
+
+// 端到端延迟测量：每个频率运行一次模拟器，输出该频率下的延迟分布
+int runLatencyHarness(const CommandLineOptions& options) {
+    LatencyProbe probe;
+    if (!probe.connect(options.latencySocket)) {
+        return 1;
+    }
+    
+    std::vector<double> rates = options.latencyRates;
+    if (rates.empty()) {
+        rates = {100.0, 1000.0, 5000.0};
+    }
+    double stepSec = options.durationSec > 0 ? options.durationSec : 5.0;
+    
+    std::cout << "========================================" << std::endl;
+    std::cout << "   端到端延迟测量" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "接收端: " << options.latencySocket << std::endl;
+    std::cout << "每个频率运行: " << std::fixed << std::setprecision(1) << stepSec << " 秒" << std::endl;
+    std::cout << std::endl;
+    
+    struct StepResult {
+        double rate;
+        LatencyHistogram histogram;
+        uint64_t lost;
+        uint64_t unexpected;
+    };
+    std::vector<StepResult> results;
+    
+    for (double rate : rates) {
+        probe.reset();
+        {
+            // 每批一个字符，发送时间戳即为该字符的注入时间
+            KeyboardSimulator simulator(options.displays);
+            for (const auto& text : options.texts) {
+                simulator.addInputText(text);
+            }
+            simulator.setInputFrequency(rate);
+            simulator.setSpinThreshold(options.spinUs);
+            simulator.setMissPolicy(options.missPolicy);
+            simulator.setRealtime(options.realtime);
+            simulator.setBatchSize(1);
+            simulator.setLatencyProbe(&probe);
+            simulator.setAutoStart(true);
+            
+            std::cout << "--- 频率 " << std::setprecision(0) << rate << " 次/秒 ---" << std::endl;
+            simulator.start();
+            auto stepEnd = std::chrono::steady_clock::now() + std::chrono::duration<double>(stepSec);
+            while (simulator.isRunning() && !simulator.shouldExit() && std::chrono::steady_clock::now() < stepEnd) {
+                simulator.waitForEvents(remainingUntil(stepEnd));
+            }
+            bool exitRequested = simulator.shouldExit();
+            simulator.stop();
+            if (exitRequested) {
+                break;
+            }
+        }
+        
+        // 等待仍在途中的按键到达接收端
+        probe.drain(std::chrono::milliseconds(1000));
+        results.push_back(StepResult{rate, probe.histogram(), probe.lost() + probe.pending(), probe.unexpected()});
+    }
+    probe.disconnect();
+    
+    std::cout << std::endl;
+    std::cout << "========== 端到端延迟 ==========" << std::endl;
+    for (const StepResult& result : results) {
+        std::cout << std::setw(8) << std::setprecision(0) << result.rate << " 次/秒: "
+                  << "样本 " << result.histogram.count()
+                  << "  丢失 " << result.lost;
+        if (result.unexpected > 0) {
+            std::cout << "  意外 " << result.unexpected;
+        }
+        std::cout << "  " << result.histogram.summary() << std::endl;
+    }
+    std::cout << "================================" << std::endl;
+    return 0;
+}
+
+// 自动调优：在同一个运行中的模拟器上逐步修改频率，搜索延迟和丢失都在限制内的最高频率
+int runAutotune(const CommandLineOptions& options) {
+    double startRate = options.frequency > 0 ? options.frequency : 10.0;
+    double stepSec = options.durationSec > 0 ? options.durationSec : 2.0;
+    
+    // 背压信号：有接收端时使用确认延迟和丢失，否则在原生后端上使用XSync往返时间
+    LatencyProbe probe;
+    bool useReceiver = !options.latencySocket.empty();
+    if (useReceiver && !probe.connect(options.latencySocket)) {
+        return 1;
+    }
+#ifdef __linux__
+    RoundTripProbe roundTrip;
+    bool useRoundTrip = !useReceiver && options.backend == KeyboardSimulator::OutputBackend::Native &&
+                        roundTrip.start(std::chrono::milliseconds(10));
+#else
+    bool useRoundTrip = false;
+#endif
+    
+    std::cout << "========================================" << std::endl;
+    std::cout << "   自动调优" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "起始频率: " << std::fixed << std::setprecision(2) << startRate << " 次/秒，上限 "
+              << options.tuneMaxRate << " 次/秒" << std::endl;
+    std::cout << "每个频率运行: " << std::setprecision(1) << stepSec << " 秒" << std::endl;
+    std::cout << "背压信号: " << (useReceiver ? "接收端确认（" + options.latencySocket + "）"
+                                  : (useRoundTrip ? std::string("XSync往返时间") : std::string("仅实际频率")))
+              << std::endl;
+    std::cout << "判定条件: p99延迟 <= " << options.tuneLimits.maxLatencyMs << " 毫秒";
+    if (useReceiver) {
+        std::cout << "，丢失 <= " << std::setprecision(2) << options.tuneLimits.maxLossPercent << "%";
+    }
+    std::cout << "，实际频率 >= 请求的 " << std::setprecision(0) << options.tuneLimits.minAchievedRatio * 100 << "%" << std::endl;
+    std::cout << std::endl;
+    
+    RateTuner tuner(startRate, options.tuneMaxRate, options.tuneLimits);
+    {
+        KeyboardSimulator simulator(options.displays);
+        simulator.setOutputBackend(options.backend, options.ringCapacity);
+        for (const auto& text : options.texts) {
+            simulator.addInputText(text);
+        }
+        simulator.setInputFrequency(tuner.nextRate());
+        simulator.setSpinThreshold(options.spinUs);
+        simulator.setMissPolicy(options.missPolicy);
+        simulator.setRealtime(options.realtime);
+        // 接收端按发送时间戳逐个匹配，每批一个字符
+        simulator.setBatchSize(useReceiver ? 1 : options.batchSize);
+        simulator.setWorkerCount(options.workers);
+        if (useReceiver) {
+            simulator.setLatencyProbe(&probe);
+        }
+        simulator.setAutoStart(true);
+        simulator.start();
+        
+        while (!tuner.finished() && simulator.isRunning() && !simulator.shouldExit()) {
+            // 新频率在下一个截止时间生效；两步之间暂停，让在途的按键到达接收端，
+            // 恢复时调度器跳过暂停期间的周期，上一步积压的追赶不会计入这一步
+            double rate = tuner.nextRate();
+            simulator.setInputFrequency(rate);
+            probe.reset();
+#ifdef __linux__
+            if (useRoundTrip) {
+                roundTrip.take();
+            }
+#endif
+            // 暂停中的工作线程在恢复时立即醒来，恢复后直接取起点快照
+            simulator.resume();
+            MetricsSnapshot before = simulator.metrics();
+            auto stepEnd = std::chrono::steady_clock::now() + std::chrono::duration<double>(stepSec);
+            while (simulator.isRunning() && !simulator.shouldExit() && std::chrono::steady_clock::now() < stepEnd) {
+                simulator.waitForEvents(remainingUntil(stepEnd));
+            }
+            MetricsSnapshot after = simulator.metrics();
+            simulator.pause();
+            if (!simulator.isRunning() || simulator.shouldExit()) {
+                break;
+            }
+            
+            TuneStep step;
+            step.rate = rate;
+            double elapsed = after.elapsedSec - before.elapsedSec;
+            if (elapsed > 0) {
+                step.achievedRate = static_cast<double>(after.total.cyclesCompleted - before.total.cyclesCompleted) / elapsed;
+            }
+            if (useReceiver) {
+                probe.drain(std::chrono::milliseconds(1000));
+                step.latency = probe.histogram();
+                step.lost = probe.lost() + probe.pending();
+                step.sent = step.latency.count() + step.lost;
+            }
+#ifdef __linux__
+            if (useRoundTrip) {
+                step.latency = roundTrip.take();
+            }
+#endif
+            tuner.record(step);
+            
+            const TuneStep& result = tuner.steps().back();
+            std::cout << std::setw(10) << std::setprecision(1) << result.rate << " 次/秒: 实际 "
+                      << result.achievedRate << " 次/秒";
+            if (result.latency.count() > 0) {
+                std::cout << "  " << result.latency.summary();
+            }
+            if (useReceiver) {
+                std::cout << "  丢失 " << result.lost;
+            }
+            std::cout << "  " << (result.passed ? "通过" : "未通过（" + result.reason + "）") << std::endl;
+        }
+        simulator.stop();
+    }
+    probe.disconnect();
+#ifdef __linux__
+    roundTrip.stop();
+#endif
+    
+    std::cout << std::endl;
+    std::cout << "========== 自动调优结果 ==========" << std::endl;
+    if (tuner.bestRate() <= 0) {
+        std::cout << "没有满足条件的频率（最低测量 " << std::setprecision(1) << tuner.nextRate() << " 次/秒）" << std::endl;
+        std::cout << "==================================" << std::endl;
+        return 1;
+    }
+    std::cout << "最大可持续频率: " << std::setprecision(1) << tuner.bestRate() << " 次/秒（测量 "
+              << tuner.steps().size() << " 个频率";
+    if (!tuner.finished()) {
+        std::cout << "，搜索被中断";
+    }
+    std::cout << "）" << std::endl;
+    std::cout << "==================================" << std::endl;
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     // 设置控制台UTF-8编码
     setupConsoleUTF8();
     
-    std::vector<std::string> inputTexts;  // 字符组列表（初始为空）
-    double frequency = 10.0;  // 每秒10次（默认值）
-    int delay = 100;          // 100毫秒（默认值）
-    bool frequencySet = false;  // 是否显式设置了频率
-    bool delaySet = false;      // 是否显式设置了延迟
-    bool textSet = false;       // 是否显式设置了字符组
+    CommandLineOptions options;
     
     // 解析命令行参数
-    if (!parseArguments(argc, argv, inputTexts, frequency, delay, frequencySet, delaySet, textSet)) {
+    if (!parseArguments(argc, argv, options)) {
         printUsage(argv[0]);
         return 1;
     }
     
     // 如果没有指定任何字符组，使用默认值
-    if (!textSet || inputTexts.empty()) {
-        inputTexts.clear();
-        inputTexts.push_back("test");
+    if (!options.textSet || options.texts.empty()) {
+        options.texts.clear();
+        options.texts.push_back("test");
+    }
+    
+#ifdef __linux__
+    // SIGINT/SIGTERM由模拟器的事件循环通过signalfd接收，需要在创建任何线程之前屏蔽；
+    // 录制模式仍使用普通的信号处理函数
+    if (options.recordPath.empty()) {
+        EventLoop::blockSignals({SIGINT, SIGTERM});
+    }
+#endif
+
+#ifndef __linux__
+    if (!options.displays.empty()) {
+        std::cerr << "错误: 指定X显示器仅支持Linux" << std::endl;
+        return 1;
+    }
+#endif
+    if (options.displays.size() > 1 && (options.autotune || !options.latencySocket.empty() || !options.recordPath.empty())) {
+        std::cerr << "错误: --autotune、--latency 和 --record 只支持一个显示器" << std::endl;
+        return 1;
     }
     
-    // 根据设置情况确定最终的延迟值
-    // 逻辑：同时设置时以频率为准，单独设置时使用对应值
-    if (frequencySet) {
-        // 如果设置了频率，以频率为准（计算延迟）
-        if (frequency > 0) {
-            delay = static_cast<int>(1000.0 / frequency);
+    if (!options.typingSources.empty() && (options.autotune || !options.latencySocket.empty() || !options.recordPath.empty())) {
+        std::cerr << "错误: --typing-model 不能与 --autotune、--latency 或 --record 同时使用" << std::endl;
+        return 1;
+    }
+    
+    if (options.autotune) {
+        return runAutotune(options);
+    }
+    if (!options.latencySocket.empty()) {
+        return runLatencyHarness(options);
+    }
+    if (!options.recordPath.empty()) {
+        return runRecorder(options);
+    }
+    
+    // 根据设置情况确定最终的周期
+    // 逻辑：同时设置时以频率为准，单独设置时使用对应值；
+    // 频率直接以小数传给模拟器，不再截断为整数毫秒
+    bool useFrequency = options.frequencySet || !options.delaySet;
+    if (useFrequency && options.frequency <= 0) {
+        std::cerr << "错误: 输入频率必须大于0" << std::endl;
+        return 1;
+    }
+    double periodMs = useFrequency ? 1000.0 / options.frequency : static_cast<double>(options.delay);
+    bool typing = !options.typingSources.empty();
+    if (typing && periodMs <= 0) {
+        std::cerr << "错误: 使用打字模型时输入周期必须大于0" << std::endl;
+        return 1;
+    }
+    // 没有指定频率时按训练样本的节奏输入（训练了按键轨迹时）
+    bool typingRhythm = typing && !options.frequencySet && !options.delaySet;
+    
+    // 负载曲线：解析后一次性生成所有到达时间
+    std::shared_ptr<RateProfile> profile;
+    if (!options.profileSpec.empty() || !options.profileFile.empty()) {
+        profile = std::make_shared<RateProfile>();
+        if ((!options.profileFile.empty() && !profile->load(options.profileFile)) ||
+            (!options.profileSpec.empty() && !profile->parse(options.profileSpec))) {
+            return 1;
         }
-    } else if (delaySet) {
-        // 如果只设置了延迟，使用延迟值（频率保持默认或无效）
-        // delay 已经通过参数设置，不需要修改
-    } else {
-        // 如果都没有设置，使用默认值（frequency=10.0, delay=100）
-        // 此时需要同步：如果使用默认频率，计算对应的延迟
-        if (frequency > 0) {
-            delay = static_cast<int>(1000.0 / frequency);
+        if (profile->empty()) {
+            std::cerr << "错误: 负载曲线没有任何阶段" << std::endl;
+            return 1;
+        }
+        profile->compile(options.seed != 0 ? options.seed : std::random_device{}());
+    }
+    
+    // 语料库：映射文件并建立行索引，文本不复制
+    std::shared_ptr<TextCorpus> corpus;
+    double corpusLoadMs = 0;
+    if (!options.corpusPath.empty()) {
+        auto loadStart = std::chrono::steady_clock::now();
+        corpus = std::make_shared<TextCorpus>();
+        if (!corpus->open(options.corpusPath)) {
+            return 1;
+        }
+        corpusLoadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    }
+    
+    // 按键轨迹：映射文件后流式解码，定位借助文件中的索引
+    std::shared_ptr<TraceReader> trace;
+    if (!options.replayPath.empty()) {
+        trace = std::make_shared<TraceReader>();
+        if (!trace->open(options.replayPath)) {
+            return 1;
+        }
+        if (trace->codeType() != TraceHeader::nativeCodeType()) {
+            std::cerr << "错误: 轨迹中的键码类型（" << TraceHeader::codeTypeName(trace->codeType())
+                      << "）与本平台不符（" << TraceHeader::codeTypeName(TraceHeader::nativeCodeType()) << "）" << std::endl;
+            return 1;
+        }
+        if (options.replayFromSec > 0) {
+            trace->seek(static_cast<int64_t>(options.replayFromSec * 1e9));
+        }
+        if (options.workers > 1) {
+            std::cout << "提示: 回放按键轨迹时只使用1个工作线程" << std::endl;
+            options.workers = 1;
+        }
+    }
+    
+    // 场景脚本：启动时解析一次，由模拟器按键盘映射编译为指令数组
+    std::shared_ptr<Scenario> scenario;
+    if (!options.scenarioPath.empty()) {
+        if (trace) {
+            std::cerr << "错误: --scenario 不能与 --replay 同时使用" << std::endl;
+            return 1;
+        }
+        scenario = std::make_shared<Scenario>();
+        if (!scenario->load(options.scenarioPath)) {
+            return 1;
+        }
+        if (scenario->empty()) {
+            std::cerr << "错误: 场景没有任何语句" << std::endl;
+            return 1;
+        }
+        if (profile) {
+            std::cout << "提示: 按场景输入时忽略负载曲线" << std::endl;
+            profile.reset();
+        }
+        if (options.workers > 1 && options.targets.empty()) {
+            std::cout << "提示: 执行场景时只使用1个工作线程" << std::endl;
+            options.workers = 1;
+        }
+    }
+    
+    // 按住模式：按住的键来自字符组，同一个键不能被两个工作线程同时按下
+    std::shared_ptr<HoldModel> holdModel;
+    if (!options.holdSpec.empty()) {
+        if (trace || scenario || corpus) {
+            std::cerr << "错误: --hold 不能与 --replay、--scenario 或 --corpus 同时使用" << std::endl;
+            return 1;
+        }
+        holdModel = std::make_shared<HoldModel>();
+        if (!holdModel->parse(options.holdSpec)) {
+            return 1;
+        }
+        if (options.workers > 1 && options.targets.empty()) {
+            std::cout << "提示: 按住模式只使用1个工作线程" << std::endl;
+            options.workers = 1;
+        }
+    }
+    
+    // 打字模型：逐字符生成，间隔由模型决定，不能与其他决定输入内容或时间的模式组合
+    if (typing && (trace || scenario || corpus || holdModel || profile)) {
+        std::cerr << "错误: --typing-model 不能与 --replay、--scenario、--corpus、--hold 或负载曲线同时使用" << std::endl;
+        return 1;
+    }
+    
+    // 鼠标事件：与普通输入和按住模式的按键并行注入，由第一个工作线程调度
+    std::shared_ptr<PointerStorm> pointerStorm;
+    if (!options.mouseSpec.empty()) {
+        if (trace || scenario) {
+            std::cerr << "错误: --mouse 不能与 --replay 或 --scenario 同时使用" << std::endl;
+            return 1;
+        }
+        if (!options.targets.empty()) {
+            std::cerr << "错误: --mouse 不能与 --target 同时使用（定向注入不发送鼠标事件）" << std::endl;
+            return 1;
+        }
+        pointerStorm = std::make_shared<PointerStorm>();
+        if (!pointerStorm->parse(options.mouseSpec)) {
+            return 1;
+        }
+    }
+    
+    // 多个显示器：每个显示器一个工作线程，有自己的X连接和调度器，各自执行完整的输入
+    if (options.displays.size() > 1) {
+        if (trace) {
+            std::cerr << "错误: 指定多个显示器时不能使用 --replay" << std::endl;
+            return 1;
+        }
+        if (!options.targets.empty()) {
+            std::cerr << "错误: --target 只能用于一个显示器" << std::endl;
+            return 1;
+        }
+        if (options.workers > 1) {
+            std::cout << "提示: 驱动多个显示器时每个显示器一个工作线程，忽略 --workers" << std::endl;
+        }
+        options.workers = options.displays.size();
+    }
+    
+    // 定向注入：启动时在窗口树中查找所有匹配的窗口，每个窗口一个工作线程
+#ifdef __linux__
+    std::vector<TargetWindow> targetWindows;
+#endif
+    if (!options.targets.empty()) {
+#ifdef __linux__
+        if (trace) {
+            std::cerr << "错误: --target 不能与 --replay 同时使用" << std::endl;
+            return 1;
+        }
+        Display* display = XOpenDisplay(options.displays.empty() ? nullptr : options.displays.front().c_str());
+        if (!display) {
+            std::cerr << "错误: 无法连接到X服务器，无法查找目标窗口" << std::endl;
+            return 1;
+        }
+        WindowFinder::installErrorHandler();
+        WindowFinder finder(display);
+        for (const TargetSpec& target : options.targets) {
+            if (finder.find(target, targetWindows) == 0) {
+                std::cerr << "警告: 没有找到匹配的窗口: " << target.describe() << std::endl;
+            }
+        }
+        XCloseDisplay(display);
+        if (targetWindows.empty()) {
+            std::cerr << "错误: 没有找到任何目标窗口" << std::endl;
+            return 1;
+        }
+        if (options.workers > 1) {
+            std::cout << "提示: 定向注入时每个目标窗口一个工作线程，忽略 --workers" << std::endl;
         }
+        options.workers = targetWindows.size();
+#else
+        std::cerr << "错误: 定向注入仅支持Linux" << std::endl;
+        return 1;
+#endif
     }
+#ifndef __linux__
+    if (!options.controlPath.empty()) {
+        std::cerr << "错误: 控制套接字仅支持Linux" << std::endl;
+        return 1;
+    }
+#endif
+    
+    // 非原生后端没有可供点击的目标，总是立即开始输入
+    bool autoStart = options.autoStart || options.backend != KeyboardSimulator::OutputBackend::Native;
     
     std::cout << "========================================" << std::endl;
     std::cout << "   键盘输入压力测试工具" << std::endl;
     std::cout << "========================================" << std::endl;
-    std::cout << "输入字符组数量: " << inputTexts.size() << std::endl;
-    for (size_t i = 0; i < inputTexts.size(); i++) {
-        std::cout << "  字符组 " << (i + 1) << ": \"" << inputTexts[i] << "\"" << std::endl;
+    if (trace) {
+        std::cout << "按键轨迹: " << options.replayPath << "（" << trace->eventCount() << " 个事件，时长 "
+                  << std::fixed << std::setprecision(1) << trace->durationNs() / 1e9 << " 秒，平均 "
+                  << std::setprecision(2) << trace->eventRate() << " 次/秒）" << std::endl;
+        std::cout << "回放速度: " << std::defaultfloat << options.replaySpeed << "x";
+        if (options.replayFromSec > 0) {
+            std::cout << "，从第 " << options.replayFromSec << " 秒开始";
+        }
+        std::cout << std::endl;
+    } else if (typing) {
+        std::cout << "打字模型: " << options.ngramOrder << " 阶，训练文件:";
+        for (const std::string& source : options.typingSources) {
+            std::cout << " " << source;
+        }
+        std::cout << std::endl;
+    } else if (corpus) {
+        std::cout << "语料库: " << options.corpusPath << "（" << corpus->size() << " 个字符组，"
+                  << std::fixed << std::setprecision(1) << corpus->byteSize() / 1048576.0 << " MB，"
+                  << (corpus->isWeighted() ? "按权重抽取" : "均匀抽取") << "，索引耗时 "
+                  << corpusLoadMs << " 毫秒）" << std::endl;
+    } else {
+        std::cout << "输入字符组数量: " << options.texts.size() << std::endl;
+        for (size_t i = 0; i < options.texts.size(); i++) {
+            std::cout << "  字符组 " << (i + 1) << ": \"" << options.texts[i] << "\"" << std::endl;
+        }
+    }
+#ifdef __linux__
+    if (!targetWindows.empty()) {
+        std::cout << "定向注入: " << targetWindows.size() << " 个目标窗口（XSendEvent）" << std::endl;
+        for (const TargetWindow& target : targetWindows) {
+            std::cout << "  0x" << std::hex << target.window << std::dec;
+            if (!target.name.empty()) {
+                std::cout << " \"" << target.name << "\"";
+            }
+            if (target.frequency > 0) {
+                std::cout << "，" << target.frequency << " 次/秒";
+            }
+            std::cout << std::endl;
+        }
+    }
+#endif
+    if (options.displays.size() > 1) {
+        std::cout << "显示器: " << options.displays.size() << " 个（每个显示器一个工作线程，各自执行完整的输入）:";
+        for (const std::string& display : options.displays) {
+            std::cout << " " << display;
+        }
+        std::cout << std::endl;
+    } else if (!options.displays.empty()) {
+        std::cout << "显示器: " << options.displays.front() << std::endl;
+    }
+    if (scenario) {
+        std::cout << "场景: " << options.scenarioPath << "（" << scenario->statementCount() << " 条语句）" << std::endl;
+    }
+    if (profile && !trace) {
+        std::cout << "负载曲线: " << profile->phaseCount() << " 个阶段，共 " << std::fixed << std::setprecision(1)
+                  << profile->durationSec() << " 秒，" << profile->arrivalCount() << " 次输入（平均 "
+                  << std::setprecision(2) << profile->averageRate() << " 次/秒）" << std::endl;
+        for (size_t i = 0; i < profile->phaseCount(); i++) {
+            std::cout << "  阶段 " << (i + 1) << ": " << std::defaultfloat
+                      << RateProfile::describe(profile->phase(i)) << std::endl;
+        }
+    } else if (typingRhythm) {
+        std::cout << "输入频率: 按训练样本的节奏（没有计时样本时 " << std::fixed << std::setprecision(2)
+                  << options.frequency << " 次/秒）" << std::endl;
+    } else if (!trace && !scenario) {
+        if (useFrequency) {
+            std::cout << "输入频率: " << std::fixed << std::setprecision(2) << options.frequency << " 次/秒" << std::endl;
+        }
+        std::cout << "输入周期: " << std::fixed << std::setprecision(3) << periodMs << " 毫秒" << std::endl;
+    }
+    if (holdModel) {
+        std::cout << "按住模式: 最多同时按住 " << options.overlap << " 个键，按住时长 "
+                  << holdModel->componentCount() << " 个分量等概率抽取" << std::endl;
+        for (size_t i = 0; i < holdModel->componentCount(); i++) {
+            std::cout << "  分量 " << (i + 1) << ": " << std::defaultfloat
+                      << HoldModel::describe(holdModel->component(i)) << std::endl;
+        }
+    }
+    if (pointerStorm) {
+        std::cout << "鼠标事件:";
+        for (size_t kind = 0; kind < PointerStorm::KindCount; kind++) {
+            std::cout << (kind == 0 ? " " : "，") << PointerStorm::kindName(static_cast<PointerStorm::Kind>(kind)) << " "
+                      << std::fixed << std::setprecision(2) << pointerStorm->rate(static_cast<PointerStorm::Kind>(kind))
+                      << " 次/秒";
+        }
+        std::cout << std::endl;
+    }
+    if (options.spinUs > 0) {
+        std::cout << "自旋阈值: " << options.spinUs << " 微秒" << std::endl;
+    }
+    if (options.realtime.enabled) {
+        std::cout << "实时模式: " << options.realtime.describe() << std::endl;
+    }
+    if (options.batchSize == 0) {
+        std::cout << "批量发送: 每个周期一批" << std::endl;
+    } else if (options.batchSize > 1) {
+        std::cout << "批量发送: 每批 " << options.batchSize << " 个事件" << std::endl;
+    }
+    std::cout << "错过周期策略: " << (options.missPolicy == DeadlineScheduler::MissPolicy::Drop ? "丢弃" : "追赶") << std::endl;
+    bool sharedWorkers = options.targets.empty() && options.displays.size() <= 1;
+    if (sharedWorkers && options.workers > 1 && profile) {
+        std::cout << "工作线程: " << options.workers << "（轮流分配输入）" << std::endl;
+    } else if (sharedWorkers && options.workers > 1 && typingRhythm) {
+        std::cout << "工作线程: " << options.workers << "（平均分配频率）" << std::endl;
+    } else if (sharedWorkers && options.workers > 1) {
+        std::cout << "工作线程: " << options.workers << "（每个线程 " << std::setprecision(2)
+                  << (useFrequency ? options.frequency : 1000.0 / periodMs) / options.workers << " 次/秒）" << std::endl;
+    }
+    if (!options.controlPath.empty()) {
+        std::cout << "控制套接字: " << options.controlPath << std::endl;
+    }
+    if (!options.metricsPath.empty()) {
+        std::cout << "指标输出: " << options.metricsPath << "（每 " << std::setprecision(1)
+                  << options.metricsInterval << " 秒）" << std::endl;
+    }
+    if (options.durationSec > 0) {
+        std::cout << "运行时长: " << std::setprecision(1) << options.durationSec << " 秒" << std::endl;
+    }
+    if (holdModel) {
+        std::cout << "随机模式: 每个周期从字符组中随机选择一个未按住的键" << std::endl;
+    } else if (typing) {
+        std::cout << "随机模式: 按打字模型逐字符生成，按键间隔按双字母的分布抽取" << std::endl;
+    } else if (!trace && !scenario) {
+        std::cout << "随机模式: 每个周期随机选择一个字符组" << std::endl;
     }
-    std::cout << "输入频率: " << std::fixed << std::setprecision(2) << frequency << " 次/秒" << std::endl;
-    std::cout << "输入延迟: " << delay << " 毫秒" << std::endl;
-    std::cout << "随机模式: 每个周期随机选择一个字符组" << std::endl;
     std::cout << "========================================" << std::endl;
     std::cout << std::endl;
     
-    KeyboardSimulator simulator;
-    // 添加所有字符组
-    for (const auto& text : inputTexts) {
-        simulator.addInputText(text);
+    KeyboardSimulator simulator(options.displays);
+    simulator.setOutputBackend(options.backend, options.ringCapacity);
+    
+    // 打字模型：按键轨迹按模拟器加载的键盘映射还原字符，在创建模拟器之后训练
+    if (typing) {
+        auto trainStart = std::chrono::steady_clock::now();
+        auto typingModel = std::make_shared<TypingModel>(options.ngramOrder);
+        std::shared_ptr<const KeyMap> keyMap = simulator.keyMap();
+        for (const std::string& source : options.typingSources) {
+            if (!typingModel->trainFile(source, *keyMap)) {
+                return 1;
+            }
+        }
+        if (!typingModel->compile()) {
+            return 1;
+        }
+        double trainMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - trainStart).count();
+        std::cout << "打字模型训练: " << typingModel->trainedChars() << " 个字符，" << typingModel->symbolCount()
+                  << " 个符号，" << typingModel->stateCount() << " 个上下文，" << typingModel->timingSamples()
+                  << " 个计时样本（" << typingModel->digraphTableCount() << " 个双字母有单独的分布），耗时 "
+                  << std::fixed << std::setprecision(1) << trainMs << " 毫秒" << std::endl;
+        if (typingRhythm && typingModel->trainedTiming()) {
+            options.frequency = 1e9 / typingModel->meanIntervalNs();
+            std::cout << "输入频率: 按训练样本的节奏，平均 " << std::setprecision(2) << options.frequency << " 次/秒" << std::endl;
+        }
+        size_t skipped = simulator.setTypingModel(typingModel);
+        if (skipped > 0) {
+            std::cerr << "警告: 打字模型中有 " << skipped << " 个字符在当前键盘映射中无法输入，生成时跳过" << std::endl;
+        }
+    }
+    
+    // 添加所有字符组（使用语料库或打字模型时由它们代替）
+    if (corpus) {
+        simulator.setCorpus(corpus);
+    } else if (!typing) {
+        for (const auto& text : options.texts) {
+            simulator.addInputText(text);
+        }
+    }
+    if (useFrequency) {
+        simulator.setInputFrequency(options.frequency);
+    } else {
+        simulator.setInputDelay(options.delay);
+    }
+    simulator.setSpinThreshold(options.spinUs);
+    simulator.setMissPolicy(options.missPolicy);
+    simulator.setRealtime(options.realtime);
+    simulator.setBatchSize(options.batchSize);
+    simulator.setWorkerCount(options.workers);
+#ifdef __linux__
+    simulator.setTargets(targetWindows);
+#endif
+    simulator.setRateProfile(profile);
+    simulator.setReplayTrace(trace, options.replaySpeed);
+    if (scenario && !simulator.setScenario(scenario)) {
+        return 1;
     }
-    simulator.setInputDelay(delay);
+    if (holdModel) {
+        simulator.setHoldModel(holdModel, options.overlap, options.seed != 0 ? options.seed : std::random_device{}());
+    }
+    simulator.setPointerStorm(pointerStorm);
+    simulator.setMetricsOutput(options.metricsPath, options.metricsInterval);
+#ifdef __linux__
+    simulator.setControlSocket(options.controlPath);
+#endif
+    simulator.setAutoStart(autoStart);
     
 #ifdef _WIN32
     // 设置控制台处理程序，用于捕获 Ctrl+C
@@ -171,15 +1196,32 @@ int main(int argc, char* argv[]) {
     simulator.start();
     
     std::cout << "程序运行中... 按 ESC 键退出" << std::endl;
-    std::cout << "提示: 左键开始/继续，右键暂停" << std::endl;
+    if (!autoStart && pointerStorm) {
+        std::cout << "提示: Pause 键开始/暂停/继续（注入鼠标事件时鼠标点击不控制输入）" << std::endl;
+    } else if (!autoStart) {
+        std::cout << "提示: 左键开始/继续，右键暂停，或按 Pause 键" << std::endl;
+    }
     
-    // 主循环
+    // 主循环：在事件循环中等待监听、控制命令和信号，没有运行时长时不设超时；
+    // 工作线程执行完时会唤醒事件循环
+    auto startTime = std::chrono::steady_clock::now();
+    auto endTime = startTime + std::chrono::duration<double>(options.durationSec);
     while (simulator.isRunning() && !simulator.shouldExit()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (simulator.isFinished()) {
+            std::cout << (trace ? "按键轨迹已回放完" : (scenario ? "场景已执行完" : "负载曲线已执行完"))
+                      << "，退出程序..." << std::endl;
+            break;
+        }
+        
+        simulator.waitForEvents(options.durationSec > 0 ? remainingUntil(endTime) : std::chrono::milliseconds(-1));
+        
+        if (options.durationSec > 0 && std::chrono::steady_clock::now() >= endTime) {
+            std::cout << "已达到运行时长，退出程序..." << std::endl;
+            break;
+        }
     }
     
     simulator.stop();
     
     return 0;
 }
-
@@ -0,0 +1,178 @@
+#include "mapped_file.h"
+#include <iostream>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+MappedFile::MappedFile()
+    : m_data(nullptr)
+    , m_size(0)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    
+#ifdef _WIN32
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        std::cerr << "错误: 无法打开文件: " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+        std::cerr << "错误: 文件为空: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        std::cerr << "错误: 无法映射文件: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        std::cerr << "错误: 无法映射文件: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_size = static_cast<uint64_t>(fileSize.QuadPart);
+#elif __linux__
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "错误: 无法打开文件 " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size == 0) {
+        std::cerr << "错误: 文件为空: " << path << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "错误: 无法映射文件 " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    m_data = static_cast<const char*>(mapped);
+    m_size = static_cast<uint64_t>(info.st_size);
+#endif
+    return m_data != nullptr;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+#elif __linux__
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), static_cast<size_t>(m_size));
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool MappedFile::isOpen() const {
+    return m_data != nullptr;
+}
+
+const char* MappedFile::data() const {
+    return m_data;
+}
+
+uint64_t MappedFile::size() const {
+    return m_size;
+}
+
+void MappedFile::advise(Access access) {
+#ifdef __linux__
+    if (!m_data) {
+        return;
+    }
+    int advice = MADV_NORMAL;
+    if (access == Access::Sequential) {
+        advice = MADV_SEQUENTIAL;
+    } else if (access == Access::Random) {
+        advice = MADV_RANDOM;
+    }
+    madvise(const_cast<char*>(m_data), static_cast<size_t>(m_size), advice);
+#else
+    (void)access;
+#endif
+}
+
+void MappedFile::willNeed(uint64_t offset, uint64_t length) {
+    if (!alignRange(offset, length)) {
+        return;
+    }
+#ifdef __linux__
+    madvise(const_cast<char*>(m_data + offset), static_cast<size_t>(length), MADV_WILLNEED);
+#endif
+    // Windows下映射视图依赖FILE_FLAG_SEQUENTIAL_SCAN和缺页时的预读
+}
+
+void MappedFile::release(uint64_t offset, uint64_t length) {
+    if (!alignRange(offset, length)) {
+        return;
+    }
+#ifdef _WIN32
+    // 对未锁定的页调用VirtualUnlock会把它们移出工作集
+    VirtualUnlock(const_cast<char*>(m_data + offset), static_cast<SIZE_T>(length));
+#elif __linux__
+    // 只读的文件映射没有脏页，丢弃后再访问会从页缓存/文件重新读入
+    madvise(const_cast<char*>(m_data + offset), static_cast<size_t>(length), MADV_DONTNEED);
+#endif
+}
+
+size_t MappedFile::pageSize() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return static_cast<size_t>(info.dwPageSize);
+#elif __linux__
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+bool MappedFile::alignRange(uint64_t& offset, uint64_t& length) const {
+    if (!m_data || offset >= m_size || length == 0) {
+        return false;
+    }
+    uint64_t aligned = offset & ~static_cast<uint64_t>(pageSize() - 1);
+    length += offset - aligned;
+    offset = aligned;
+    if (length > m_size - offset) {
+        length = m_size - offset;
+    }
+    return true;
+}
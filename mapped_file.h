@@ -0,0 +1,67 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/**
+ * 只读内存映射文件
+ * 语料库和按键轨迹都通过它访问文件内容，不复制到堆上；
+ * 顺序扫描的大文件可以提前预读前方的页、释放已经读过的页，常驻内存不随文件大小增长
+ */
+class MappedFile {
+public:
+    // 访问模式提示
+    enum class Access {
+        Normal,
+        Sequential,     // 顺序读取，内核加大预读
+        Random          // 随机读取，关闭预读
+    };
+    
+    MappedFile();
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    // 映射整个文件，失败（包括空文件）时返回false并输出错误
+    bool open(const std::string& path);
+    
+    // 解除映射
+    void close();
+    
+    bool isOpen() const;
+    const char* data() const;
+    uint64_t size() const;
+    
+    // 设置整个映射的访问模式提示
+    void advise(Access access);
+    
+    // 提示内核提前读入[offset, offset + length)（异步，不阻塞）
+    void willNeed(uint64_t offset, uint64_t length);
+    
+    // 释放[offset, offset + length)占用的物理页，之后再访问会重新从文件读取
+    void release(uint64_t offset, uint64_t length);
+    
+    // 页大小（willNeed/release的范围会按页对齐）
+    static size_t pageSize();
+
+private:
+    // 把范围的起点向下对齐到页边界并裁剪到映射内，范围为空时返回false
+    bool alignRange(uint64_t& offset, uint64_t& length) const;
+
+private:
+    const char* m_data;                 // 映射区域
+    uint64_t m_size;                    // 映射大小
+#ifdef _WIN32
+    HANDLE m_file;                      // 文件句柄
+    HANDLE m_mapping;                   // 映射句柄
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,227 @@
+#include "metrics_reporter.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+
+namespace {
+    const double Quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    
+    bool endsWith(const std::string& text, const std::string& suffix) {
+        return text.size() >= suffix.size() &&
+               text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+    
+    // 输出一个Prometheus指标的HELP/TYPE头
+    void promHeader(std::ostringstream& out, const char* name, const char* type, const char* help) {
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " " << type << "\n";
+    }
+    
+    // 工作线程的标签，驱动多个显示器时附带display标签
+    std::string workerLabels(const MetricsSnapshot& snapshot, size_t index) {
+        std::string labels = "worker=\"" + std::to_string(index) + "\"";
+        if (!snapshot.workers[index].display.empty()) {
+            labels += ",display=\"" + snapshot.workers[index].display + "\"";
+        }
+        return labels;
+    }
+    
+    // 按工作线程输出一个计数器，worker="all"为合计
+    template <typename Getter>
+    void promCounter(std::ostringstream& out, const MetricsSnapshot& snapshot, const char* name,
+                     const char* help, double scale, Getter getter) {
+        promHeader(out, name, "counter", help);
+        for (size_t i = 0; i < snapshot.workers.size(); i++) {
+            out << name << "{" << workerLabels(snapshot, i) << "} " << getter(snapshot.workers[i]) * scale << "\n";
+        }
+        out << name << "{worker=\"all\"} " << getter(snapshot.total) * scale << "\n";
+    }
+    
+    void jsonSample(std::ostringstream& out, const MetricsSample& sample) {
+        const LatencyHistogram& lateness = sample.lateness;
+        out << "{";
+        if (!sample.display.empty()) {
+            out << "\"display\":\"" << sample.display << "\",";
+        }
+        out << "\"cycles\":" << sample.cyclesCompleted
+            << ",\"deadline_misses\":" << sample.deadlinesMissed
+            << ",\"cycles_dropped\":" << sample.cyclesDropped
+            << ",\"keys_sent\":" << sample.eventsSent
+            << ",\"requests\":" << sample.requestsSent
+            << ",\"flushes\":" << sample.flushCount
+            << ",\"lock_wait_ns\":" << sample.lockWaitNs
+            << ",\"lock_hold_ns\":" << sample.lockHoldNs
+            << ",\"keycode_remaps\":" << sample.keycodeRemaps
+            << ",\"lateness_ns\":{\"count\":" << lateness.count()
+            << ",\"p50\":" << lateness.percentile(50.0)
+            << ",\"p90\":" << lateness.percentile(90.0)
+            << ",\"p99\":" << lateness.percentile(99.0)
+            << ",\"p999\":" << lateness.percentile(99.9)
+            << ",\"max\":" << lateness.max() << "}}";
+    }
+}
+
+void MetricsSample::merge(const MetricsSample& other) {
+    cyclesCompleted += other.cyclesCompleted;
+    deadlinesMissed += other.deadlinesMissed;
+    cyclesDropped += other.cyclesDropped;
+    eventsSent += other.eventsSent;
+    requestsSent += other.requestsSent;
+    flushCount += other.flushCount;
+    lockWaitNs += other.lockWaitNs;
+    lockHoldNs += other.lockHoldNs;
+    keycodeRemaps += other.keycodeRemaps;
+    lateness.merge(other.lateness);
+}
+
+double MetricsSnapshot::achievedRate() const {
+    return elapsedSec > 0 ? static_cast<double>(total.cyclesCompleted) / elapsedSec : 0.0;
+}
+
+std::string MetricsSnapshot::toPrometheus() const {
+    std::ostringstream out;
+    out << std::setprecision(12);
+    
+    promHeader(out, "keyboard_stress_info", "gauge", "Output backend of the running generator.");
+    out << "keyboard_stress_info{backend=\"" << backend << "\"} 1\n";
+    promHeader(out, "keyboard_stress_elapsed_seconds", "gauge", "Seconds since input started.");
+    out << "keyboard_stress_elapsed_seconds " << elapsedSec << "\n";
+    promHeader(out, "keyboard_stress_requested_rate", "gauge", "Requested input cycles per second.");
+    out << "keyboard_stress_requested_rate " << requestedRate << "\n";
+    promHeader(out, "keyboard_stress_achieved_rate", "gauge", "Completed input cycles per second.");
+    out << "keyboard_stress_achieved_rate " << achievedRate() << "\n";
+    
+    promCounter(out, *this, "keyboard_stress_keys_sent_total", "Key events handed to the backend.", 1.0,
+                [](const MetricsSample& s) { return static_cast<double>(s.eventsSent); });
+    promCounter(out, *this, "keyboard_stress_requests_total", "Requests issued to the backend.", 1.0,
+                [](const MetricsSample& s) { return static_cast<double>(s.requestsSent); });
+    promCounter(out, *this, "keyboard_stress_flushes_total", "Backend flushes.", 1.0,
+                [](const MetricsSample& s) { return static_cast<double>(s.flushCount); });
+    promCounter(out, *this, "keyboard_stress_cycles_total", "Completed input cycles.", 1.0,
+                [](const MetricsSample& s) { return static_cast<double>(s.cyclesCompleted); });
+    promCounter(out, *this, "keyboard_stress_deadline_misses_total", "Slots started after their deadline.", 1.0,
+                [](const MetricsSample& s) { return static_cast<double>(s.deadlinesMissed); });
+    promCounter(out, *this, "keyboard_stress_cycles_dropped_total", "Cycles skipped by the drop policy.", 1.0,
+                [](const MetricsSample& s) { return static_cast<double>(s.cyclesDropped); });
+    promCounter(out, *this, "keyboard_stress_lock_wait_seconds_total", "Time spent waiting for the display mutex.",
+                1e-9, [](const MetricsSample& s) { return static_cast<double>(s.lockWaitNs); });
+    promCounter(out, *this, "keyboard_stress_lock_hold_seconds_total",
+                "Time spent holding the display mutex, including XFlush.", 1e-9,
+                [](const MetricsSample& s) { return static_cast<double>(s.lockHoldNs); });
+    promCounter(out, *this, "keyboard_stress_keycode_remaps_total",
+                "Keyboard mapping changes made to type characters missing from the layout.", 1.0,
+                [](const MetricsSample& s) { return static_cast<double>(s.keycodeRemaps); });
+    
+    promHeader(out, "keyboard_stress_schedule_lateness_seconds", "summary",
+               "Wake-up time past each slot deadline.");
+    for (size_t i = 0; i <= workers.size(); i++) {
+        const MetricsSample& sample = i < workers.size() ? workers[i] : total;
+        std::string labels = i < workers.size() ? workerLabels(*this, i) : "worker=\"all\"";
+        for (double q : Quantiles) {
+            out << "keyboard_stress_schedule_lateness_seconds{" << labels << ",quantile=\"" << q << "\"} "
+                << sample.lateness.percentile(q * 100.0) * 1e-9 << "\n";
+        }
+        out << "keyboard_stress_schedule_lateness_seconds_sum{" << labels << "} "
+            << sample.lateness.mean() * static_cast<double>(sample.lateness.count()) * 1e-9 << "\n";
+        out << "keyboard_stress_schedule_lateness_seconds_count{" << labels << "} "
+            << sample.lateness.count() << "\n";
+    }
+    return out.str();
+}
+
+std::string MetricsSnapshot::toJson() const {
+    std::ostringstream out;
+    out << std::setprecision(12);
+    out << "{\"backend\":\"" << backend << "\""
+        << ",\"elapsed_seconds\":" << elapsedSec
+        << ",\"requested_rate\":" << requestedRate
+        << ",\"achieved_rate\":" << achievedRate()
+        << ",\"total\":";
+    jsonSample(out, total);
+    out << ",\"workers\":[";
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (i > 0) {
+            out << ",";
+        }
+        jsonSample(out, workers[i]);
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+MetricsReporter::MetricsReporter()
+    : m_interval(std::chrono::seconds(5))
+    , m_stopping(false)
+{
+}
+
+MetricsReporter::~MetricsReporter() {
+    stop();
+}
+
+void MetricsReporter::start(const std::string& path, std::chrono::milliseconds interval, Collector collector) {
+    if (m_thread.joinable() || path.empty() || !collector) {
+        return;
+    }
+    m_path = path;
+    m_interval = interval.count() > 0 ? interval : std::chrono::milliseconds(1000);
+    m_collector = collector;
+    m_stopping = false;
+    m_thread = std::thread(&MetricsReporter::run, this);
+}
+
+void MetricsReporter::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_all();
+    try {
+        m_thread.join();
+    } catch (...) {
+        // 忽略join异常
+    }
+}
+
+bool MetricsReporter::isRunning() const {
+    return m_thread.joinable();
+}
+
+void MetricsReporter::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        m_wakeup.wait_for(lock, m_interval, [this] { return m_stopping; });
+        
+        // 采集和写文件时不持有锁，stop()可以随时设置标志
+        lock.unlock();
+        writeSnapshot(m_collector());
+        lock.lock();
+    }
+}
+
+bool MetricsReporter::writeSnapshot(const MetricsSnapshot& snapshot) const {
+    std::string content = endsWith(m_path, ".json") ? snapshot.toJson() : snapshot.toPrometheus();
+    std::string tempPath = m_path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::out | std::ios::trunc);
+        if (!file) {
+            std::cerr << "无法写入指标文件: " << tempPath << std::endl;
+            return false;
+        }
+        file << content;
+        if (!file.flush()) {
+            std::cerr << "无法写入指标文件: " << tempPath << std::endl;
+            return false;
+        }
+    }
+    if (std::rename(tempPath.c_str(), m_path.c_str()) != 0) {
+        std::cerr << "无法更新指标文件: " << m_path << std::endl;
+        return false;
+    }
+    return true;
+}
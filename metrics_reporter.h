@@ -0,0 +1,93 @@
+#ifndef METRICS_REPORTER_H
+#define METRICS_REPORTER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+#include "latency_histogram.h"
+
+/**
+ * 一个工作线程（或合计）的输入路径指标
+ */
+struct MetricsSample {
+    uint64_t cyclesCompleted = 0;   // 已完成周期数
+    uint64_t deadlinesMissed = 0;   // 错过截止时间次数
+    uint64_t cyclesDropped = 0;     // 丢弃周期数
+    uint64_t eventsSent = 0;        // 已发送按键事件数
+    uint64_t requestsSent = 0;      // 已发送请求数
+    uint64_t flushCount = 0;        // 提交次数
+    uint64_t lockWaitNs = 0;        // 等待连接互斥锁的累计时间
+    uint64_t lockHoldNs = 0;        // 持有连接互斥锁的累计时间（含XFlush）
+    uint64_t keycodeRemaps = 0;     // 为输入Unicode字符修改键盘映射的次数
+    LatencyHistogram lateness;      // 调度延迟（醒来时间相对截止时间）
+    std::string display;            // 工作线程注入的X显示器（只在驱动多个显示器时设置，不参与累加）
+    
+    // 累加另一个样本
+    void merge(const MetricsSample& other);
+};
+
+/**
+ * 某一时刻的指标快照
+ * 调度延迟高说明生成端跟不上，锁持有时间高说明写入X连接受阻（目标端处理不过来）
+ */
+struct MetricsSnapshot {
+    std::string backend;                // 输出后端名称
+    double elapsedSec = 0;              // 从开始输入到快照时刻的时长
+    double requestedRate = 0;           // 请求的频率（次/秒，所有工作线程合计）
+    std::vector<MetricsSample> workers; // 各工作线程
+    MetricsSample total;                // 合计
+    
+    // 实际达到的频率（完成周期数/时长）
+    double achievedRate() const;
+    
+    // Prometheus文本格式（node_exporter textfile）
+    std::string toPrometheus() const;
+    
+    // JSON格式
+    std::string toJson() const;
+};
+
+/**
+ * 指标输出线程
+ * 每隔固定时间采集一次快照并写入文件（先写临时文件再rename，读取方不会看到半个文件），
+ * 文件扩展名为.json时输出JSON，否则输出Prometheus文本格式
+ */
+class MetricsReporter {
+public:
+    using Collector = std::function<MetricsSnapshot()>;
+    
+    MetricsReporter();
+    ~MetricsReporter();
+    
+    // 启动输出线程
+    void start(const std::string& path, std::chrono::milliseconds interval, Collector collector);
+    
+    // 停止输出线程，并写入最后一次快照
+    void stop();
+    
+    // 是否已启动
+    bool isRunning() const;
+
+private:
+    // 输出线程主循环
+    void run();
+    
+    // 原子地写入一次快照
+    bool writeSnapshot(const MetricsSnapshot& snapshot) const;
+
+private:
+    std::string m_path;                     // 输出文件路径
+    std::chrono::milliseconds m_interval;   // 输出间隔
+    Collector m_collector;                  // 快照采集函数
+    std::thread m_thread;                   // 输出线程
+    std::mutex m_mutex;                     // 保护m_stopping
+    std::condition_variable m_wakeup;       // 停止时唤醒输出线程
+    bool m_stopping;                        // 是否正在停止
+};
+
+#endif // METRICS_REPORTER_H
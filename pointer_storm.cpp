@@ -0,0 +1,223 @@
+#include "pointer_storm.h"
+#include <iostream>
+#include <sstream>
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    // 圆周移动的步数和半径（像素），每转一圈指针回到原处
+    const size_t MotionSteps = 16;
+    const double MotionRadius = 8.0;
+    
+    const double Pi = 3.14159265358979323846;
+    
+    // 核心协议的按钮编号：1为左键，4/5为滚轮上/下
+    const uint16_t LeftButton = 1;
+    const uint16_t WheelUpButton = 4;
+    const uint16_t WheelDownButton = 5;
+    
+    // 去掉首尾空白
+    std::string trim(const std::string& text) {
+        size_t begin = text.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        size_t end = text.find_last_not_of(" \t\r\n");
+        return text.substr(begin, end - begin + 1);
+    }
+    
+    // 按分隔符拆分
+    std::vector<std::string> split(const std::string& text, char separator) {
+        std::vector<std::string> parts;
+        std::stringstream stream(text);
+        std::string part;
+        while (std::getline(stream, part, separator)) {
+            parts.push_back(trim(part));
+        }
+        return parts;
+    }
+    
+    // 解析非负数，失败时返回false
+    bool parseNumber(const std::string& text, double& value) {
+        try {
+            size_t used = 0;
+            value = std::stod(text, &used);
+            return used == text.size() && value >= 0;
+        } catch (...) {
+            return false;
+        }
+    }
+    
+    // 圆周上相邻两点的整数位移：由取整后的坐标相减得到，一圈的位移之和恰好为0
+    const std::array<uint16_t, MotionSteps>& motionDeltas() {
+        static const std::array<uint16_t, MotionSteps> deltas = [] {
+            std::array<uint16_t, MotionSteps> table = {};
+            auto angle = [](size_t step) { return 2.0 * Pi * static_cast<double>(step) / MotionSteps; };
+            auto x = [&](size_t step) { return static_cast<int>(std::lround(MotionRadius * std::cos(angle(step)))); };
+            auto y = [&](size_t step) { return static_cast<int>(std::lround(MotionRadius * std::sin(angle(step)))); };
+            for (size_t i = 0; i < MotionSteps; i++) {
+                int dx = x(i + 1) - x(i);
+                int dy = y(i + 1) - y(i);
+                table[i] = static_cast<uint16_t>(static_cast<uint8_t>(static_cast<int8_t>(dx)) |
+                                                 (static_cast<uint8_t>(static_cast<int8_t>(dy)) << 8));
+            }
+            return table;
+        }();
+        return deltas;
+    }
+}
+
+PointerStorm::PointerStorm()
+    : m_rates{}
+{
+}
+
+bool PointerStorm::parse(const std::string& specs) {
+    for (const std::string& spec : split(specs, ',')) {
+        if (spec.empty()) {
+            continue;
+        }
+        std::vector<std::string> fields = split(spec, ':');
+        double rate = 0;
+        if (fields.size() != 2 || !parseNumber(fields[1], rate)) {
+            std::cerr << "错误: 鼠标事件格式应为 类别:频率: " << spec << std::endl;
+            return false;
+        }
+        if (fields[0] == "move") {
+            m_rates[Motion] = rate;
+        } else if (fields[0] == "click") {
+            m_rates[Click] = rate;
+        } else if (fields[0] == "scroll") {
+            m_rates[Scroll] = rate;
+        } else {
+            std::cerr << "错误: 未知的鼠标事件类别: " << fields[0] << "（可选 move/click/scroll）" << std::endl;
+            return false;
+        }
+    }
+    if (empty()) {
+        std::cerr << "错误: 鼠标事件的频率不能都为0" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool PointerStorm::empty() const {
+    return std::all_of(std::begin(m_rates), std::end(m_rates), [](double rate) { return rate <= 0; });
+}
+
+double PointerStorm::rate(Kind kind) const {
+    return m_rates[kind];
+}
+
+const char* PointerStorm::kindName(Kind kind) {
+    switch (kind) {
+        case Motion:
+            return "移动";
+        case Click:
+            return "点击";
+        case Scroll:
+            return "滚轮";
+        default:
+            return "未知";
+    }
+}
+
+PointerTimeline::PointerTimeline()
+    : m_streams{}
+    , m_next(DeadlineScheduler::TimePoint::max())
+    , m_motionStep(0)
+    , m_randomGenerator(std::random_device{}())
+{
+    for (auto& count : m_counts) {
+        count = 0;
+    }
+}
+
+void PointerTimeline::reset(const PointerStorm& storm, DeadlineScheduler::TimePoint start) {
+    for (size_t i = 0; i < PointerStorm::KindCount; i++) {
+        double rate = storm.rate(static_cast<PointerStorm::Kind>(i));
+        m_streams[i].periodNs = rate > 0 ? std::max<int64_t>(1, static_cast<int64_t>(1e9 / rate + 0.5)) : 0;
+        m_streams[i].start = start;
+        m_streams[i].index = 0;
+    }
+    updateNext();
+}
+
+bool PointerTimeline::active() const {
+    return m_next != DeadlineScheduler::TimePoint::max();
+}
+
+DeadlineScheduler::TimePoint PointerTimeline::nextDeadline() const {
+    return m_next;
+}
+
+DeadlineScheduler::TimePoint PointerTimeline::deadlineOf(const Stream& stream, uint64_t index) {
+    return stream.start + DeadlineScheduler::Duration(stream.periodNs * static_cast<int64_t>(index));
+}
+
+void PointerTimeline::updateNext() {
+    m_next = DeadlineScheduler::TimePoint::max();
+    for (const Stream& stream : m_streams) {
+        if (stream.periodNs > 0) {
+            m_next = std::min(m_next, deadlineOf(stream, stream.index));
+        }
+    }
+}
+
+void PointerTimeline::appendEvent(PointerStorm::Kind kind, std::vector<TimedKeyEvent>& batch) {
+    const uint8_t press = static_cast<uint8_t>(KeyEvent::Pointer | KeyEvent::Press);
+    const uint8_t release = KeyEvent::Pointer;
+    switch (kind) {
+        case PointerStorm::Motion:
+            batch.push_back(TimedKeyEvent{KeyEvent{0, motionDeltas()[m_motionStep], release}, 0});
+            m_motionStep = (m_motionStep + 1) % MotionSteps;
+            break;
+        case PointerStorm::Click:
+            batch.push_back(TimedKeyEvent{KeyEvent{LeftButton, 0, press}, 0});
+            batch.push_back(TimedKeyEvent{KeyEvent{LeftButton, 0, release}, 0});
+            break;
+        case PointerStorm::Scroll: {
+            uint16_t button = (m_randomGenerator() & 1) ? WheelUpButton : WheelDownButton;
+            batch.push_back(TimedKeyEvent{KeyEvent{button, 0, press}, 0});
+            batch.push_back(TimedKeyEvent{KeyEvent{button, 0, release}, 0});
+            break;
+        }
+        default:
+            return;
+    }
+    m_counts[kind].fetch_add(1, std::memory_order_relaxed);
+}
+
+void PointerTimeline::collectDue(DeadlineScheduler::TimePoint now, std::vector<TimedKeyEvent>& batch) {
+    for (size_t i = 0; i < PointerStorm::KindCount; i++) {
+        Stream& stream = m_streams[i];
+        if (stream.periodNs <= 0) {
+            continue;
+        }
+        uint64_t caughtUp = 0;
+        while (deadlineOf(stream, stream.index) <= now && caughtUp < MaxCatchUp) {
+            appendEvent(static_cast<PointerStorm::Kind>(i), batch);
+            stream.index++;
+            caughtUp++;
+        }
+        if (deadlineOf(stream, stream.index) <= now) {
+            // 落后太多（如频率高于输出后端的承受能力），其余的周期直接丢弃
+            stream.index = static_cast<uint64_t>((now - stream.start).count() / stream.periodNs) + 1;
+        }
+    }
+    updateNext();
+}
+
+void PointerTimeline::skipTo(DeadlineScheduler::TimePoint now) {
+    for (Stream& stream : m_streams) {
+        if (stream.periodNs > 0 && deadlineOf(stream, stream.index) < now) {
+            stream.index = static_cast<uint64_t>((now - stream.start).count() / stream.periodNs) + 1;
+        }
+    }
+    updateNext();
+}
+
+uint64_t PointerTimeline::count(PointerStorm::Kind kind) const {
+    return m_counts[kind].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,101 @@
+#ifndef POINTER_STORM_H
+#define POINTER_STORM_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+#include "deadline_scheduler.h"
+#include "keystroke_plan.h"
+
+/**
+ * 鼠标事件风暴配置
+ * 与按键并行注入指针移动、左键点击和滚轮事件，每类事件有自己的频率（次/秒）。
+ * 格式为逗号分隔的 类别:频率，如 move:500,click:20,scroll:50
+ */
+class PointerStorm {
+public:
+    // 事件类别
+    enum Kind {
+        Motion,     // 相对移动（沿小圆周，指针不会漂到屏幕边缘）
+        Click,      // 左键按下并释放
+        Scroll,     // 滚轮上或下一格（随机方向）
+        KindCount
+    };
+    
+    PointerStorm();
+    
+    // 解析类别和频率列表，失败时返回false并输出错误
+    bool parse(const std::string& specs);
+    
+    // 所有类别的频率都为0
+    bool empty() const;
+    
+    // 类别的频率（次/秒，0表示不注入）
+    double rate(Kind kind) const;
+    
+    // 类别的中文名称
+    static const char* kindName(Kind kind);
+
+private:
+    double m_rates[KindCount];  // 各类别的频率
+};
+
+/**
+ * 一个工作线程上的鼠标事件时间线
+ * 每类事件的第k个截止时间为 起点 + k × 周期，由起点直接算出，不会累积漂移；
+ * 时间线本身不等待，由输入线程把最近的截止时间和按键的截止时间合并，交给同一个调度器等待。
+ * 事件编码为带Pointer标志的KeyEvent，与按键走同一个输出后端
+ */
+class PointerTimeline {
+public:
+    PointerTimeline();
+    
+    // 按配置的频率从start开始重新调度，频率都为0时时间线不活动
+    void reset(const PointerStorm& storm, DeadlineScheduler::TimePoint start);
+    
+    bool active() const;
+    
+    // 最近一个事件的截止时间（不活动时为TimePoint::max()）
+    DeadlineScheduler::TimePoint nextDeadline() const;
+    
+    // 把截止时间不晚于now的事件追加到batch；每类最多追赶MaxCatchUp个，落后更多时丢弃其余的周期
+    void collectDue(DeadlineScheduler::TimePoint now, std::vector<TimedKeyEvent>& batch);
+    
+    // 跳到now之后的第一个截止时间，保持原有相位（用于暂停恢复）
+    void skipTo(DeadlineScheduler::TimePoint now);
+    
+    // 已注入的事件次数（点击和滚轮按一次计，可在其他线程读取）
+    uint64_t count(PointerStorm::Kind kind) const;
+    
+    // 每类事件一次最多追赶的周期数
+    static const uint64_t MaxCatchUp = 16;
+
+private:
+    // 一类事件的调度状态
+    struct Stream {
+        int64_t periodNs;                       // 周期（0表示不注入）
+        DeadlineScheduler::TimePoint start;     // 起点
+        uint64_t index;                         // 下一个事件的序号
+    };
+    
+    // 第index个截止时间
+    static DeadlineScheduler::TimePoint deadlineOf(const Stream& stream, uint64_t index);
+    
+    // 重新计算最近的截止时间
+    void updateNext();
+    
+    // 追加一个事件
+    void appendEvent(PointerStorm::Kind kind, std::vector<TimedKeyEvent>& batch);
+
+private:
+    Stream m_streams[PointerStorm::KindCount];      // 各类事件
+    DeadlineScheduler::TimePoint m_next;            // 最近的截止时间
+    size_t m_motionStep;                            // 圆周移动的当前步
+    std::mt19937 m_randomGenerator;                 // 滚轮方向
+    std::atomic<uint64_t> m_counts[PointerStorm::KindCount];   // 各类事件的次数
+};
+
+#endif // POINTER_STORM_H
@@ -0,0 +1,286 @@
+#include "rate_profile.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    // 单个负载曲线最多预先生成的到达数（每个8字节）
+    const size_t MaxArrivals = 16 * 1024 * 1024;
+    
+    const double Pi = 3.14159265358979323846;
+    
+    // 去掉首尾空白
+    std::string trim(const std::string& text) {
+        size_t begin = text.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        size_t end = text.find_last_not_of(" \t\r\n");
+        return text.substr(begin, end - begin + 1);
+    }
+    
+    // 按分隔符拆分
+    std::vector<std::string> split(const std::string& text, char separator) {
+        std::vector<std::string> parts;
+        std::stringstream stream(text);
+        std::string part;
+        while (std::getline(stream, part, separator)) {
+            parts.push_back(trim(part));
+        }
+        return parts;
+    }
+    
+    // 解析非负数，失败时返回false
+    bool parseNumber(const std::string& text, double& value) {
+        try {
+            size_t used = 0;
+            value = std::stod(text, &used);
+            return used == text.size() && value >= 0;
+        } catch (...) {
+            return false;
+        }
+    }
+    
+    // 解析时长（秒），支持s/ms后缀
+    bool parseDuration(const std::string& text, double& seconds) {
+        if (text.size() > 2 && text.compare(text.size() - 2, 2, "ms") == 0) {
+            if (!parseNumber(text.substr(0, text.size() - 2), seconds)) {
+                return false;
+            }
+            seconds /= 1000.0;
+            return true;
+        }
+        if (text.size() > 1 && text.back() == 's') {
+            return parseNumber(text.substr(0, text.size() - 1), seconds);
+        }
+        return parseNumber(text, seconds);
+    }
+}
+
+RateProfile::RateProfile() {
+}
+
+bool RateProfile::addPhase(const std::string& spec) {
+    std::vector<std::string> fields = split(spec, ':');
+    if (fields.size() != 3) {
+        std::cerr << "错误: 负载阶段格式应为 形状:时长:参数: " << spec << std::endl;
+        return false;
+    }
+    
+    Phase phase = {Shape::Constant, 0, 0, 0, 0, 0, 1};
+    if (!parseDuration(fields[1], phase.durationSec) || phase.durationSec <= 0) {
+        std::cerr << "错误: 无效的阶段时长: " << fields[1] << std::endl;
+        return false;
+    }
+    
+    const std::string& shape = fields[0];
+    const std::string& params = fields[2];
+    bool valid = false;
+    if (shape == "const") {
+        phase.shape = Shape::Constant;
+        valid = parseNumber(params, phase.rate);
+    } else if (shape == "poisson") {
+        phase.shape = Shape::Poisson;
+        valid = parseNumber(params, phase.rate) && phase.rate > 0;
+    } else if (shape == "ramp") {
+        phase.shape = Shape::Ramp;
+        std::vector<std::string> range = split(params, '-');
+        valid = range.size() == 2 && parseNumber(range[0], phase.rate) && parseNumber(range[1], phase.rateTo);
+    } else if (shape == "step") {
+        phase.shape = Shape::Step;
+        std::vector<std::string> parts = split(params, '/');
+        std::vector<std::string> range = parts.size() == 2 ? split(parts[0], '-') : std::vector<std::string>();
+        double steps = 0;
+        valid = range.size() == 2 && parseNumber(range[0], phase.rate) && parseNumber(range[1], phase.rateTo) &&
+                parseNumber(parts[1], steps) && steps >= 1;
+        phase.steps = static_cast<int>(steps);
+    } else if (shape == "burst") {
+        phase.shape = Shape::Burst;
+        std::vector<std::string> parts = split(params, '/');
+        valid = parts.size() == 3 && parseNumber(parts[0], phase.rate) && parseDuration(parts[1], phase.onSec) &&
+                parseDuration(parts[2], phase.offSec) && phase.onSec > 0;
+    } else if (shape == "sine") {
+        phase.shape = Shape::Sine;
+        std::vector<std::string> parts = split(params, '/');
+        valid = parts.size() == 3 && parseNumber(parts[0], phase.rate) && parseNumber(parts[1], phase.rateTo) &&
+                parseDuration(parts[2], phase.onSec) && phase.onSec > 0;
+    } else {
+        std::cerr << "错误: 未知的负载形状: " << shape << "（可选 const/ramp/step/burst/poisson/sine）" << std::endl;
+        return false;
+    }
+    
+    if (!valid) {
+        std::cerr << "错误: 无效的阶段参数: " << spec << std::endl;
+        return false;
+    }
+    m_phases.push_back(phase);
+    return true;
+}
+
+bool RateProfile::parse(const std::string& specs) {
+    for (const std::string& spec : split(specs, ',')) {
+        if (!spec.empty() && !addPhase(spec)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RateProfile::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "错误: 无法打开负载曲线文件: " << path << std::endl;
+        return false;
+    }
+    
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (!line.empty() && !addPhase(line)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double RateProfile::rateAt(const Phase& phase, double t) {
+    switch (phase.shape) {
+        case Shape::Ramp:
+            return phase.rate + (phase.rateTo - phase.rate) * t / phase.durationSec;
+        case Shape::Step: {
+            if (phase.steps <= 1) {
+                return phase.rate;
+            }
+            int level = std::min(phase.steps - 1, static_cast<int>(t / phase.durationSec * phase.steps));
+            return phase.rate + (phase.rateTo - phase.rate) * level / (phase.steps - 1);
+        }
+        case Shape::Burst:
+            return std::fmod(t, phase.onSec + phase.offSec) < phase.onSec ? phase.rate : 0.0;
+        case Shape::Sine:
+            return phase.rate + phase.rateTo * std::sin(2.0 * Pi * t / phase.onSec);
+        case Shape::Constant:
+        case Shape::Poisson:
+        default:
+            return phase.rate;
+    }
+}
+
+void RateProfile::compile(uint32_t seed) {
+    m_arrivals.clear();
+    std::mt19937_64 generator(seed);
+    double phaseStart = 0;
+    
+    for (const Phase& phase : m_phases) {
+        if (phase.shape == Shape::Poisson) {
+            // 泊松过程：到达间隔服从指数分布
+            double t = 0;
+            std::exponential_distribution<double> interval(phase.rate);
+            while ((t += interval(generator)) < phase.durationSec && m_arrivals.size() < MaxArrivals) {
+                m_arrivals.push_back(static_cast<int64_t>(std::llround((phaseStart + t) * 1e9)));
+            }
+        } else {
+            // 确定性曲线：以固定步长对频率积分，累计满一次即产生一个到达，
+            // 频率为0或很低的区间（突发关闭段、从0开始的爬升）也能正确处理；
+            // 阶段开始时立即到达一次
+            const double step = 1e-4;
+            double credit = 0;
+            for (int64_t i = 0; i * step < phase.durationSec && m_arrivals.size() < MaxArrivals; i++) {
+                double begin = i * step;
+                double length = std::min(step, phase.durationSec - begin);
+                double rate = rateAt(phase, begin + length / 2);
+                if (rate <= 0) {
+                    continue;
+                }
+                double used = 0;
+                while (used + credit / rate <= length && m_arrivals.size() < MaxArrivals) {
+                    used += credit / rate;
+                    credit = 1.0;
+                    m_arrivals.push_back(static_cast<int64_t>(std::llround((phaseStart + begin + used) * 1e9)));
+                }
+                credit -= (length - used) * rate;
+            }
+        }
+        phaseStart += phase.durationSec;
+    }
+    
+    if (m_arrivals.size() >= MaxArrivals) {
+        std::cerr << "警告: 负载曲线的到达数超过 " << MaxArrivals << "，之后的部分被截断" << std::endl;
+    }
+}
+
+std::vector<int64_t> RateProfile::workerIntervals(size_t workerIndex, size_t workerCount, int64_t& phaseNs) const {
+    std::vector<int64_t> intervals;
+    phaseNs = 0;
+    if (workerCount == 0 || workerIndex >= m_arrivals.size()) {
+        return intervals;
+    }
+    
+    // 到达轮流分配给各工作线程：第i个工作线程负责第i、i+N、i+2N...个到达，
+    // 每个周期的长度是到它下一个到达的间隔，最后一个周期延续到曲线结束
+    int64_t endNs = static_cast<int64_t>(std::llround(durationSec() * 1e9));
+    phaseNs = m_arrivals[workerIndex];
+    intervals.reserve(m_arrivals.size() / workerCount + 1);
+    for (size_t k = workerIndex; k < m_arrivals.size(); k += workerCount) {
+        int64_t next = k + workerCount < m_arrivals.size() ? m_arrivals[k + workerCount] : endNs;
+        intervals.push_back(std::max<int64_t>(1, next - m_arrivals[k]));
+    }
+    return intervals;
+}
+
+bool RateProfile::empty() const {
+    return m_phases.empty();
+}
+
+size_t RateProfile::phaseCount() const {
+    return m_phases.size();
+}
+
+const RateProfile::Phase& RateProfile::phase(size_t index) const {
+    return m_phases[index];
+}
+
+size_t RateProfile::arrivalCount() const {
+    return m_arrivals.size();
+}
+
+double RateProfile::durationSec() const {
+    double total = 0;
+    for (const Phase& phase : m_phases) {
+        total += phase.durationSec;
+    }
+    return total;
+}
+
+double RateProfile::averageRate() const {
+    double duration = durationSec();
+    return duration > 0 ? static_cast<double>(m_arrivals.size()) / duration : 0.0;
+}
+
+std::string RateProfile::describe(const Phase& phase) {
+    std::ostringstream out;
+    out << phase.durationSec << " 秒 ";
+    switch (phase.shape) {
+        case Shape::Constant:
+            out << "固定 " << phase.rate << " 次/秒";
+            break;
+        case Shape::Ramp:
+            out << "爬升 " << phase.rate << " -> " << phase.rateTo << " 次/秒";
+            break;
+        case Shape::Step:
+            out << "阶梯 " << phase.rate << " -> " << phase.rateTo << " 次/秒，" << phase.steps << " 级";
+            break;
+        case Shape::Burst:
+            out << "突发 " << phase.rate << " 次/秒，开 " << phase.onSec << " 秒 / 关 " << phase.offSec << " 秒";
+            break;
+        case Shape::Poisson:
+            out << "泊松 平均 " << phase.rate << " 次/秒";
+            break;
+        case Shape::Sine:
+            out << "正弦 " << phase.rate << " ± " << phase.rateTo << " 次/秒，周期 " << phase.onSec << " 秒";
+            break;
+    }
+    return out.str();
+}
@@ -0,0 +1,86 @@
+#ifndef RATE_PROFILE_H
+#define RATE_PROFILE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * 负载曲线
+ * 由若干阶段串联而成，每个阶段描述一段时间内的输入频率变化。
+ * 所有到达时间在开始输入前一次性算好，输入线程只需按顺序读取间隔，
+ * 热循环中没有随机数和浮点运算
+ *
+ * 阶段格式（形状:时长:参数，时长可带s/ms后缀）：
+ *   const:10s:200              固定频率
+ *   ramp:60s:100-2000          线性爬升
+ *   step:60s:100-2000/5        阶梯：从100到2000分5级
+ *   burst:30s:2000/0.5/1.5     突发：2000次/秒持续0.5秒，停1.5秒，循环
+ *   poisson:60s:500            泊松到达（指数分布间隔），平均500次/秒
+ *   sine:60s:500/300/10        正弦调制：平均500，振幅300，周期10秒
+ */
+class RateProfile {
+public:
+    // 阶段形状
+    enum class Shape {
+        Constant,
+        Ramp,
+        Step,
+        Burst,
+        Poisson,
+        Sine
+    };
+    
+    // 一个阶段
+    struct Phase {
+        Shape shape;
+        double durationSec;     // 阶段时长
+        double rate;            // 起始/平均/突发频率
+        double rateTo;          // ramp/step的终止频率，sine的振幅
+        double onSec;           // burst开启时长，sine周期
+        double offSec;          // burst关闭时长
+        int steps;              // step级数
+    };
+    
+    RateProfile();
+    
+    // 追加一个阶段（格式见类说明），失败时返回false并输出错误
+    bool addPhase(const std::string& spec);
+    
+    // 解析逗号分隔的阶段列表
+    bool parse(const std::string& specs);
+    
+    // 从文件读取阶段，每行一个，#开头为注释
+    bool load(const std::string& path);
+    
+    // 按阶段生成所有到达时间（相对起点的纳秒偏移），seed为泊松阶段的随机种子
+    void compile(uint32_t seed);
+    
+    // 第workerIndex个工作线程（共workerCount个，轮流分配到达）的周期序列，
+    // phaseNs返回该工作线程第一个到达的偏移
+    std::vector<int64_t> workerIntervals(size_t workerIndex, size_t workerCount, int64_t& phaseNs) const;
+    
+    bool empty() const;
+    size_t phaseCount() const;
+    const Phase& phase(size_t index) const;
+    
+    // 到达总数、总时长和平均频率（compile之后有效）
+    size_t arrivalCount() const;
+    double durationSec() const;
+    double averageRate() const;
+    
+    // 阶段的可读描述
+    static std::string describe(const Phase& phase);
+
+private:
+    // 某个确定性阶段在阶段内时刻t的瞬时频率
+    static double rateAt(const Phase& phase, double t);
+
+private:
+    std::vector<Phase> m_phases;        // 阶段列表
+    std::vector<int64_t> m_arrivals;    // 所有到达时间（纳秒偏移，单调递增）
+};
+
+#endif // RATE_PROFILE_H
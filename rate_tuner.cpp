@@ -0,0 +1,137 @@
+#include "rate_tuner.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+RateTuner::RateTuner(double startRate, double maxRate, const TuneLimits& limits)
+    : m_limits(limits)
+    , m_maxRate(maxRate)
+    , m_nextRate(std::min(startRate, maxRate))
+    , m_passed(0)
+    , m_failed(0)
+    , m_finished(startRate <= 0 || maxRate <= 0)
+{
+}
+
+double RateTuner::nextRate() const {
+    return m_nextRate;
+}
+
+bool RateTuner::finished() const {
+    return m_finished;
+}
+
+double RateTuner::bestRate() const {
+    return m_passed;
+}
+
+const std::vector<TuneStep>& RateTuner::steps() const {
+    return m_steps;
+}
+
+bool RateTuner::evaluate(TuneStep& step) const {
+    std::ostringstream reason;
+    reason << std::fixed << std::setprecision(2);
+    if (step.achievedRate < step.rate * m_limits.minAchievedRatio) {
+        reason << "实际频率只有 " << step.achievedRate << " 次/秒";
+    } else if (step.latency.count() > 0 &&
+               step.latency.percentile(99.0) > static_cast<int64_t>(m_limits.maxLatencyMs * 1e6)) {
+        reason << "p99延迟 " << step.latency.percentile(99.0) / 1e6 << " 毫秒";
+    } else if (step.sent > 0 &&
+               static_cast<double>(step.lost) * 100.0 > m_limits.maxLossPercent * static_cast<double>(step.sent)) {
+        reason << "丢失 " << static_cast<double>(step.lost) * 100.0 / static_cast<double>(step.sent) << "%";
+    } else {
+        return true;
+    }
+    step.reason = reason.str();
+    return false;
+}
+
+void RateTuner::record(TuneStep step) {
+    if (m_finished) {
+        return;
+    }
+    step.passed = evaluate(step);
+    if (step.passed) {
+        m_passed = std::max(m_passed, step.rate);
+    } else {
+        m_failed = m_failed > 0 ? std::min(m_failed, step.rate) : step.rate;
+    }
+    double rate = step.rate;
+    m_steps.push_back(std::move(step));
+    
+    if (m_failed == 0) {
+        // 还没有失败：翻倍直到上限
+        m_finished = rate >= m_maxRate;
+        m_nextRate = std::min(rate * 2.0, m_maxRate);
+    } else {
+        // 在最高通过和最低失败之间二分；起始频率就失败时向下减半
+        double low = std::min(m_passed, m_failed);
+        m_finished = m_failed - low <= m_failed * Precision || m_failed <= 1.0;
+        m_nextRate = (low + m_failed) / 2.0;
+    }
+    if (m_steps.size() >= MaxSteps) {
+        m_finished = true;
+    }
+}
+
+#ifdef __linux__
+RoundTripProbe::RoundTripProbe()
+    : m_display(nullptr)
+    , m_interval(10)
+    , m_running(false)
+{
+}
+
+RoundTripProbe::~RoundTripProbe() {
+    stop();
+}
+
+bool RoundTripProbe::start(std::chrono::milliseconds interval) {
+    if (m_running) {
+        return true;
+    }
+    m_display = XOpenDisplay(nullptr);
+    if (!m_display) {
+        return false;
+    }
+    m_interval = interval;
+    m_running = true;
+    m_thread = std::thread(&RoundTripProbe::sampleLoop, this);
+    return true;
+}
+
+void RoundTripProbe::stop() {
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    XCloseDisplay(m_display);
+    m_display = nullptr;
+}
+
+LatencyHistogram RoundTripProbe::take() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    LatencyHistogram histogram = m_histogram;
+    m_histogram.reset();
+    return histogram;
+}
+
+void RoundTripProbe::sampleLoop() {
+    while (m_running) {
+        // 连接只由本线程使用，不需要加锁
+        auto begin = std::chrono::steady_clock::now();
+        XSync(m_display, False);
+        int64_t roundTrip = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_histogram.record(roundTrip);
+        }
+        std::this_thread::sleep_for(m_interval);
+    }
+}
+#endif
@@ -0,0 +1,118 @@
+#ifndef RATE_TUNER_H
+#define RATE_TUNER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "latency_histogram.h"
+
+#ifdef __linux__
+#include <X11/Xlib.h>
+#endif
+
+/**
+ * 自动调优的判定条件
+ * 一个频率只有同时满足所有条件才算可持续
+ */
+struct TuneLimits {
+    double maxLatencyMs = 10.0;     // p99延迟上限（毫秒，接收端确认延迟或XSync往返时间）
+    double maxLossPercent = 0.1;    // 丢失比例上限（百分比，只在有接收端确认时判定）
+    double minAchievedRatio = 0.95; // 实际频率至少达到请求频率的比例（低于说明发送端已被阻塞）
+};
+
+/**
+ * 一个频率的测量结果
+ */
+struct TuneStep {
+    double rate = 0;                // 请求频率（次/秒）
+    double achievedRate = 0;        // 实际频率（次/秒）
+    LatencyHistogram latency;       // 延迟分布（接收端确认或XSync往返）
+    uint64_t sent = 0;              // 发送的按键数（有接收端时）
+    uint64_t lost = 0;              // 丢失的按键数（有接收端时）
+    bool passed = false;            // 是否满足判定条件
+    std::string reason;             // 未通过的原因
+};
+
+/**
+ * 最大可持续频率搜索
+ * 先从起始频率开始逐步翻倍，直到某个频率不满足条件（乘性增加，快速找到上界）；
+ * 之后在最高通过和最低失败的频率之间二分，区间缩小到精度以内时结束。
+ * 每一步的测量由调用方完成，本类只负责判定和选择下一个频率
+ */
+class RateTuner {
+public:
+    // 区间相对宽度小于此值时结束
+    static constexpr double Precision = 0.05;
+    
+    // 最多测量的频率数
+    static const size_t MaxSteps = 24;
+    
+    RateTuner(double startRate, double maxRate, const TuneLimits& limits);
+    
+    // 下一个要测量的频率
+    double nextRate() const;
+    
+    // 是否已收敛（或达到最大频率、最大步数）
+    bool finished() const;
+    
+    // 判定一个测量结果并更新搜索区间
+    void record(TuneStep step);
+    
+    // 满足条件的最高频率（没有任何频率通过时为0）
+    double bestRate() const;
+    
+    const std::vector<TuneStep>& steps() const;
+
+private:
+    // 判定是否满足条件，不满足时填写原因
+    bool evaluate(TuneStep& step) const;
+
+private:
+    TuneLimits m_limits;            // 判定条件
+    double m_maxRate;               // 搜索上限
+    double m_nextRate;              // 下一个测量的频率
+    double m_passed;                // 已通过的最高频率（0表示没有）
+    double m_failed;                // 已失败的最低频率（0表示还没有失败）
+    bool m_finished;                // 是否已结束
+    std::vector<TuneStep> m_steps;  // 所有测量结果
+};
+
+#ifdef __linux__
+/**
+ * XSync往返时间探针
+ * 使用独立的X连接，按固定间隔计时XSync。X服务器按客户端轮流处理请求，
+ * 注入连接积压时其他客户端的往返时间也随之升高，可作为没有接收端时的背压信号
+ */
+class RoundTripProbe {
+public:
+    RoundTripProbe();
+    ~RoundTripProbe();
+    
+    // 打开X连接并启动采样线程，失败时返回false
+    bool start(std::chrono::milliseconds interval);
+    
+    // 停止采样线程并关闭连接
+    void stop();
+    
+    // 取出当前的往返时间分布并清空
+    LatencyHistogram take();
+
+private:
+    // 采样线程
+    void sampleLoop();
+
+private:
+    Display* m_display;                 // 探针专用连接
+    std::chrono::milliseconds m_interval;   // 采样间隔
+    std::mutex m_mutex;                 // 保护m_histogram
+    LatencyHistogram m_histogram;       // 往返时间分布
+    std::atomic<bool> m_running;        // 采样线程是否运行
+    std::thread m_thread;               // 采样线程
+};
+#endif
+
+#endif // RATE_TUNER_H
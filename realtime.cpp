@@ -0,0 +1,192 @@
+#include "realtime.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+namespace {
+    // 解析内核格式的CPU列表（"0-3,8,10-11"），失败时返回false
+    bool parseCpuList(const std::string& text, std::vector<int>& cpus) {
+        std::stringstream input(text);
+        std::string item;
+        while (std::getline(input, item, ',')) {
+            item.erase(std::remove_if(item.begin(), item.end(), ::isspace), item.end());
+            if (item.empty()) {
+                continue;
+            }
+            try {
+                size_t dash = item.find('-');
+                size_t used = 0;
+                int first = std::stoi(item.substr(0, dash), &used);
+                if (used != (dash == std::string::npos ? item.size() : dash)) {
+                    return false;
+                }
+                int last = first;
+                if (dash != std::string::npos) {
+                    std::string tail = item.substr(dash + 1);
+                    last = std::stoi(tail, &used);
+                    if (used != tail.size()) {
+                        return false;
+                    }
+                }
+                if (first < 0 || last < first) {
+                    return false;
+                }
+                for (int cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(cpu);
+                }
+            } catch (...) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool RealtimeOptions::parseCpus(const std::string& list) {
+    std::vector<int> parsed;
+    if (!parseCpuList(list, parsed) || parsed.empty()) {
+        std::cerr << "错误: 无效的CPU列表: " << list << std::endl;
+        return false;
+    }
+    cpus = parsed;
+    return true;
+}
+
+std::string RealtimeOptions::describe() const {
+    std::ostringstream text;
+    text << "SCHED_FIFO 优先级 " << priority << "，CPU ";
+    if (cpus.empty()) {
+        text << "自动选择";
+    } else {
+        for (size_t i = 0; i < cpus.size(); i++) {
+            text << (i > 0 ? "," : "") << cpus[i];
+        }
+    }
+    text << "，mlockall，timerfd";
+    return text.str();
+}
+
+std::vector<int> Realtime::isolatedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    std::ifstream file("/sys/devices/system/cpu/isolated");
+    std::string line;
+    if (file && std::getline(file, line) && !parseCpuList(line, cpus)) {
+        cpus.clear();
+    }
+#endif
+    return cpus;
+}
+
+int Realtime::workerCpu(const RealtimeOptions& options, size_t workerIndex) {
+    if (!options.cpus.empty()) {
+        return options.cpus[workerIndex % options.cpus.size()];
+    }
+    std::vector<int> isolated = isolatedCpus();
+    if (!isolated.empty()) {
+        return isolated[workerIndex % isolated.size()];
+    }
+#ifdef __linux__
+    // 没有隔离的CPU时避开0号CPU（多数中断和系统线程在低编号CPU上），从最大编号倒序选择
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        std::vector<int> candidates;
+        for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                candidates.push_back(cpu);
+            }
+        }
+        if (!candidates.empty()) {
+            return candidates[workerIndex % candidates.size()];
+        }
+    }
+#endif
+    return -1;
+}
+
+void Realtime::checkPermissions(const RealtimeOptions& options) {
+#ifdef __linux__
+    // SCHED_FIFO需要root、CAP_SYS_NICE或足够的RLIMIT_RTPRIO；能力无法简单查询，这里只给出提示，
+    // 是否生效以工作线程实际设置的结果为准
+    rlimit limit;
+    bool privileged = geteuid() == 0;
+    if (!privileged && getrlimit(RLIMIT_RTPRIO, &limit) == 0 &&
+        limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < static_cast<rlim_t>(options.priority)) {
+        std::cerr << "警告: RLIMIT_RTPRIO为 " << limit.rlim_cur << "，低于优先级 " << options.priority
+                  << "，没有CAP_SYS_NICE时工作线程将保持普通调度" << std::endl;
+    }
+    if (!privileged && getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        std::cerr << "提示: RLIMIT_MEMLOCK为 " << limit.rlim_cur / 1024
+                  << " KB，只锁定启动时已有的内存，超出限制时不锁定" << std::endl;
+    }
+    if (options.cpus.empty() && isolatedCpus().empty()) {
+        std::cerr << "提示: 没有内核隔离的CPU（isolcpus），工作线程绑定到编号最大的CPU，仍可能与其他任务共享" << std::endl;
+    }
+#else
+    (void)options;
+    std::cerr << "警告: 实时模式仅支持Linux，忽略 --realtime" << std::endl;
+#endif
+}
+
+bool Realtime::lockMemory() {
+#ifdef __linux__
+    // 内存锁定受限时只锁定现有内存：锁定之后的分配在超出限制时会直接失败
+    rlimit limit;
+    bool unlimited = geteuid() == 0 ||
+                     (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY);
+    if (mlockall(MCL_CURRENT | (unlimited ? MCL_FUTURE : 0)) != 0) {
+        std::cerr << "警告: mlockall失败（" << std::strerror(errno) << "），内存未锁定" << std::endl;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+RealtimeStatus Realtime::applyToCurrentThread(const RealtimeOptions& options, size_t workerIndex) {
+    RealtimeStatus status;
+#ifdef __linux__
+    int cpu = workerCpu(options, workerIndex);
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error == 0) {
+            status.cpu = cpu;
+        } else {
+            std::cerr << "警告: 工作线程 " << workerIndex << " 无法绑定到CPU " << cpu
+                      << "（" << std::strerror(error) << "）" << std::endl;
+        }
+    }
+    
+    sched_param param = {};
+    param.sched_priority = std::min(std::max(options.priority, sched_get_priority_min(SCHED_FIFO)),
+                                    sched_get_priority_max(SCHED_FIFO));
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error == 0) {
+        status.fifo = true;
+    } else {
+        std::cerr << "警告: 工作线程 " << workerIndex << " 无法使用SCHED_FIFO（" << std::strerror(error)
+                  << "），保持普通调度" << std::endl;
+    }
+#else
+    (void)options;
+    (void)workerIndex;
+#endif
+    return status;
+}
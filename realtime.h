@@ -0,0 +1,57 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * 实时运行选项
+ * 启用后每个工作线程以SCHED_FIFO优先级运行并绑定到一个CPU，进程内存被锁定，
+ * 截止时间由绝对时间的timerfd唤醒，减少负载机上的抢占和缺页带来的时序抖动
+ */
+struct RealtimeOptions {
+    bool enabled = false;       // 是否启用实时模式
+    int priority = 80;          // SCHED_FIFO优先级（1-99）
+    std::vector<int> cpus;      // 绑定的CPU，工作线程依次使用（为空时自动选择）
+    
+    // 解析CPU列表（如 "2,3" 或 "2-5,8"），失败时返回false并输出错误
+    bool parseCpus(const std::string& list);
+    
+    // 可读描述
+    std::string describe() const;
+};
+
+/**
+ * 一个工作线程实际生效的实时设置
+ */
+struct RealtimeStatus {
+    bool fifo = false;          // SCHED_FIFO是否生效
+    int cpu = -1;               // 绑定的CPU（-1表示未绑定）
+    bool timerFd = false;       // 是否由timerfd唤醒
+};
+
+/**
+ * 实时运行支持
+ * 权限不足时每一项都单独退回默认行为并输出警告，不会中断运行
+ */
+class Realtime {
+public:
+    // 检查实时调度、内存锁定的权限和可用的隔离CPU，输出缺少的部分（启动时调用一次）
+    static void checkPermissions(const RealtimeOptions& options);
+    
+    // 锁定进程当前（内存锁定不受限制时也包括之后）的所有内存页，失败时返回false并输出警告
+    static bool lockMemory();
+    
+    // 把调用线程设为SCHED_FIFO并绑定到第workerIndex个工作线程的CPU
+    static RealtimeStatus applyToCurrentThread(const RealtimeOptions& options, size_t workerIndex);
+    
+    // 第workerIndex个工作线程使用的CPU：指定列表优先，其次是内核隔离的CPU，
+    // 都没有时从允许集合中编号最大的CPU开始倒序选择；无法确定时返回-1
+    static int workerCpu(const RealtimeOptions& options, size_t workerIndex);
+    
+    // 内核隔离的CPU（isolcpus，读取/sys/devices/system/cpu/isolated）
+    static std::vector<int> isolatedCpus();
+};
+
+#endif // REALTIME_H
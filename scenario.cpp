@@ -0,0 +1,558 @@
+#include "scenario.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <X11/keysym.h>
+#endif
+
+namespace {
+    // type和group默认的字符间隔
+    const int64_t DefaultIntervalNs = 10 * 1000 * 1000;
+    
+    // 去掉首尾空白
+    std::string trim(const std::string& text) {
+        size_t begin = text.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        size_t end = text.find_last_not_of(" \t\r\n");
+        return text.substr(begin, end - begin + 1);
+    }
+    
+    // 去掉行尾注释，引号内的#不算注释
+    std::string stripComment(const std::string& line) {
+        bool quoted = false;
+        for (size_t i = 0; i < line.size(); i++) {
+            if (quoted && line[i] == '\\') {
+                i++;
+            } else if (line[i] == '"') {
+                quoted = !quoted;
+            } else if (line[i] == '#' && !quoted) {
+                return line.substr(0, i);
+            }
+        }
+        return line;
+    }
+    
+    // 解析带引号的文本并处理转义，引号外不能有其他内容
+    bool parseQuoted(const std::string& text, std::string& value) {
+        if (text.size() < 2 || text.front() != '"' || text.back() != '"') {
+            return false;
+        }
+        value.clear();
+        for (size_t i = 1; i + 1 < text.size(); i++) {
+            char c = text[i];
+            if (c == '"') {
+                return false;
+            }
+            if (c == '\\') {
+                if (++i + 1 >= text.size()) {
+                    return false;
+                }
+                switch (text[i]) {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'b': c = '\b'; break;
+                    case '"': c = '"'; break;
+                    case '\\': c = '\\'; break;
+                    default: return false;
+                }
+            }
+            value.push_back(c);
+        }
+        return true;
+    }
+    
+    // 解析时长（纳秒），支持s/ms/us后缀，没有后缀时为秒
+    bool parseDuration(const std::string& text, int64_t& ns) {
+        double scale = 1e9;
+        std::string number = text;
+        if (text.size() > 2 && text.compare(text.size() - 2, 2, "ms") == 0) {
+            scale = 1e6;
+            number = text.substr(0, text.size() - 2);
+        } else if (text.size() > 2 && text.compare(text.size() - 2, 2, "us") == 0) {
+            scale = 1e3;
+            number = text.substr(0, text.size() - 2);
+        } else if (text.size() > 1 && text.back() == 's') {
+            number = text.substr(0, text.size() - 1);
+        }
+        try {
+            size_t used = 0;
+            double value = std::stod(number, &used);
+            if (used != number.size() || value < 0) {
+                return false;
+            }
+            ns = static_cast<int64_t>(value * scale + 0.5);
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+    
+    // 解析正整数
+    bool parseCount(const std::string& text, uint32_t& count) {
+        try {
+            size_t used = 0;
+            unsigned long value = std::stoul(text, &used);
+            if (used != text.size() || value == 0 || value > 0xffffffffUL) {
+                return false;
+            }
+            count = static_cast<uint32_t>(value);
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+    
+    // 解析出的按键
+    struct ResolvedKey {
+        uint16_t code;          // 键码或UTF-16码元
+        uint16_t modifiers;     // 需要同时按下的修饰键掩码
+    };
+    
+#ifdef _WIN32
+    // Windows按UTF-16码元输入（KEYEVENTF_UNICODE），只支持单个字符和常用键的简写，不支持修饰键
+    bool resolveKey(const std::string& name, const KeyMap& keymap, ResolvedKey& key) {
+        (void)keymap;
+        key.modifiers = 0;
+        if (name == "enter" || name == "Return") {
+            key.code = '\r';
+        } else if (name == "tab" || name == "Tab") {
+            key.code = '\t';
+        } else if (name == "backspace" || name == "BackSpace") {
+            key.code = '\b';
+        } else if (name == "space") {
+            key.code = ' ';
+        } else {
+            wchar_t wide[2] = {};
+            int length = MultiByteToWideChar(CP_UTF8, 0, name.data(), static_cast<int>(name.size()), wide, 2);
+            if (length != 1) {
+                return false;
+            }
+            key.code = static_cast<uint16_t>(wide[0]);
+        }
+        return true;
+    }
+#elif __linux__
+    // 键名转换为KeySym，无法识别时返回NoSymbol
+    KeySym keysymOf(const std::string& name) {
+        static const struct {
+            const char* alias;
+            KeySym keysym;
+        } aliases[] = {
+            {"shift", XK_Shift_L},
+            {"ctrl", XK_Control_L},
+            {"control", XK_Control_L},
+            {"alt", XK_Alt_L},
+            {"super", XK_Super_L},
+            {"enter", XK_Return},
+            {"esc", XK_Escape},
+            {"space", XK_space},
+            {"tab", XK_Tab},
+            {"backspace", XK_BackSpace},
+        };
+        for (const auto& entry : aliases) {
+            if (name == entry.alias) {
+                return entry.keysym;
+            }
+        }
+        // 可打印ASCII字符的KeySym与字符值相同
+        if (name.size() == 1 && name[0] >= 32 && name[0] <= 126) {
+            return static_cast<KeySym>(name[0]);
+        }
+        return XStringToKeysym(name.c_str());
+    }
+    
+    bool resolveKey(const std::string& name, const KeyMap& keymap, ResolvedKey& key) {
+        KeySym keysym = keysymOf(name);
+        KeyMap::Binding binding;
+        if (keysym == NoSymbol || !keymap.lookup(keysym, binding)) {
+            return false;
+        }
+        for (int mod = 0; mod < 8; mod++) {
+            if ((binding.modifiers & (1u << mod)) && keymap.modifierKeycode(mod) == 0) {
+                return false;
+            }
+        }
+        key.code = binding.keycode;
+        key.modifiers = binding.modifiers;
+        return true;
+    }
+#endif
+    
+    /**
+     * 场景编译器
+     * 按顺序把语句展开为指令，跟踪当前字符间隔、按住的修饰键和循环嵌套
+     */
+    class ScenarioCompiler {
+    public:
+        ScenarioCompiler(const KeyMap& keymap, size_t groupCount, bool hasCorpus, ScenarioProgram& program)
+            : m_keymap(keymap)
+            , m_groupCount(groupCount)
+            , m_hasCorpus(hasCorpus)
+            , m_program(program)
+            , m_intervalNs(DefaultIntervalNs)
+            , m_heldModifiers(0)
+        {
+        }
+        
+        bool compile(const Scenario::Statement& statement) {
+            switch (statement.command) {
+                case Scenario::Command::Type:
+                    return compileType(statement);
+                case Scenario::Command::Interval:
+                    m_intervalNs = statement.durationNs;
+                    return true;
+                case Scenario::Command::Press:
+                case Scenario::Command::Down:
+                case Scenario::Command::Up:
+                case Scenario::Command::Chord:
+                    return compileKeys(statement);
+                case Scenario::Command::Wait:
+                    emitWait(statement.durationNs);
+                    return true;
+                case Scenario::Command::Group:
+                    // 不存在的字符组在运行时什么也不输入，在编译时拒绝
+                    if (statement.random && m_groupCount == 0 && !m_hasCorpus) {
+                        std::cerr << "错误: 场景第 " << statement.line << " 行: group random 需要至少一个字符组或语料库" << std::endl;
+                        return false;
+                    }
+                    if (!statement.random && statement.count >= m_groupCount) {
+                        std::cerr << "错误: 场景第 " << statement.line << " 行: 字符组 " << statement.count
+                                  << " 不存在（共 " << m_groupCount << " 个字符组，编号从0开始）" << std::endl;
+                        return false;
+                    }
+                    emit(statement.random ? ScenarioInstruction::RandomGroup : ScenarioInstruction::Group,
+                         statement.count, m_intervalNs);
+                    if (m_intervalNs > 0) {
+                        markAdvancing();
+                    }
+                    return true;
+                case Scenario::Command::Repeat:
+                    m_loops.push_back(Loop{m_program.instructions.size(), statement.count, false, multiplier()});
+                    emit(ScenarioInstruction::LoopBegin, statement.count, 0);
+                    return true;
+                case Scenario::Command::End:
+                    return compileEnd(statement);
+            }
+            return false;
+        }
+        
+        void finish() {
+            emit(ScenarioInstruction::End, 0, 0);
+        }
+    
+    private:
+        // 一层正在编译的循环
+        struct Loop {
+            size_t begin;           // LoopBegin指令的位置
+            uint32_t count;         // 次数（0表示无限）
+            bool advances;          // 循环体是否会推进时钟
+            uint64_t multiplier;    // 进入循环前的执行次数倍数
+        };
+        
+        // 当前语句执行一遍对应的执行次数（无限循环按一次计）
+        uint64_t multiplier() const {
+            if (m_loops.empty()) {
+                return 1;
+            }
+            const Loop& loop = m_loops.back();
+            return loop.multiplier * (loop.count > 0 ? loop.count : 1);
+        }
+        
+        void emit(uint8_t op, uint32_t operand, int64_t durationNs) {
+            ScenarioInstruction instruction = {};
+            instruction.op = op;
+            instruction.operand = operand;
+            instruction.durationNs = durationNs;
+            m_program.instructions.push_back(instruction);
+        }
+        
+        void emitKey(uint16_t code, bool press) {
+            ScenarioInstruction instruction = {};
+            instruction.op = ScenarioInstruction::Key;
+            instruction.event = KeyEvent{code, m_heldModifiers, static_cast<uint8_t>(press ? KeyEvent::Press : 0)};
+            m_program.instructions.push_back(instruction);
+            m_program.eventsPerPass += multiplier();
+        }
+        
+        void emitWait(int64_t durationNs) {
+            emit(ScenarioInstruction::Wait, 0, durationNs);
+            m_program.durationNs += durationNs * static_cast<int64_t>(multiplier());
+            if (durationNs > 0) {
+                markAdvancing();
+            }
+        }
+        
+        void markAdvancing() {
+            for (Loop& loop : m_loops) {
+                loop.advances = true;
+            }
+        }
+        
+        // 按下的是修饰键时更新修饰键掩码，之后事件的modifiers随之变化
+        void updateHeldModifiers(uint16_t code, bool press) {
+#ifdef __linux__
+            for (int mod = 0; mod < 8; mod++) {
+                if (m_keymap.modifierKeycode(mod) == code) {
+                    uint16_t bit = static_cast<uint16_t>(1u << mod);
+                    m_heldModifiers = press ? (m_heldModifiers | bit) : (m_heldModifiers & ~bit);
+                }
+            }
+#else
+            (void)code;
+            (void)press;
+#endif
+        }
+        
+        void emitTransition(uint16_t code, bool press) {
+            // 按下修饰键时事件本身已带上该修饰键，与录制的轨迹一致
+            if (press) {
+                updateHeldModifiers(code, true);
+            }
+            emitKey(code, press);
+            if (!press) {
+                updateHeldModifiers(code, false);
+            }
+        }
+        
+        bool compileType(const Scenario::Statement& statement) {
+            m_scratch.clear();
+            size_t skipped = m_scratch.addGroup(statement.keys.front(), m_keymap);
+            if (skipped > 0) {
+                std::cerr << "警告: 场景第 " << statement.line << " 行有 " << skipped
+                          << " 个字符在当前键盘映射中无法输入，已跳过" << std::endl;
+            }
+            if (m_scratch.empty()) {
+                return true;
+            }
+            const KeystrokePlan::Group& group = m_scratch.group(0);
+            const KeyEvent* event = m_scratch.events() + group.firstEvent;
+            const KeyEvent* end = event + group.eventCount;
+            while (event < end) {
+                size_t count = KeystrokePlan::charEventCount(event, end);
+                for (size_t i = 0; i < count; i++) {
+                    emitKey(event[i].code, event[i].isPress());
+                    if (event[i].isUnicode()) {
+                        // Unicode事件的modifiers是码位的高位，原样保留
+                        m_program.instructions.back().event = event[i];
+                    } else {
+                        m_program.instructions.back().event.modifiers |= event[i].modifiers;
+                    }
+                }
+                event += count;
+                emitWait(m_intervalNs);
+            }
+            return true;
+        }
+        
+        bool compileKeys(const Scenario::Statement& statement) {
+            std::vector<ResolvedKey> keys;
+            for (const std::string& name : statement.keys) {
+                ResolvedKey key;
+                if (!resolveKey(name, m_keymap, key)) {
+                    std::cerr << "错误: 场景第 " << statement.line << " 行: 当前键盘映射中没有按键 \""
+                              << name << "\"" << std::endl;
+                    return false;
+                }
+                keys.push_back(key);
+            }
+            
+            switch (statement.command) {
+                case Scenario::Command::Down:
+                    emitTransition(keys.front().code, true);
+                    break;
+                case Scenario::Command::Up:
+                    emitTransition(keys.front().code, false);
+                    break;
+                case Scenario::Command::Press:
+                case Scenario::Command::Chord: {
+                    // 每个键先按下它所需的修饰键（如大写字母的Shift），全部按下后逆序释放
+                    std::vector<uint16_t> pressed;
+                    for (const ResolvedKey& key : keys) {
+#ifdef __linux__
+                        for (int mod = 0; mod < 8; mod++) {
+                            if (key.modifiers & (1u << mod)) {
+                                pressed.push_back(m_keymap.modifierKeycode(mod));
+                                emitTransition(pressed.back(), true);
+                            }
+                        }
+#endif
+                        pressed.push_back(key.code);
+                        emitTransition(key.code, true);
+                    }
+                    for (size_t i = pressed.size(); i > 0; i--) {
+                        emitTransition(pressed[i - 1], false);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+            return true;
+        }
+        
+        bool compileEnd(const Scenario::Statement& statement) {
+            Loop loop = m_loops.back();
+            m_loops.pop_back();
+            // 不推进时钟的无限循环会以最快速度无休止地注入，视为脚本错误
+            if (loop.count == 0 && !loop.advances) {
+                std::cerr << "错误: 场景第 " << statement.line << " 行: 无限循环体中没有等待或字符间隔" << std::endl;
+                return false;
+            }
+            emit(ScenarioInstruction::LoopEnd, static_cast<uint32_t>(loop.begin), 0);
+            return true;
+        }
+    
+    private:
+        const KeyMap& m_keymap;
+        size_t m_groupCount;            // 可引用的字符组数
+        bool m_hasCorpus;               // group random是否从语料库抽取
+        ScenarioProgram& m_program;
+        int64_t m_intervalNs;           // 当前字符间隔
+        uint16_t m_heldModifiers;       // 当前按住的修饰键掩码
+        std::vector<Loop> m_loops;      // 正在编译的循环
+        KeystrokePlan m_scratch;        // 编译type文本用的临时计划
+    };
+}
+
+double ScenarioProgram::eventRate() const {
+    return durationNs > 0 ? static_cast<double>(eventsPerPass) * 1e9 / static_cast<double>(durationNs) : 0.0;
+}
+
+Scenario::Scenario()
+    : m_openLoops(0)
+{
+}
+
+bool Scenario::addLine(const std::string& rawLine, int lineNumber) {
+    std::string line = trim(stripComment(rawLine));
+    if (line.empty()) {
+        return true;
+    }
+    
+    size_t split = line.find_first_of(" \t");
+    std::string command = line.substr(0, split);
+    std::string argument = split == std::string::npos ? "" : trim(line.substr(split));
+    
+    Statement statement = {Command::End, {}, 0, 0, false, lineNumber};
+    bool valid = true;
+    if (command == "type") {
+        statement.command = Command::Type;
+        std::string text;
+        valid = parseQuoted(argument, text);
+        statement.keys.push_back(text);
+    } else if (command == "interval" || command == "wait") {
+        statement.command = command == "wait" ? Command::Wait : Command::Interval;
+        valid = parseDuration(argument, statement.durationNs);
+    } else if (command == "press" || command == "down" || command == "up") {
+        statement.command = command == "press" ? Command::Press : (command == "down" ? Command::Down : Command::Up);
+        valid = !argument.empty() && argument.find_first_of(" \t") == std::string::npos;
+        statement.keys.push_back(argument);
+    } else if (command == "chord") {
+        statement.command = Command::Chord;
+        std::stringstream stream(argument);
+        std::string key;
+        while (std::getline(stream, key, '+')) {
+            key = trim(key);
+            valid = valid && !key.empty();
+            statement.keys.push_back(key);
+        }
+        valid = valid && !statement.keys.empty();
+    } else if (command == "group") {
+        statement.command = Command::Group;
+        if (argument == "random") {
+            statement.random = true;
+        } else {
+            try {
+                size_t used = 0;
+                unsigned long index = std::stoul(argument, &used);
+                valid = used == argument.size() && index <= 0xffffffffUL;
+                statement.count = static_cast<uint32_t>(index);
+            } catch (...) {
+                valid = false;
+            }
+        }
+    } else if (command == "repeat" || command == "loop") {
+        statement.command = Command::Repeat;
+        if (command == "repeat") {
+            valid = parseCount(argument, statement.count);
+        } else {
+            valid = argument.empty();
+        }
+        if (valid && m_openLoops >= MaxLoopDepth) {
+            std::cerr << "错误: 场景第 " << lineNumber << " 行: 循环嵌套超过 " << MaxLoopDepth << " 层" << std::endl;
+            return false;
+        }
+        if (valid) {
+            m_openLoops++;
+        }
+    } else if (command == "end") {
+        statement.command = Command::End;
+        valid = argument.empty();
+        if (valid && m_openLoops == 0) {
+            std::cerr << "错误: 场景第 " << lineNumber << " 行: end 没有对应的 repeat/loop" << std::endl;
+            return false;
+        }
+        if (valid) {
+            m_openLoops--;
+        }
+    } else {
+        std::cerr << "错误: 场景第 " << lineNumber << " 行: 未知的语句 \"" << command
+                  << "\"（可选 type/interval/press/down/up/chord/wait/group/repeat/loop/end）" << std::endl;
+        return false;
+    }
+    
+    if (!valid) {
+        std::cerr << "错误: 场景第 " << lineNumber << " 行: 无效的参数: " << line << std::endl;
+        return false;
+    }
+    m_statements.push_back(statement);
+    return true;
+}
+
+bool Scenario::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "错误: 无法打开场景文件: " << path << std::endl;
+        return false;
+    }
+    
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        if (!addLine(line, ++lineNumber)) {
+            return false;
+        }
+    }
+    if (m_openLoops > 0) {
+        std::cerr << "错误: 场景文件结束时还有 " << m_openLoops << " 个循环没有 end" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Scenario::compile(const KeyMap& keymap, size_t groupCount, bool hasCorpus, ScenarioProgram& program) const {
+    program.instructions.clear();
+    program.eventsPerPass = 0;
+    program.durationNs = 0;
+    
+    ScenarioCompiler compiler(keymap, groupCount, hasCorpus, program);
+    for (const Statement& statement : m_statements) {
+        if (!compiler.compile(statement)) {
+            return false;
+        }
+    }
+    compiler.finish();
+    return true;
+}
+
+bool Scenario::empty() const {
+    return m_statements.empty();
+}
+
+size_t Scenario::statementCount() const {
+    return m_statements.size();
+}
@@ -0,0 +1,110 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "keystroke_plan.h"
+
+/**
+ * 场景指令
+ * 解释器按顺序执行，运行中不做任何解析和内存分配
+ */
+struct ScenarioInstruction {
+    enum Op : uint8_t {
+        Key,            // 把event排入当前批次
+        Wait,           // 在当前时刻发送已排队的事件，然后时钟前移durationNs
+        LoopBegin,      // 循环开始，operand为次数（0表示无限循环）
+        LoopEnd,        // 循环结束，operand为对应LoopBegin的位置
+        Group,          // 逐字符输入字符组operand（-t的顺序），字符间隔durationNs
+        RandomGroup,    // 逐字符输入随机一个字符组（有语料库时从语料库抽取），字符间隔durationNs
+        End             // 场景结束
+    };
+    
+    int64_t durationNs;     // Wait的时长，Group/RandomGroup的字符间隔
+    uint32_t operand;       // 循环次数、循环起点或字符组编号
+    KeyEvent event;         // Key的按键事件
+    uint8_t op;             // 指令类型
+};
+
+/**
+ * 编译后的场景：以End结尾的扁平指令数组
+ */
+struct ScenarioProgram {
+    std::vector<ScenarioInstruction> instructions;
+    uint64_t eventsPerPass = 0;     // 执行一遍的按键事件数（无限循环按一次计，不含字符组）
+    int64_t durationNs = 0;         // 执行一遍的时长（同上）
+    
+    // 平均按键事件频率（次/秒），时长为0时返回0
+    double eventRate() const;
+};
+
+/**
+ * 场景脚本
+ * 启动时解析一次，按当前键盘映射编译为扁平指令数组，由输入线程中的解释器执行，
+ * 代替每个周期随机选择字符组的循环
+ *
+ * 脚本格式（每行一条语句，#开头为注释，缩进随意）：
+ *   type "user@example.com"    逐字符输入文本（支持\n \t \" \\转义）
+ *   interval 30ms              之后type/group的字符间隔（默认10ms）
+ *   press Return               按下并释放一个键
+ *   down shift / up shift      按住/松开一个键
+ *   chord ctrl+alt+t           依次按下各键，再逆序释放
+ *   wait 500ms                 等待（时长可带s/ms/us后缀，默认为秒）
+ *   group 0 / group random     逐字符输入第N个字符组（-t的顺序，从0开始）或随机一个
+ *   repeat 10 ... end          重复执行，可嵌套
+ *   loop ... end               无限循环（循环体必须包含等待）
+ * 键名为X11 KeySym名称（Return、F5、Control_L）或单个字符，
+ * shift/ctrl/alt/super为左侧修饰键的简写，enter/esc/space/tab/backspace为常用键的简写
+ */
+class Scenario {
+public:
+    // 语句类型
+    enum class Command {
+        Type,
+        Interval,
+        Press,
+        Down,
+        Up,
+        Chord,
+        Wait,
+        Group,
+        Repeat,
+        End
+    };
+    
+    // 一条语句
+    struct Statement {
+        Command command;
+        std::vector<std::string> keys;  // type的文本（一项），press/down/up/chord的键名
+        int64_t durationNs;             // interval/wait的时长
+        uint32_t count;                 // repeat次数（0表示无限），group编号
+        bool random;                    // group random
+        int line;                       // 行号
+    };
+    
+    // 循环最大嵌套层数（解释器的循环栈是定长数组）
+    static const size_t MaxLoopDepth = 16;
+    
+    Scenario();
+    
+    // 解析一行语句，失败时返回false并输出错误
+    bool addLine(const std::string& line, int lineNumber);
+    
+    // 从文件读取脚本，失败时返回false并输出错误
+    bool load(const std::string& path);
+    
+    // 按键盘映射编译为指令数组，键名无法解析或group引用了不存在的字符组时返回false并输出错误；
+    // 无法输入的字符只输出警告并跳过。groupCount为当前字符组数，hasCorpus表示group random可从语料库抽取
+    bool compile(const KeyMap& keymap, size_t groupCount, bool hasCorpus, ScenarioProgram& program) const;
+    
+    bool empty() const;
+    size_t statementCount() const;
+
+private:
+    std::vector<Statement> m_statements;    // 语句列表
+    size_t m_openLoops;                     // 解析中尚未结束的循环数
+};
+
+#endif // SCENARIO_H
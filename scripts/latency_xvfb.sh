@@ -0,0 +1,47 @@
+#!/bin/sh
+# 在本地Xvfb上运行端到端延迟测量（可用于CI）
+# 用法: scripts/latency_xvfb.sh [构建目录] [频率列表] [每个频率的秒数]
+set -e
+
+BUILD_DIR=${1:-build}
+RATES=${2:-100,1000,5000}
+DURATION=${3:-5}
+DISPLAY_NUM=${DISPLAY_NUM:-:99}
+SOCKET=${SOCKET:-/tmp/keyboard_receiver.$$.sock}
+
+BIN="$BUILD_DIR/bin"
+if [ ! -x "$BIN/KeyboardStressTest" ] || [ ! -x "$BIN/KeyboardReceiver" ]; then
+    echo "找不到可执行文件，请先构建: cmake -S . -B $BUILD_DIR && cmake --build $BUILD_DIR" >&2
+    exit 1
+fi
+
+Xvfb "$DISPLAY_NUM" -screen 0 1024x768x24 -nolisten tcp &
+XVFB_PID=$!
+RECEIVER_PID=
+cleanup() {
+    [ -n "$RECEIVER_PID" ] && kill "$RECEIVER_PID" 2>/dev/null || true
+    kill "$XVFB_PID" 2>/dev/null || true
+    rm -f "$SOCKET"
+}
+trap cleanup EXIT INT TERM
+
+export DISPLAY="$DISPLAY_NUM"
+
+# 等待Xvfb就绪
+for i in $(seq 1 50); do
+    if xdpyinfo >/dev/null 2>&1 || [ -e "/tmp/.X11-unix/X${DISPLAY_NUM#:}" ]; then
+        break
+    fi
+    sleep 0.1
+done
+
+"$BIN/KeyboardReceiver" --socket "$SOCKET" &
+RECEIVER_PID=$!
+
+# 等待接收窗口开始监听
+for i in $(seq 1 50); do
+    [ -S "$SOCKET" ] && break
+    sleep 0.1
+done
+
+"$BIN/KeyboardStressTest" -t "a" --latency "$SOCKET" --rates "$RATES" --duration "$DURATION"
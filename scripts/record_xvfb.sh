@@ -0,0 +1,49 @@
+#!/bin/sh
+# 在本地Xvfb上验证录制和回放（可用于CI）：
+# 录制期间用XTest注入一段输入，再用null后端回放录下的轨迹，可对比两边输出的事件数
+# 用法: scripts/record_xvfb.sh [构建目录] [注入秒数]
+set -e
+
+BUILD_DIR=${1:-build}
+DURATION=${2:-3}
+DISPLAY_NUM=${DISPLAY_NUM:-:99}
+TRACE=${TRACE:-/tmp/keyboard_record.$$.kst}
+
+BIN="$BUILD_DIR/bin"
+if [ ! -x "$BIN/KeyboardStressTest" ]; then
+    echo "找不到可执行文件，请先构建: cmake -S . -B $BUILD_DIR && cmake --build $BUILD_DIR" >&2
+    exit 1
+fi
+
+Xvfb "$DISPLAY_NUM" -screen 0 1024x768x24 -nolisten tcp &
+XVFB_PID=$!
+RECORDER_PID=
+cleanup() {
+    [ -n "$RECORDER_PID" ] && kill "$RECORDER_PID" 2>/dev/null || true
+    kill "$XVFB_PID" 2>/dev/null || true
+    rm -f "$TRACE"
+}
+trap cleanup EXIT INT TERM
+
+export DISPLAY="$DISPLAY_NUM"
+
+# 等待Xvfb就绪
+for i in $(seq 1 50); do
+    if xdpyinfo >/dev/null 2>&1 || [ -e "/tmp/.X11-unix/X${DISPLAY_NUM#:}" ]; then
+        break
+    fi
+    sleep 0.1
+done
+
+"$BIN/KeyboardStressTest" --record "$TRACE" &
+RECORDER_PID=$!
+sleep 1
+
+"$BIN/KeyboardStressTest" -t "Hello World" -f 200 --autostart --duration "$DURATION"
+sleep 0.5
+
+kill -INT "$RECORDER_PID"
+wait "$RECORDER_PID"
+RECORDER_PID=
+
+"$BIN/KeyboardStressTest" --replay "$TRACE" --replay-speed 10 --backend null
@@ -0,0 +1,75 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * 单生产者单消费者无锁环形队列
+ * 生产者和消费者各自只写自己的位置计数器（分处不同缓存行），push和pop都不会阻塞；
+ * 队列满时push直接失败，由调用方决定丢弃还是重试
+ */
+template <typename T>
+class SpscRing {
+public:
+    // capacity会向上取整到2的幂
+    explicit SpscRing(size_t capacity)
+        : m_head(0)
+        , m_cachedTail(0)
+        , m_tail(0)
+    {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+    
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+    
+    // 生产者：写入一个元素，队列满时返回false
+    bool push(const T& item) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cachedTail > m_mask) {
+            // 缓存的消费位置已过时才重新读取，减少跨核的缓存行传递
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cachedTail > m_mask) {
+                return false;
+            }
+        }
+        m_buffer[head & m_mask] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // 消费者：最多取出maxCount个元素，返回实际取出的数量
+    size_t pop(T* out, size_t maxCount) {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        size_t count = static_cast<size_t>(std::min<uint64_t>(head - tail, maxCount));
+        for (size_t i = 0; i < count; i++) {
+            out[i] = m_buffer[(tail + i) & m_mask];
+        }
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+    
+    // 容量
+    size_t capacity() const {
+        return m_buffer.size();
+    }
+
+private:
+    alignas(64) std::atomic<uint64_t> m_head;   // 下一个写入位置（只由生产者写）
+    uint64_t m_cachedTail;                      // 生产者缓存的消费位置
+    alignas(64) std::atomic<uint64_t> m_tail;   // 下一个读取位置（只由消费者写）
+    alignas(64) std::vector<T> m_buffer;        // 元素存储
+    size_t m_mask;                              // 容量掩码
+};
+
+#endif // SPSC_RING_H
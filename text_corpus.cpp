@@ -0,0 +1,138 @@
+#include "text_corpus.h"
+#include "alias_table.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+    // 解析行尾的权重字段，字段必须完整是一个非负数
+    bool parseWeight(const char* begin, const char* end, double& weight) {
+        char buffer[32];
+        size_t length = static_cast<size_t>(end - begin);
+        if (length == 0 || length >= sizeof(buffer)) {
+            return false;
+        }
+        std::memcpy(buffer, begin, length);
+        buffer[length] = '\0';
+        char* parsed = nullptr;
+        weight = std::strtod(buffer, &parsed);
+        return parsed == buffer + length && weight >= 0;
+    }
+}
+
+TextCorpus::TextCorpus() {
+}
+
+bool TextCorpus::open(const std::string& path) {
+    close();
+    if (!m_file.open(path)) {
+        return false;
+    }
+    
+    // 建索引时顺序读取，之后按抽样结果随机访问
+    m_file.advise(MappedFile::Access::Sequential);
+    std::vector<double> weights = buildIndex();
+    m_file.advise(MappedFile::Access::Random);
+    
+    if (m_offsets.empty()) {
+        std::cerr << "错误: 语料库中没有任何字符组: " << path << std::endl;
+        close();
+        return false;
+    }
+    if (!weights.empty()) {
+        buildAliasTable(weights);
+    }
+    return true;
+}
+
+std::vector<double> TextCorpus::buildIndex() {
+    std::vector<double> weights;
+    bool weighted = false;
+    
+    const char* data = m_file.data();
+    const char* position = data;
+    const char* end = data + m_file.size();
+    while (position < end) {
+        const char* newline = static_cast<const char*>(std::memchr(position, '\n', static_cast<size_t>(end - position)));
+        const char* lineEnd = newline ? newline : end;
+        const char* textEnd = lineEnd;
+        if (textEnd > position && textEnd[-1] == '\r') {
+            textEnd--;
+        }
+        
+        // 最后一个制表符之后如果是数字，则作为权重
+        double weight = 1.0;
+        const char* tab = textEnd;
+        while (tab > position && tab[-1] != '\t') {
+            tab--;
+        }
+        if (tab > position && parseWeight(tab, textEnd, weight)) {
+            textEnd = tab - 1;
+        } else {
+            weight = 1.0;
+        }
+        
+        // 空行和权重为0的行不参与抽样
+        if (textEnd > position && weight > 0) {
+            if (weight != 1.0 && !weighted) {
+                // 第一次遇到非1的权重时补齐之前各行的权重
+                weighted = true;
+                weights.assign(m_offsets.size(), 1.0);
+            }
+            m_offsets.push_back(static_cast<uint64_t>(position - data));
+            m_lengths.push_back(static_cast<uint32_t>(textEnd - position));
+            if (weighted) {
+                weights.push_back(weight);
+            }
+        }
+        position = lineEnd + 1;
+    }
+    return weights;
+}
+
+void TextCorpus::buildAliasTable(const std::vector<double>& weights) {
+    size_t count = weights.size();
+    m_probability.assign(count, 1.0f);
+    m_alias.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        m_alias[i] = static_cast<uint32_t>(i);
+    }
+    ::buildAliasTable(weights, [this](uint32_t column, double probability, uint32_t alias) {
+        m_probability[column] = static_cast<float>(probability);
+        m_alias[column] = alias;
+    });
+}
+
+size_t TextCorpus::size() const {
+    return m_offsets.size();
+}
+
+std::string_view TextCorpus::group(size_t index) const {
+    return std::string_view(m_file.data() + m_offsets[index], m_lengths[index]);
+}
+
+size_t TextCorpus::sample(std::mt19937& generator) const {
+    std::uniform_int_distribution<size_t> column(0, m_offsets.size() - 1);
+    size_t index = column(generator);
+    if (m_alias.empty()) {
+        return index;
+    }
+    std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+    return coin(generator) < m_probability[index] ? index : m_alias[index];
+}
+
+bool TextCorpus::isWeighted() const {
+    return !m_alias.empty();
+}
+
+uint64_t TextCorpus::byteSize() const {
+    return m_file.size();
+}
+
+void TextCorpus::close() {
+    m_file.close();
+    m_offsets.clear();
+    m_lengths.clear();
+    m_probability.clear();
+    m_alias.clear();
+}
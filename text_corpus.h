@@ -0,0 +1,58 @@
+#ifndef TEXT_CORPUS_H
+#define TEXT_CORPUS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+#include "mapped_file.h"
+
+/**
+ * 内存映射的文本语料库
+ * 文件每行一个字符组，行尾可用制表符分隔一个权重（如 "hello\t2.5"），没有权重时为1。
+ * 文件通过mmap映射，只建立行索引，不复制文本；字符组以string_view返回。
+ * 有权重时构建别名表（Vose算法），每次抽样都是O(1)
+ */
+class TextCorpus {
+public:
+    TextCorpus();
+    
+    // 映射文件并建立索引，失败时返回false并输出错误
+    bool open(const std::string& path);
+    
+    // 字符组数量
+    size_t size() const;
+    
+    // 第index个字符组（指向映射区域，语料库存活期间有效）
+    std::string_view group(size_t index) const;
+    
+    // 按权重随机抽取一个字符组的索引（O(1)，可在多个线程中以各自的生成器并发调用）
+    size_t sample(std::mt19937& generator) const;
+    
+    // 是否包含非均匀权重
+    bool isWeighted() const;
+    
+    // 映射的文件大小（字节）
+    uint64_t byteSize() const;
+
+private:
+    // 扫描映射区域建立行索引，返回每行的权重（均为1时返回空）
+    std::vector<double> buildIndex();
+    
+    // 根据权重构建别名表
+    void buildAliasTable(const std::vector<double>& weights);
+    
+    // 解除映射
+    void close();
+
+private:
+    MappedFile m_file;                  // 映射的语料库文件
+    std::vector<uint64_t> m_offsets;    // 每行文本的起始偏移
+    std::vector<uint32_t> m_lengths;    // 每行文本的长度（不含权重和换行）
+    std::vector<float> m_probability;   // 别名表：保留本列的概率
+    std::vector<uint32_t> m_alias;      // 别名表：未保留时使用的列
+};
+
+#endif // TEXT_CORPUS_H
@@ -0,0 +1,405 @@
+#include "typing_model.h"
+#include "mapped_file.h"
+#include "alias_table.h"
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <map>
+#include <utility>
+
+#ifdef __linux__
+#include <X11/X.h>
+#endif
+
+namespace {
+    // 没有计时样本时内置分布的形状：对数正态分布的σ（平均值由请求的频率决定）
+    const double DefaultTimingSigma = 0.35;
+    const size_t DefaultTimingSamples = 4096;
+    
+    // 编码一个码位为UTF-8
+    std::string encodeUtf8(uint32_t codePoint) {
+        std::string text;
+        if (codePoint < 0x80) {
+            text += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            text += static_cast<char>(0xC0 | (codePoint >> 6));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            text += static_cast<char>(0xE0 | (codePoint >> 12));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            text += static_cast<char>(0xF0 | (codePoint >> 18));
+            text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        return text;
+    }
+    
+    // 内置的按下间隔样本：对数正态分布，平均值为1秒，生成时再缩放到请求的频率
+    std::vector<int64_t> defaultTimingSamples() {
+        std::vector<int64_t> samples;
+        samples.reserve(DefaultTimingSamples);
+        std::mt19937_64 generator(1);
+        double mu = -0.5 * DefaultTimingSigma * DefaultTimingSigma;
+        std::lognormal_distribution<double> lognormal(mu, DefaultTimingSigma);
+        for (size_t i = 0; i < DefaultTimingSamples; i++) {
+            samples.push_back(static_cast<int64_t>(lognormal(generator) * 1e9));
+        }
+        return samples;
+    }
+    
+    // 双字母的键
+    uint64_t digraphKey(uint32_t previous, uint32_t codePoint) {
+        return (static_cast<uint64_t>(previous) << 32) | codePoint;
+    }
+}
+
+TypingModel::TypingModel(size_t order)
+    : m_order(order < 2 ? 2 : (order > MaxOrder ? MaxOrder : order))
+    , m_trainedChars(0)
+    , m_timingSampleCount(0)
+    , m_digraphTables(0)
+    , m_trainedTiming(false)
+    , m_meanIntervalNs(0)
+{
+}
+
+bool TypingModel::isTypable(uint32_t codePoint) {
+    if (codePoint == '\n' || codePoint == '\t' || codePoint == '\b') {
+        return true;
+    }
+    return codePoint >= 0x20 && !(codePoint >= 0x7F && codePoint <= 0x9F) &&
+           !(codePoint >= 0xD800 && codePoint <= 0xDFFF) && codePoint <= 0x10FFFF;
+}
+
+void TypingModel::appendSymbol(uint32_t codePoint) {
+    // 上下文攒满order-1个字符之后才开始计数，开头的字符留到编译时接在末尾之后
+    if (m_context.size() + 1 < m_order) {
+        m_context += static_cast<char32_t>(codePoint);
+        m_head += static_cast<char32_t>(codePoint);
+        return;
+    }
+    m_counts[m_context][codePoint]++;
+    m_context.erase(0, 1);
+    m_context += static_cast<char32_t>(codePoint);
+}
+
+void TypingModel::trainCodePoint(uint32_t codePoint) {
+    if (!isTypable(codePoint)) {
+        return;
+    }
+    appendSymbol(codePoint);
+    m_trainedChars++;
+}
+
+void TypingModel::trainText(std::string_view text) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        uint32_t codePoint = KeystrokePlan::decodeUtf8(text, pos);
+        // 换行统一为\n，\r\n中的\r被忽略
+        if (codePoint != '\r') {
+            trainCodePoint(codePoint);
+        }
+    }
+}
+
+bool TypingModel::trainFile(const std::string& path, const KeyMap& keymap) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    
+    // 文件头是有效的轨迹头时按按键轨迹训练，否则作为UTF-8文本
+    TraceHeader header;
+    if (!header.decode(file.data(), file.size())) {
+        file.advise(MappedFile::Access::Sequential);
+        trainText(std::string_view(file.data(), static_cast<size_t>(file.size())));
+        return true;
+    }
+    file.close();
+    TraceReader trace;
+    if (!trace.open(path)) {
+        return false;
+    }
+    if (trainTrace(trace, keymap) == 0) {
+        std::cerr << "警告: 按键轨迹中没有可还原为字符的按键: " << path << std::endl;
+    }
+    return true;
+}
+
+void TypingModel::addTiming(uint32_t previous, uint32_t codePoint, int64_t intervalNs) {
+    m_timingSamples[digraphKey(previous, codePoint)].push_back(intervalNs);
+    m_timingSampleCount++;
+}
+
+size_t TypingModel::trainTrace(TraceReader& trace, const KeyMap& keymap) {
+    // 按（键码，修饰键）反查字符；只比较映射中用到的修饰键，NumLock开着时再去掉它查一次
+    std::unordered_map<uint32_t, uint32_t> characters;
+    bool keycodes = trace.codeType() == TraceHeader::X11Keycode;
+#ifdef __linux__
+    uint16_t relevant = 0;
+    if (keycodes) {
+        for (const auto& entry : keymap.bindings()) {
+            uint32_t codePoint = KeystrokePlan::keysymToCodePoint(entry.first);
+            if (codePoint != 0) {
+                characters.emplace((static_cast<uint32_t>(entry.second.keycode) << 16) | entry.second.modifiers, codePoint);
+                relevant |= entry.second.modifiers;
+            }
+        }
+    }
+#else
+    (void)keymap;
+#endif
+    if (keycodes && characters.empty()) {
+        std::cerr << "错误: 无法按当前键盘映射还原轨迹中的字符" << std::endl;
+        return 0;
+    }
+    
+    RecordedKeyEvent recorded;
+    uint32_t previous = 0;
+    int64_t previousTime = 0;
+    size_t count = 0;
+    while (trace.next(recorded)) {
+        const KeyEvent& event = recorded.event;
+        if (!event.isPress()) {
+            continue;
+        }
+        uint32_t codePoint = 0;
+        if (!keycodes) {
+            codePoint = event.code == '\r' ? '\n' : event.code;
+        }
+#ifdef __linux__
+        // 带Ctrl/Alt的按键是快捷键而不是打字，打断字符序列，前后两个字符之间不计时；
+        // NumLock（Mod2）不影响字符
+        else if (event.modifiers & (ControlMask | Mod1Mask)) {
+            previous = 0;
+            continue;
+        } else {
+            uint16_t modifiers = event.modifiers & relevant;
+            auto it = characters.find((static_cast<uint32_t>(event.code) << 16) | modifiers);
+            if (it == characters.end() && (modifiers & Mod2Mask)) {
+                it = characters.find((static_cast<uint32_t>(event.code) << 16) | (modifiers & ~Mod2Mask));
+            }
+            codePoint = it == characters.end() ? 0 : it->second;
+        }
+#endif
+        
+        // 修饰键等不产生字符的按键不打断序列
+        if (!isTypable(codePoint)) {
+            continue;
+        }
+        trainCodePoint(codePoint);
+        if (previous != 0 && recorded.timestampNs - previousTime <= MaxGapNs) {
+            addTiming(previous, codePoint, recorded.timestampNs - previousTime);
+        }
+        previous = codePoint;
+        previousTime = recorded.timestampNs;
+        count++;
+    }
+    return count;
+}
+
+uint32_t TypingModel::addTimingTable(std::vector<int64_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    uint32_t table = static_cast<uint32_t>(m_timingTables.size() / (TimingQuantiles + 1));
+    for (size_t k = 0; k <= TimingQuantiles; k++) {
+        m_timingTables.push_back(samples[k * (samples.size() - 1) / TimingQuantiles]);
+    }
+    return table;
+}
+
+double TypingModel::timingTableMean(uint32_t table) const {
+    const int64_t* quantiles = &m_timingTables[table * (TimingQuantiles + 1)];
+    double sum = 0;
+    for (size_t k = 0; k < TimingQuantiles; k++) {
+        sum += 0.5 * static_cast<double>(quantiles[k] + quantiles[k + 1]);
+    }
+    return sum / TimingQuantiles;
+}
+
+bool TypingModel::compile() {
+    if (!m_states.empty()) {
+        return true;
+    }
+    if (m_trainedChars < m_order) {
+        std::cerr << "错误: 打字模型的训练数据太少（至少需要 " << m_order << " 个字符）" << std::endl;
+        return false;
+    }
+    
+    // 训练数据首尾相接：把开头的字符接在末尾之后，每个上下文都有后继
+    std::u32string head = m_head;
+    for (char32_t codePoint : head) {
+        appendSymbol(static_cast<uint32_t>(codePoint));
+    }
+    
+    // 符号和状态按码位排序编号，同样的训练数据和种子总是生成同样的字符流
+    std::map<std::u32string, uint32_t> states;
+    std::map<uint32_t, uint32_t> symbols;
+    for (const auto& context : m_counts) {
+        states.emplace(context.first, 0);
+        for (const auto& successor : context.second) {
+            symbols.emplace(successor.first, 0);
+        }
+    }
+    for (auto& symbol : symbols) {
+        symbol.second = static_cast<uint32_t>(m_symbols.size());
+        m_symbols.push_back(symbol.first);
+    }
+    uint32_t stateIndex = 0;
+    for (auto& state : states) {
+        state.second = stateIndex++;
+    }
+    
+    // 计时表：0号为全局分布，其次是样本足够的字符和双字母
+    std::vector<int64_t> all;
+    std::unordered_map<uint32_t, std::vector<int64_t>> bySymbol;
+    for (const auto& digraph : m_timingSamples) {
+        all.insert(all.end(), digraph.second.begin(), digraph.second.end());
+        std::vector<int64_t>& samples = bySymbol[static_cast<uint32_t>(digraph.first & 0xFFFFFFFF)];
+        samples.insert(samples.end(), digraph.second.begin(), digraph.second.end());
+    }
+    m_trainedTiming = all.size() >= MinTimingSamples;
+    if (!m_trainedTiming) {
+        all = defaultTimingSamples();
+    }
+    addTimingTable(all);
+    std::unordered_map<uint32_t, uint32_t> symbolTables;
+    for (auto& samples : bySymbol) {
+        if (samples.second.size() >= MinTimingSamples) {
+            symbolTables[samples.first] = addTimingTable(samples.second);
+        }
+    }
+    std::unordered_map<uint64_t, uint32_t> digraphTables;
+    for (auto& digraph : m_timingSamples) {
+        if (digraph.second.size() >= MinTimingSamples) {
+            digraphTables[digraph.first] = addTimingTable(digraph.second);
+        }
+    }
+    m_digraphTables = digraphTables.size();
+    
+    // 每个状态一张别名表（Vose别名法），表项中记录后继状态和计时表，生成时不需要查找
+    double weightedInterval = 0;
+    double totalCount = 0;
+    m_states.reserve(states.size());
+    for (const auto& state : states) {
+        const std::u32string& context = state.first;
+        const std::unordered_map<uint32_t, uint64_t>& successors = m_counts[context];
+        std::vector<std::pair<uint32_t, uint64_t>> sorted(successors.begin(), successors.end());
+        std::sort(sorted.begin(), sorted.end());
+        
+        uint32_t previous = static_cast<uint32_t>(context.back());
+        uint32_t first = static_cast<uint32_t>(m_outcomes.size());
+        size_t count = sorted.size();
+        std::vector<double> weights(count);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t codePoint = sorted[i].first;
+            std::u32string nextContext = context.substr(1) + static_cast<char32_t>(codePoint);
+            
+            Outcome outcome;
+            outcome.symbol = symbols[codePoint];
+            outcome.nextState = states[nextContext];
+            auto digraph = digraphTables.find(digraphKey(previous, codePoint));
+            auto symbol = symbolTables.find(codePoint);
+            outcome.timing = digraph != digraphTables.end() ? digraph->second
+                           : symbol != symbolTables.end() ? symbol->second : 0;
+            outcome.threshold = 0xFFFFFFFF;
+            outcome.alias = static_cast<uint32_t>(i);
+            m_outcomes.push_back(outcome);
+            
+            weights[i] = static_cast<double>(sorted[i].second);
+            weightedInterval += weights[i] * timingTableMean(outcome.timing);
+            totalCount += weights[i];
+        }
+        buildAliasTable(weights, [this, first](uint32_t column, double probability, uint32_t alias) {
+            m_outcomes[first + column].threshold = static_cast<uint32_t>(probability * 4294967296.0);
+            m_outcomes[first + column].alias = alias;
+        });
+        m_states.push_back(State{first, static_cast<uint32_t>(count)});
+    }
+    m_meanIntervalNs = totalCount > 0 ? weightedInterval / totalCount : 0;
+    
+    // 样本间隔都为0（如时间戳相同的轨迹）时无法缩放到请求的频率，当作没有计时样本，全部改用内置分布
+    if (m_meanIntervalNs <= 0) {
+        std::cerr << "警告: 打字模型的计时样本平均间隔为0，改用内置的间隔分布" << std::endl;
+        m_timingTables.clear();
+        all = defaultTimingSamples();
+        addTimingTable(all);
+        for (Outcome& outcome : m_outcomes) {
+            outcome.timing = 0;
+        }
+        m_digraphTables = 0;
+        m_trainedTiming = false;
+        m_meanIntervalNs = timingTableMean(0);
+    }
+    
+    // 训练数据只在编译时使用
+    m_counts.clear();
+    m_timingSamples.clear();
+    return true;
+}
+
+size_t TypingModel::symbolCount() const {
+    return m_symbols.size();
+}
+
+size_t TypingModel::stateCount() const {
+    return m_states.size();
+}
+
+size_t TypingModel::digraphTableCount() const {
+    return m_digraphTables;
+}
+
+uint64_t TypingModel::trainedChars() const {
+    return m_trainedChars;
+}
+
+uint64_t TypingModel::timingSamples() const {
+    return m_timingSampleCount;
+}
+
+bool TypingModel::trainedTiming() const {
+    return m_trainedTiming;
+}
+
+double TypingModel::meanIntervalNs() const {
+    return m_meanIntervalNs;
+}
+
+bool TypingModel::empty() const {
+    return m_states.empty();
+}
+
+std::vector<std::string> TypingModel::symbolTexts() const {
+    std::vector<std::string> texts;
+    texts.reserve(m_symbols.size());
+    for (uint32_t codePoint : m_symbols) {
+        texts.push_back(encodeUtf8(codePoint));
+    }
+    return texts;
+}
+
+uint32_t TypingModel::startState(uint64_t random) const {
+    return static_cast<uint32_t>(((random & 0xFFFFFFFF) * m_states.size()) >> 32);
+}
+
+uint32_t TypingModel::next(uint32_t& state, uint64_t symbolRandom, uint64_t timingRandom, int64_t& intervalNs) const {
+    // 低32位选别名表的列，高32位决定取本列还是别名
+    const State& current = m_states[state];
+    uint32_t column = static_cast<uint32_t>(((symbolRandom & 0xFFFFFFFF) * current.outcomeCount) >> 32);
+    const Outcome* outcome = &m_outcomes[current.firstOutcome + column];
+    if (static_cast<uint32_t>(symbolRandom >> 32) >= outcome->threshold) {
+        outcome = &m_outcomes[current.firstOutcome + outcome->alias];
+    }
+    state = outcome->nextState;
+    
+    // 低32位选分位数区间，高16位在区间内线性插值
+    const int64_t* quantiles = &m_timingTables[outcome->timing * (TimingQuantiles + 1)];
+    uint64_t bucket = ((timingRandom & 0xFFFFFFFF) * TimingQuantiles) >> 32;
+    int64_t low = quantiles[bucket];
+    int64_t high = quantiles[bucket + 1];
+    intervalNs = low + static_cast<int64_t>((static_cast<uint64_t>(high - low) * (timingRandom >> 48)) >> 16);
+    return outcome->symbol;
+}
@@ -0,0 +1,129 @@
+#ifndef TYPING_MODEL_H
+#define TYPING_MODEL_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "keystroke_plan.h"
+#include "key_trace.h"
+
+/**
+ * 打字模型
+ * 从样本文本或按键轨迹训练字符n-gram模型和双字母（相邻两个字符）按下间隔分布，
+ * 生成无限长、节奏接近真人的字符流，代替按固定间隔随机输入字符组。
+ *
+ * 训练数据被视为首尾相接的一个循环，每个上下文都有后继。编译时把每个上下文（前order-1个字符）
+ * 编为一个状态，状态的所有后继字符编为一张别名表，表项中直接记录后继状态和计时表，
+ * 生成一个字符只需两次数组访问和两个随机数，没有哈希查找、分配和浮点运算。
+ * 计时表是按下间隔的分位数（相邻分位数之间线性插值），样本太少的双字母退回到
+ * 该字符的分布，再退回到全局分布；只训练了文本时使用内置的对数正态分布
+ */
+class TypingModel {
+public:
+    static const size_t DefaultOrder = 3;           // 默认阶数
+    static const size_t MaxOrder = 8;               // 最大阶数
+    static const size_t TimingQuantiles = 32;       // 计时表的分位数区间数
+    static const size_t MinTimingSamples = 16;      // 单独建计时表所需的最少样本数
+    static const int64_t MaxGapNs = 2000000000;     // 超过该间隔视为停顿，不计入计时
+    
+    explicit TypingModel(size_t order = DefaultOrder);
+    
+    // 训练一段UTF-8文本（可多次调用，各段首尾相接）
+    void trainText(std::string_view text);
+    
+    // 训练一个文件：按键轨迹文件按trainTrace训练，其他文件作为UTF-8文本；失败时返回false并输出错误
+    bool trainFile(const std::string& path, const KeyMap& keymap);
+    
+    // 从按键轨迹训练：按下事件按keymap还原为字符（UTF-16轨迹直接取码元），字符同时用于n-gram，
+    // 相邻两个字符的按下间隔记入双字母计时；带Ctrl/Alt的快捷键打断字符序列。返回还原出的字符数
+    size_t trainTrace(TraceReader& trace, const KeyMap& keymap);
+    
+    // 生成采样表，训练数据不足时返回false并输出错误；之后模型只读，可被多个线程共享
+    bool compile();
+    
+    // 符号（字符）数、状态（上下文）数，以及有自己计时表的双字母数
+    size_t symbolCount() const;
+    size_t stateCount() const;
+    size_t digraphTableCount() const;
+    
+    // 训练的字符数和计时样本数
+    uint64_t trainedChars() const;
+    uint64_t timingSamples() const;
+    
+    // 是否有足够的计时样本（否则使用内置分布，间隔只有相对意义）
+    bool trainedTiming() const;
+    
+    // 生成时的平均按下间隔（纳秒，训练时的时间尺度），输入线程按它把间隔缩放到请求的频率
+    double meanIntervalNs() const;
+    
+    // 每个符号的UTF-8文本，第i个符号编译为按键计划的第i个字符组
+    std::vector<std::string> symbolTexts() const;
+    
+    // 按随机数选择一个起始状态
+    uint32_t startState(uint64_t random) const;
+    
+    // 从state抽取下一个符号并把state前移到新的上下文，intervalNs为与上一个字符的按下间隔
+    uint32_t next(uint32_t& state, uint64_t symbolRandom, uint64_t timingRandom, int64_t& intervalNs) const;
+    
+    // 模型是否已编译
+    bool empty() const;
+
+private:
+    // 一个状态的后继在别名表中的范围
+    struct State {
+        uint32_t firstOutcome;
+        uint32_t outcomeCount;
+    };
+    
+    // 别名表的一项：以threshold / 2^32的概率取本项，否则取alias项
+    struct Outcome {
+        uint32_t symbol;        // 后继符号
+        uint32_t nextState;     // 后继状态
+        uint32_t timing;        // 计时表编号
+        uint32_t threshold;     // 取本项的概率
+        uint32_t alias;         // 别名项（状态内的序号）
+    };
+    
+    // 训练一个码位，不可输入的控制字符被忽略
+    void trainCodePoint(uint32_t codePoint);
+    
+    // 在当前上下文之后追加一个码位
+    void appendSymbol(uint32_t codePoint);
+    
+    // 记录上一个字符到codePoint的按下间隔
+    void addTiming(uint32_t previous, uint32_t codePoint, int64_t intervalNs);
+    
+    // 由样本生成一张计时表（分位数），返回表的编号
+    uint32_t addTimingTable(std::vector<int64_t>& samples);
+    
+    // 计时表的平均值（相邻分位数之间均匀分布）
+    double timingTableMean(uint32_t table) const;
+    
+    // 码位是否可以作为符号
+    static bool isTypable(uint32_t codePoint);
+
+private:
+    size_t m_order;                                             // n-gram阶数
+    
+    // 训练数据
+    std::unordered_map<std::u32string, std::unordered_map<uint32_t, uint64_t>> m_counts;  // 上下文 -> 后继 -> 次数
+    std::u32string m_head;                                      // 训练数据开头的order-1个字符（循环接回开头）
+    std::u32string m_context;                                   // 当前上下文
+    std::unordered_map<uint64_t, std::vector<int64_t>> m_timingSamples;  // 双字母 -> 按下间隔
+    uint64_t m_trainedChars;                                    // 训练的字符数
+    uint64_t m_timingSampleCount;                               // 计时样本数
+    
+    // 编译结果
+    std::vector<uint32_t> m_symbols;                            // 符号 -> 码位
+    std::vector<State> m_states;                                // 状态
+    std::vector<Outcome> m_outcomes;                            // 所有状态的别名表
+    std::vector<int64_t> m_timingTables;                        // 计时表（每张TimingQuantiles + 1个分位数）
+    size_t m_digraphTables;                                     // 有自己计时表的双字母数
+    bool m_trainedTiming;                                       // 计时表是否来自训练样本
+    double m_meanIntervalNs;                                    // 平均按下间隔
+};
+
+#endif // TYPING_MODEL_H
@@ -0,0 +1,209 @@
+#include "window_target.h"
+#include <iostream>
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#endif
+
+bool TargetSpec::parse(const std::string& spec) {
+    std::string body = spec;
+    size_t at = body.rfind('@');
+    if (at != std::string::npos) {
+        try {
+            size_t used = 0;
+            std::string rate = body.substr(at + 1);
+            frequency = std::stod(rate, &used);
+            if (used != rate.size() || frequency <= 0) {
+                std::cerr << "错误: 无效的目标频率: " << spec << std::endl;
+                return false;
+            }
+        } catch (...) {
+            std::cerr << "错误: 无效的目标频率: " << spec << std::endl;
+            return false;
+        }
+        body = body.substr(0, at);
+    }
+    
+    size_t colon = body.find(':');
+    std::string kind = colon == std::string::npos ? "" : body.substr(0, colon);
+    value = colon == std::string::npos ? "" : body.substr(colon + 1);
+    if (kind == "id") {
+        match = Match::Id;
+    } else if (kind == "name") {
+        match = Match::Name;
+    } else if (kind == "pid") {
+        match = Match::Pid;
+    } else {
+        std::cerr << "错误: 目标格式应为 id:窗口ID、name:标题 或 pid:进程号（可带@频率）: " << spec << std::endl;
+        return false;
+    }
+    if (value.empty()) {
+        std::cerr << "错误: 目标缺少匹配值: " << spec << std::endl;
+        return false;
+    }
+    if (match != Match::Name) {
+        try {
+            size_t used = 0;
+            std::stoul(value, &used, 0);
+            if (used != value.size()) {
+                throw std::invalid_argument(value);
+            }
+        } catch (...) {
+            std::cerr << "错误: 无效的" << (match == Match::Id ? "窗口ID" : "进程号") << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string TargetSpec::describe() const {
+    std::ostringstream text;
+    switch (match) {
+        case Match::Id:
+            text << "窗口 " << value;
+            break;
+        case Match::Name:
+            text << "标题包含 \"" << value << "\"";
+            break;
+        case Match::Pid:
+            text << "进程 " << value;
+            break;
+    }
+    if (frequency > 0) {
+        text << "，" << frequency << " 次/秒";
+    }
+    return text.str();
+}
+
+#ifdef __linux__
+namespace {
+    std::atomic<uint64_t> g_ignoredErrors(0);
+    XErrorHandler g_previousHandler = nullptr;
+    
+    int ignoreBadWindow(Display* display, XErrorEvent* error) {
+        if (error->error_code == BadWindow) {
+            g_ignoredErrors.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        return g_previousHandler ? g_previousHandler(display, error) : 0;
+    }
+}
+
+WindowFinder::WindowFinder(Display* display)
+    : m_display(display)
+    , m_netWmName(XInternAtom(display, "_NET_WM_NAME", False))
+    , m_netWmPid(XInternAtom(display, "_NET_WM_PID", False))
+    , m_utf8String(XInternAtom(display, "UTF8_STRING", False))
+{
+}
+
+void WindowFinder::installErrorHandler() {
+    static std::once_flag installed;
+    std::call_once(installed, [] {
+        g_previousHandler = XSetErrorHandler(ignoreBadWindow);
+    });
+}
+
+uint64_t WindowFinder::ignoredErrors() {
+    return g_ignoredErrors.load(std::memory_order_relaxed);
+}
+
+size_t WindowFinder::find(const TargetSpec& spec, std::vector<TargetWindow>& targets) {
+    size_t before = targets.size();
+    unsigned long value = spec.match == TargetSpec::Match::Name ? 0 : std::stoul(spec.value, nullptr, 0);
+    
+    if (spec.match == TargetSpec::Match::Id) {
+        // 窗口ID直接使用，只确认窗口存在
+        XWindowAttributes attributes;
+        if (XGetWindowAttributes(m_display, static_cast<Window>(value), &attributes)) {
+            targets.push_back(TargetWindow{static_cast<Window>(value), windowName(static_cast<Window>(value)),
+                                           spec.frequency});
+        }
+    } else {
+        collect(DefaultRootWindow(m_display), spec, value, targets);
+    }
+    return targets.size() - before;
+}
+
+void WindowFinder::collect(Window window, const TargetSpec& spec, unsigned long pid,
+                           std::vector<TargetWindow>& targets) {
+    Window root = 0;
+    Window parent = 0;
+    Window* children = nullptr;
+    unsigned int childCount = 0;
+    if (!XQueryTree(m_display, window, &root, &parent, &children, &childCount)) {
+        return;
+    }
+    
+    for (unsigned int i = 0; i < childCount; i++) {
+        Window child = children[i];
+        bool matched = false;
+        std::string name;
+        if (spec.match == TargetSpec::Match::Pid) {
+            matched = pid != 0 && windowPid(child) == pid;
+            if (matched) {
+                name = windowName(child);
+            }
+        } else {
+            name = windowName(child);
+            matched = !name.empty() && name.find(spec.value) != std::string::npos;
+        }
+        
+        if (matched) {
+            targets.push_back(TargetWindow{child, name, spec.frequency});
+        } else {
+            collect(child, spec, pid, targets);
+        }
+    }
+    if (children) {
+        XFree(children);
+    }
+}
+
+std::string WindowFinder::windowName(Window window) {
+    std::string name;
+    Atom type = None;
+    int format = 0;
+    unsigned long count = 0;
+    unsigned long remaining = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(m_display, window, m_netWmName, 0, 1024, False, m_utf8String,
+                           &type, &format, &count, &remaining, &data) == Success && data) {
+        if (type == m_utf8String && format == 8) {
+            name.assign(reinterpret_cast<const char*>(data), count);
+        }
+        XFree(data);
+    }
+    if (name.empty()) {
+        char* legacy = nullptr;
+        if (XFetchName(m_display, window, &legacy) && legacy) {
+            name = legacy;
+            XFree(legacy);
+        }
+    }
+    return name;
+}
+
+unsigned long WindowFinder::windowPid(Window window) {
+    unsigned long pid = 0;
+    Atom type = None;
+    int format = 0;
+    unsigned long count = 0;
+    unsigned long remaining = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(m_display, window, m_netWmPid, 0, 1, False, XA_CARDINAL,
+                           &type, &format, &count, &remaining, &data) == Success && data) {
+        if (type == XA_CARDINAL && format == 32 && count == 1) {
+            // 32位格式的属性在客户端以long存放
+            pid = *reinterpret_cast<unsigned long*>(data);
+        }
+        XFree(data);
+    }
+    return pid;
+}
+#endif
@@ -0,0 +1,83 @@
+#ifndef WINDOW_TARGET_H
+#define WINDOW_TARGET_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#ifdef __linux__
+#include <X11/Xlib.h>
+#endif
+
+/**
+ * 定向注入的目标描述
+ * 格式为 方式:值[@频率]，例如 id:0x1a00003、name:gedit@200、pid:4242@50；
+ * 名称和进程号可能匹配多个窗口，每个窗口都成为一个独立的目标
+ */
+struct TargetSpec {
+    // 匹配方式
+    enum class Match {
+        Id,         // 窗口ID（十进制或0x开头的十六进制）
+        Name,       // 窗口标题包含该子串（_NET_WM_NAME或WM_NAME）
+        Pid         // 窗口所属进程号（_NET_WM_PID）
+    };
+    
+    Match match = Match::Name;
+    std::string value;          // 匹配值
+    double frequency = 0;       // 该目标的输入频率（次/秒，0表示使用 -f/-d 的设置）
+    
+    // 解析目标描述，失败时返回false并输出错误
+    bool parse(const std::string& spec);
+    
+    // 可读描述
+    std::string describe() const;
+};
+
+#ifdef __linux__
+/**
+ * 一个已解析的目标窗口
+ */
+struct TargetWindow {
+    Window window;              // 窗口ID
+    std::string name;           // 窗口标题（可能为空）
+    double frequency;           // 输入频率（0表示使用默认设置）
+};
+
+/**
+ * 目标窗口查找
+ * 从根窗口开始遍历窗口树，匹配到的窗口不再向下查找（避免同一应用的子窗口重复匹配）；
+ * 遍历期间窗口随时可能被销毁，X错误由忽略BadWindow的错误处理函数吸收
+ */
+class WindowFinder {
+public:
+    explicit WindowFinder(Display* display);
+    
+    // 查找与描述匹配的所有窗口，追加到targets，返回找到的数量
+    size_t find(const TargetSpec& spec, std::vector<TargetWindow>& targets);
+    
+    // 窗口标题，优先使用UTF-8的_NET_WM_NAME
+    std::string windowName(Window window);
+    
+    // 安装进程级的X错误处理函数：忽略目标窗口已销毁产生的BadWindow，其他错误交给原处理函数。
+    // 定向注入时目标应用随时可能退出，默认处理函数会直接结束整个进程
+    static void installErrorHandler();
+    
+    // 被忽略的BadWindow错误数
+    static uint64_t ignoredErrors();
+
+private:
+    // 读取窗口的_NET_WM_PID，没有时返回0
+    unsigned long windowPid(Window window);
+    
+    // 递归查找
+    void collect(Window window, const TargetSpec& spec, unsigned long pid, std::vector<TargetWindow>& targets);
+
+private:
+    Display* m_display;
+    Atom m_netWmName;       // _NET_WM_NAME
+    Atom m_netWmPid;        // _NET_WM_PID
+    Atom m_utf8String;      // UTF8_STRING
+};
+#endif
+
+#endif // WINDOW_TARGET_H